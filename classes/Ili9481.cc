@@ -1,4 +1,6 @@
 #include "Ili9481.h"
+#include "spibus.h"
+#include "../include/macros.h"
 
 /*****************************************************************************\
 |* Defines
@@ -6,21 +8,21 @@
 
 #define LCD_DELAY       0x80
 
-#define LCD_CS(state)   gpio_put(_ctx.spi.pinCS, state)
-#define LCD_DATA        gpio_put(_ctx.pinCD, Gpio::HI)
-#define LCD_CMD         gpio_put(_ctx.pinCD, Gpio::LO)
+#define CLIP_TALL       {0, 0, 320, 480}
+#define CLIP_WIDE       {0, 0, 480, 320}
 
-#define BUSY_DELAY      10
-#define SPI_WRITE(ptr, num)                                                 \
-    while (!spi_is_writable(_spi.device()))                                 \
-        sleep_us(BUSY_DELAY);                                               \
-    spi_write_blocking(_spi.device(), ptr, num)
+#define GRAM_COLUMNS    320     // Columns of display memory
+#define GRAM_PAGES      480     // Pages (rows) of display memory
 
-#define CLIP_TALL       {0, 0, 319, 479}
-#define CLIP_WIDE       {0, 0, 479, 319}
+#define PIPE_BUFFER_BYTES 2880  // Per line buffer: 2 wide or 3 tall lines
 
-#define CMD_START       LCD_CS(Gpio::LO); LCD_CMD
-#define CMD_STOP        LCD_CS(Gpio::HI)
+#define CAL_SAFE_MHZ    6       // Read clock the datasheet timings allow
+#define CAL_MAX_MHZ     62      // clk_peri / 2 at the default clock
+#define CAL_STEP_MHZ    2       // Increment between calibration attempts
+#define CAL_MARGIN      85      // Percentage of the fastest good clock used
+#define CAL_PIXELS      32      // Size of the calibration pattern
+
+#define READ_CHUNK_BYTES 960    // GRAM read between chances to yield
 
 /*****************************************************************************\
 |* Enums
@@ -28,9 +30,17 @@
 
 enum
     {
+    SPI_CMD_SOFT_RESET                  = 0x01,
+    SPI_CMD_READ_POWER_MODE             = 0x0A,
+    SPI_CMD_READ_ADDRESS_MODE           = 0x0B,
+    SPI_CMD_READ_PIXEL_FORMAT           = 0x0C,
+    SPI_CMD_EXIT_SLEEP                  = 0x11,
     SPI_CMD_SET_COLUMN_ADDRESS          = 0x2A,
     SPI_CMD_SET_ROW_ADDRESS             = 0x2B,
     SPI_CMD_WRITE_MEMORY_START          = 0x2C,
+    SPI_CMD_WRITE_MEMORY_CONTINUE       = 0x3C,
+    SPI_CMD_READ_MEMORY_START           = 0x2E,
+    SPI_CMD_READ_MEMORY_CONTINUE        = 0x3E,
     SPI_CMD_SET_ADDRESS_MODE            = 0x36,
     };
 
@@ -40,14 +50,24 @@ enum
     AM_HORIZONTAL_FLIP                  = 0x02,
     AM_BGR                              = 0x08,
     AM_SWAP_PAGE_COLUMN                 = 0x20,
+    AM_COLUMN_ORDER                     = 0x40,
+    AM_PAGE_ORDER                       = 0x80,
+    AM_WRITE_ORDER                      = AM_SWAP_PAGE_COLUMN
+                                        | AM_COLUMN_ORDER
+                                        | AM_PAGE_ORDER,
+    };
+
+enum
+    {
+    PM_DISPLAY_ON                       = 0x04,
+    PM_SLEEP_OUT                        = 0x10,
+    PIXEL_FORMAT_18BPP                  = 0x66,
     };
 
 /*****************************************************************************\
 |* Statics
 \*****************************************************************************/
 
-static Rect _limits = CLIP_TALL;        // Start in portrait mode
-
 static const uint8_t _initData[] =
     {
     /*************************************************************************\
@@ -202,18 +222,284 @@ static const uint8_t _initData[] =
 	0
     };
 
+/*****************************************************************************\
+|* Distances from a centre 'c' at which something can land in [lo,hi],
+|* looking either side of it. Used to cut the loops of symmetric shapes down
+|* to the steps that can reach the clip
+\*****************************************************************************/
+struct Reach
+    {
+    int lo;                     // Nearest useful distance
+    int hi;                     // Furthest
+    };
+
+static inline Reach _reach(int c, int lo, int hi)
+    {
+    Reach r;
+    r.lo = (c < lo) ? lo - c : (c > hi) ? c - hi : 0;
+    r.hi = MAX(hi - c, c - lo);
+    return r;
+    }
+
+/*****************************************************************************\
+|* First 't' in [lo,hi] for which a predicate that only ever goes from
+|* false to true holds, or hi+1 if it never does
+\*****************************************************************************/
+template <class Pred>
+static inline int _firstTrue(int lo, int hi, Pred pred)
+    {
+    hi ++;
+    while (lo < hi)
+        {
+        int mid = lo + ((hi - lo) >> 1);
+        if (pred(mid))
+            hi = mid;
+        else
+            lo = mid + 1;
+        }
+    return lo;
+    }
+
+/*****************************************************************************\
+|* Closed forms for the midpoint loops, so they can be started part way
+|* round. Each is where the loop's decision variable says the minor axis
+|* has got to, which is the first (or last) point its error term changes
+|* sign, and is found by bisection since the error term is monotonic there
+|*
+|* _circleFillStep  : rows stepped in by the filled circle after 'k' lines
+|* _circleEdge      : far end of the outline circle's run on step 'j'
+|* _ellipseMinor    : minor coordinate on step 't' of an ellipse region,
+|*                    with 'a' the radius along the loop and 'b' across it
+\*****************************************************************************/
+static inline int64_t _circleFillError(int64_t r, int64_t k, int64_t m)
+    {
+    return -(r >> 1) + k * k + 2 * k - 2 * r * m + m * m + m;
+    }
+
+static int _circleFillStep(int r, int k)
+    {
+    if (k <= 0)
+        return 0;
+    return _firstTrue(0, r, [=](int m)
+        { return _circleFillError(r, k - 1, m) < 0; });
+    }
+
+static int _circleEdge(int r, int j)
+    {
+    if (j < 0)
+        return 0;
+    int64_t need = (int64_t)r - 1 + 2LL * r * j - (int64_t)j * j - j;
+    return _firstTrue(0, r, [=](int c)
+        { return (int64_t)c * c + 2 * c >= need; });
+    }
+
+static inline int64_t _ellipseError(int64_t a, int64_t b, int64_t t, int64_t u)
+    {
+    int64_t a2 = a * a;
+    int64_t b2 = b * b;
+    return b2 * (2 * t * t + 4 * t + 2) + a2 * (2 * u * u - 2 * u + 1)
+         - 2 * a2 * b * b;
+    }
+
+static int _ellipseMinor(int a, int b, int t)
+    {
+    if (t <= 0)
+        return b;
+    int u = _firstTrue(0, b, [=](int u)
+        { return _ellipseError(a, b, t - 1, u) >= 0; });
+    return MAX(u - 1, 0);
+    }
+
+/*****************************************************************************\
+|* The steps of each region of an ellipse that can reach the clip: first
+|* and last 'xx' of the region stepped along x, then first and last 'yy' of
+|* the one stepped along y. A filled ellipse draws whole rows, which only
+|* need to be in reach and wide enough to get to the clip
+\*****************************************************************************/
+static void _ellipseSteps(int rx, int ry, Reach cols, Reach rows, bool fill,
+                          int *steps)
+    {
+    for (int region=0; region<2; region++)
+        {
+        int a       = region ? ry : rx;
+        int b       = region ? rx : ry;
+        Reach along = region ? rows : cols;
+        Reach minor = region ? cols : rows;
+        int *out    = steps + region * 2;
+
+        int lo      = along.lo;
+        int hi      = along.hi;
+        int top     = minor.hi;
+        if (fill && (region == 0))
+            hi  = a;
+        if (fill && (region == 1))
+            top = b;
+
+        lo = MAX(lo, _firstTrue(0, a, [=](int t)
+                { return _ellipseMinor(a, b, t) <= top; }));
+        hi = MIN(hi, _firstTrue(0, a, [=](int t)
+                { return _ellipseMinor(a, b, t) < minor.lo; }) - 1);
+
+        out[0] = lo;
+        out[1] = hi;
+        }
+    }
+
+/*****************************************************************************\
+|* Put the first 'num' items of a batch in order, as indices. It's an
+|* insertion sort, so items that compare equal keep the order they came in
+\*****************************************************************************/
+template <class Less>
+static inline void _sortBatch(uint8_t *order, int num, Less less)
+    {
+    for (int i=0; i<num; i++)
+        {
+        int j = i;
+        while ((j > 0) && less(i, order[j - 1]))
+            {
+            order[j] = order[j - 1];
+            j --;
+            }
+        order[j] = (uint8_t)i;
+        }
+    }
+
+/*****************************************************************************\
+|* Shader for a filled shape sent as its bounding box: the backdrop, with
+|* the shape's span on each row (from a table of [x0,x1) pairs) over it
+\*****************************************************************************/
+struct SpanShader
+    {
+    const int16_t * rows;       // Span for each row, from 'top'
+    int             top;        // Row of rows[0]
+    RGB             colour;     // Inside the shape
+    const Backdrop *bg;         // Outside it
+
+    inline void operator()(int x, int y, int n, uint8_t *dst) const
+        {
+        (*bg)(x, y, n, dst);
+
+        const int16_t *span = rows + 2 * (y - top);
+        int x0              = MAX(x, span[0]);
+        int x1              = MIN(x + n, span[1]);
+        for (uint8_t *p = dst + (x0 - x) * 3; x0 < x1; x0++, p += 3)
+            {
+            p[0] = colour.r;
+            p[1] = colour.g;
+            p[2] = colour.b;
+            }
+        }
+    };
+
+/*****************************************************************************\
+|* Shader for a filled rounded box sent through one window: the backdrop,
+|* with the box over it, its corner rows taken from an ARC_CORNER table
+\*****************************************************************************/
+struct RoundBoxShader
+    {
+    Rect            box;        // The whole box
+    int             pix;        // Corner radius
+    const int16_t * half;       // Corner row half-widths
+    RGB             colour;     // Inside the box
+    const Backdrop *bg;         // Outside it
+
+    inline void operator()(int x, int y, int n, uint8_t *dst) const
+        {
+        int top     = box.y + pix;
+        int bottom  = box.y + box.h - pix - 1;
+        int d       = (y < top) ? top - y : (y > bottom) ? y - bottom : 0;
+        int x0      = box.x;
+        int x1      = box.x + box.w;
+
+        if (d > 0)
+            {
+            if (half[d] < 0)
+                x1 = x0;
+            else
+                {
+                x0 = box.x + pix - half[d];
+                x1 = box.x + box.w - pix + half[d];
+                }
+            }
+
+        if ((x0 > x) || (x1 < x + n))
+            (*bg)(x, y, n, dst);
+
+        x0 = MAX(x0, x);
+        x1 = MIN(x1, x + n);
+        for (uint8_t *p = dst + (x0 - x) * 3; x0 < x1; x0++, p += 3)
+            {
+            p[0] = colour.r;
+            p[1] = colour.g;
+            p[2] = colour.b;
+            }
+        }
+    };
+
 /*****************************************************************************\
 |* Constructor
 \*****************************************************************************/
 Ili9481::Ili9481(void)
-        :_clip(_limits)
+        :_bounds(CLIP_TALL)
+        ,_clip(CLIP_TALL)
         ,_rotation(Ili9481::PORTRAIT)
+        ,_writeMhz(0)
+        ,_readMhz(0)
+        ,_readBgr(false)
+        ,_renderMode(RENDER_AUTO)
+        ,_fillKey(0xFFFFFFFF)
+        ,_addressMode(AM_BGR | AM_HORIZONTAL_FLIP)
+        ,_initState(INIT_IDLE)
+        ,_initAddr(_initData)
+        ,_initWarm(false)
+        ,_region(Rect CLIP_TALL)
+        ,_window({0, 0, 0, 0})
+        ,_lines{nullptr, nullptr}
+        ,_lineBytes(0)
+        ,_aaNum(0)
+        ,_aaBox({0, 0, 0, 0})
+        ,_aaFg(RGB(0,0,0))
+        ,_aaBg(nullptr)
+        ,_record(nullptr)
+        ,_spanRows(nullptr)
+        ,_spanRowsNum(0)
+        ,_backdrop(RGB(0,0,0))
+        ,_haveBackdrop(false)
+        ,_palette(nullptr)
+        ,_ink(-1)
+        ,_mono(nullptr)
     {}
 
 /*****************************************************************************\
-|* Initialise an ILI9481 display driver using the SPI interface
+|* Destructor
+\*****************************************************************************/
+Ili9481::~Ili9481(void)
+    {
+    FREE(_lines[0]);
+    FREE(_lines[1]);
+    FREE(_spanRows);
+    }
+
+/*****************************************************************************\
+|* Initialise an ILI9481 display driver using the SPI interface, blocking
+|* until it's done
+\*****************************************************************************/
+int Ili9481::init(DpyContext *ctx, bool warm)
+    {
+    int ok = initAsync(ctx, warm);
+    while (ok == E_PENDING)
+        {
+        sleep_until(_initWake);
+        ok = poll();
+        }
+    return ok;
+    }
+
+/*****************************************************************************\
+|* Start initialising the display. The reset and init-script delays are run
+|* from poll(), so the caller can get on with other things in the meantime
 \*****************************************************************************/
-int Ili9481::init(DpyContext *ctx)
+int Ili9481::initAsync(DpyContext *ctx, bool warm)
     {
     /*************************************************************************\
     |* Make sure the context is valid
@@ -228,6 +514,7 @@ int Ili9481::init(DpyContext *ctx)
     |* Copy context and start to use it to configure with
     \*************************************************************************/
     _ctx        = *ctx;
+    _initState  = INIT_FAILED;
     int errs    = 0;
 
     /*************************************************************************\
@@ -252,20 +539,14 @@ int Ili9481::init(DpyContext *ctx)
         }
 
     /*************************************************************************\
-    |* Enable the /RST pin as an output if >=0, and trigger a reset
+    |* Enable the /RST pin as an output if >=0, holding it inactive. The reset
+    |* pulse itself is sent from poll()
     \*************************************************************************/
     if ((errs==0 ) && (_ctx.pinRST >= 0))
         {
         gpio_set_dir(_ctx.pinRST, Gpio::OUTPUT);
         gpio_pull_up(_ctx.pinRST);
-
-        gpio_put(_ctx.pinRST, Gpio::HI);
-        
-        sleep_ms(5);
-        gpio_put(_ctx.pinRST, Gpio::LO);
-        sleep_ms(15);
         gpio_put(_ctx.pinRST, Gpio::HI);
-        sleep_ms(150);
         }
     else
         errs ++;
@@ -273,7 +554,6 @@ int Ili9481::init(DpyContext *ctx)
     /*************************************************************************\
     |* Then try to bring up SPI
     \*************************************************************************/
-    int ok = 0;
     if (errs == 0)
         {
         int ok = _spi.init(_ctx.spi);
@@ -283,39 +563,67 @@ int Ili9481::init(DpyContext *ctx)
             printf("Cannot initialise SPI%d device for ILI9481\n", 
                     _ctx.spi.device);
             }
+        _spi.setPinCD(_ctx.pinCD);
+        _writeMhz   = _spi.ctx().speedInMhz;
+        _readMhz    = MIN(_writeMhz, CAL_SAFE_MHZ);
         }
 
+    if (errs != 0)
+        return -errs;
+
     /*************************************************************************\
     |* Configure the spi interface
     \*************************************************************************/
-    spi_set_format(_spi.device(), 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+    _spi.setFormat(SPI_CPOL_1, SPI_CPHA_1);
 
     /*************************************************************************\
-    |* Run the default init sequence
+    |* If the MCU rebooted but the panel didn't, we can skip the reset and
+    |* sleep-out (and all their delays), and just re-send the configuration
     \*************************************************************************/
-	uint8_t  numBytes;
-    uint8_t * addr  = (uint8_t *) _initData;
-
-	while ((numBytes=(*addr++))>0)              // end marker == 0
-        { 
-		if ( numBytes & LCD_DELAY) 
-            {
-			uint8_t tmp = *addr++;
-			sleep_ms(tmp);                      // up to 255 millis
-		    } 
-        else 
-            {
-            _writeCommand(*addr ++); 
-            while (--numBytes) 
-				_writeData(*addr ++); 
-		    }
-	    }
+    _initAddr   = _initData;
+    _window     = {0, 0, 0, 0};
+    _initWarm   = warm && _isConfigured();
+    _initState  = (_initWarm) ? INIT_SCRIPT : INIT_RESET_PULSE;
+    _initWake   = (_initWarm) ? get_absolute_time() : make_timeout_time_ms(5);
 
-
-    return (errs == 0) ? E_OK : -errs;
+    return poll();
     }
 
+/*****************************************************************************\
+|* Advance the init state machine as far as it can go without waiting
+\*****************************************************************************/
+int Ili9481::poll(void)
+    {
+    while ((_initState != INIT_DONE) && (_initState != INIT_FAILED))
+        {
+        if (!time_reached(_initWake))
+            return E_PENDING;
+
+        switch (_initState)
+            {
+            case INIT_RESET_PULSE:
+                gpio_put(_ctx.pinRST, Gpio::LO);
+                _initWake   = make_timeout_time_ms(15);
+                _initState  = INIT_RESET_RELEASE;
+                break;
+
+            case INIT_RESET_RELEASE:
+                gpio_put(_ctx.pinRST, Gpio::HI);
+                _initWake   = make_timeout_time_ms(150);
+                _initState  = INIT_SCRIPT;
+                break;
+
+            case INIT_SCRIPT:
+                _stepInitScript();
+                break;
+
+            default:
+                break;
+            }
+        }
 
+    return (_initState == INIT_DONE) ? E_OK : E_INVALID;
+    }
 
 /*****************************************************************************\
 |* Method : Fetch the address mode
@@ -323,35 +631,238 @@ int Ili9481::init(DpyContext *ctx)
 int Ili9481::fetchAddressMode(void)
     {
     /*************************************************************************\
-    |* Start the command (handle /CS and C/D)
+    |* Read back the value, the first byte is a dummy
+    \*************************************************************************/
+    uint8_t result[2] = {0xff,0xff};
+    _readRegister(SPI_CMD_READ_ADDRESS_MODE, result, 2);
+
+    return result[1] & 0xF8;
+    }
+
+
+/*****************************************************************************\
+|* Method : Calibrate the SPI clocks.
+|*
+|* Writes are swept upwards while reads stay at a safe clock, then reads are
+|* swept upwards while writes stay safe. Each step writes a test pattern and
+|* the address mode, and reads both back. The fastest passing clocks, less a
+|* margin, become the clocks used from then on
+\*****************************************************************************/
+int Ili9481::calibrate(void)
+    {
+    int writeMhz    = _writeMhz;
+    int readMhz     = _readMhz;
+
+    /*************************************************************************\
+    |* A pattern that toggles every bit, with a rolling value mixed in
     \*************************************************************************/
-    CMD_START;
+    uint8_t pattern[CAL_PIXELS * 3];
+    for (int i=0; i<CAL_PIXELS*3; i++)
+        pattern[i] = ((i * 37) ^ ((i & 1) ? 0xFC : 0x00)) & 0xFC;
 
-    uint8_t cmd = 0x0B;
-    SPI_WRITE(&cmd, 1); 
-    
     /*************************************************************************\
-    |* Enter data mode and read back the value
+    |* Keep what's under the pattern, read at the safe clocks, so it can be
+    |* put back afterwards
     \*************************************************************************/
-    LCD_DATA;
-    uint8_t result[3] = {0xff,0xff,0x0};
-    spi_read_blocking(_spi.device(), 0xfe, result, 2);
+    Rect corner = {0, 0, CAL_PIXELS, 1};
+    uint8_t saved[CAL_PIXELS * 3];
+
+    _writeMhz   = CAL_SAFE_MHZ;
+    _readMhz    = CAL_SAFE_MHZ;
+    _spi.setSpeed(_writeMhz);
+    _window     = {0, 0, 0, 0};
+    _readBlock(corner, saved);
 
     /*************************************************************************\
-    |* Stop the command (handle /CS)
+    |* If it doesn't work at the safe clocks, there's probably no MISO wired
     \*************************************************************************/
-    CMD_STOP;
+    if (!_verifyClocks(CAL_SAFE_MHZ, CAL_SAFE_MHZ, pattern))
+        {
+        printf(T_ERR "Cannot read back from display, not calibrating\n");
+        _writeMhz   = writeMhz;
+        _readMhz    = readMhz;
+        _spi.setSpeed(_writeMhz);
+
+        // What was read can't be trusted, so the corner is cleared instead
+        memset(saved, 0, sizeof(saved));
+        _restoreCorner(corner, saved);
+        return E_NO_RESOURCE;
+        }
 
-    return result[1] & 0xF8;
-    }
+    int bestWrite = CAL_SAFE_MHZ;
+    for (int mhz = CAL_SAFE_MHZ + CAL_STEP_MHZ; mhz <= CAL_MAX_MHZ; mhz += CAL_STEP_MHZ)
+        {
+        if (!_verifyClocks(mhz, CAL_SAFE_MHZ, pattern))
+            break;
+        bestWrite = mhz;
+        }
+
+    int bestRead = CAL_SAFE_MHZ;
+    for (int mhz = CAL_SAFE_MHZ + CAL_STEP_MHZ; mhz <= CAL_MAX_MHZ; mhz += CAL_STEP_MHZ)
+        {
+        if (!_verifyClocks(CAL_SAFE_MHZ, mhz, pattern))
+            break;
+        bestRead = mhz;
+        }
 
+    /*************************************************************************\
+    |* Back off by the margin, and record what the hardware actually gives us
+    \*************************************************************************/
+    _readMhz    = MAX(CAL_SAFE_MHZ, bestRead * CAL_MARGIN / 100);
+    _writeMhz   = MAX(CAL_SAFE_MHZ, bestWrite * CAL_MARGIN / 100);
+    _writeMhz   = _spi.setSpeed(_writeMhz);
+
+    _fixReadback(saved, CAL_PIXELS);
+    _restoreCorner(corner, saved);
+    return E_OK;
+    }
 
 /*****************************************************************************\
 |* Method : Reset the clip rectangle
 \*****************************************************************************/
 void Ili9481::resetClipRectangle(void)
     {
-    _clip = _limits;
+    setClip(_bounds);
+    }
+
+/*****************************************************************************\
+|* Method : Clip to a rectangle
+\*****************************************************************************/
+void Ili9481::setClip(Rect r)
+    {
+    _clip = r;
+    _region.set(r);
+    }
+
+/*****************************************************************************\
+|* Method : Clip to a region, which is kept within the screen
+\*****************************************************************************/
+void Ili9481::setClipRegion(const ClipRegion &region)
+    {
+    _region = region;
+    _region.intersect(_bounds);
+    _clip   = _region.extents();
+    }
+
+/*****************************************************************************\
+|* Method : Say what's behind the filled shapes that follow
+\*****************************************************************************/
+void Ili9481::setBackdrop(const Backdrop &bg)
+    {
+    _backdrop       = bg;
+    _haveBackdrop   = true;
+    }
+
+/*****************************************************************************\
+|* Method : Forget the backdrop, so filled shapes only send their own pixels
+\*****************************************************************************/
+void Ili9481::clearBackdrop(void)
+    {
+    _haveBackdrop = false;
+    }
+
+/*****************************************************************************\
+|* Method : Go into (or, with nullptr, out of) palette mode
+\*****************************************************************************/
+void Ili9481::setPalette(Palette *palette)
+    {
+    _palette    = palette;
+    _ink        = -1;
+    }
+
+/*****************************************************************************\
+|* Method : Change a palette entry, and send just the runs of the shadow
+|* that have it, whatever the clip. Rows the entry isn't in aren't looked
+|* at, so the cost is in the pixels that change
+\*****************************************************************************/
+int Ili9481::setPaletteEntry(int index, RGB colour)
+    {
+    if ((_palette == nullptr) || (index < 0) || (index >= PALETTE_SIZE))
+        return E_INVALID;
+
+    _palette->setColour(index, colour);
+
+    int x0      = _bounds.x;
+    int x1      = _bounds.x + _bounds.w;
+    int y0      = _bounds.y;
+    int y1      = _bounds.y + _bounds.h;
+    int sent    = 0;
+
+    _spi.begin();
+    _palette->runs(index, [&](int x, int y, int w)
+        {
+        int left    = MAX(x, x0);
+        int right   = MIN(x + w, x1);
+        if ((y < y0) || (y >= y1) || (right <= left))
+            return;
+
+        _setWindow({left, y, right - left, 1});
+        _pushRun(colour, right - left, true);
+        if ((++sent % BATCH_SORT) == 0)
+            _spi.yield();
+        });
+    _spi.end();
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Go into (or, with nullptr, out of) monochrome mode
+\*****************************************************************************/
+void Ili9481::setMono(MonoBuffer *mono)
+    {
+    _mono = mono;
+    }
+
+/*****************************************************************************\
+|* Method : Send the dirty rows of the mono buffer. Each run of them is one
+|* window, and goes out through the two line buffers: one is filled from
+|* the table while the other is sent
+\*****************************************************************************/
+int Ili9481::flush(void)
+    {
+    if (_mono == nullptr)
+        return E_INVALID;
+
+    int w       = MIN(_mono->width(), _bounds.w);
+    int h       = MIN(_mono->height(), _bounds.h);
+    int stride  = w * 3;
+    int per     = MAX(1, PIPE_BUFFER_BYTES / stride);
+    int cur     = 0;
+    int num;
+
+    if (_reserveLines(per * stride) != E_OK)
+        return E_NO_RESOURCE;
+
+    _spi.begin();
+    for (int y=_mono->nextDirty(0, &num); (y >= 0) && (y < h);
+         y=_mono->nextDirty(y + num, &num))
+        {
+        int bottom = MIN(y + num, h);
+        Rect rows  = {0, y, w, bottom - y};
+        _note(rows);
+        _setWindow(rows);
+        _sendCommand(SPI_CMD_WRITE_MEMORY_START);
+
+        for (int row=y; row<bottom; )
+            {
+            int n           = MIN(per, bottom - row);
+            uint8_t *line   = _lines[cur];
+            for (int i=0; i<n; i++, line += stride)
+                _mono->expand(row + i, w, line);
+
+            _spi.writeAsync(_lines[cur], n * stride);
+            row += n;
+            cur ^= 1;
+
+            if (row < bottom)
+                _yieldWrite();
+            }
+        _mono->clean(y, bottom - y);
+        }
+    _spi.end();
+
+    return E_OK;
     }
 
 /*****************************************************************************\
@@ -360,40 +871,40 @@ void Ili9481::resetClipRectangle(void)
 void Ili9481::setRotation(Rotation rotation)
     {
     /*************************************************************************\
-    |* Set the address mode 
+    |* Work out the address mode 
     \*************************************************************************/
-    LCD_CS(Gpio::LO);
-    _writeCommand(SPI_CMD_SET_ADDRESS_MODE);
+    uint8_t mode = AM_BGR;
 
     switch (rotation)
         {
         case PORTRAIT:
-            _writeData(AM_BGR | AM_HORIZONTAL_FLIP);
-            _limits = CLIP_TALL;
+            mode   |= AM_HORIZONTAL_FLIP;
+            _bounds = CLIP_TALL;
             break;
         case LANDSCAPE:
-            _writeData(AM_BGR | AM_SWAP_PAGE_COLUMN);
-            _limits = CLIP_WIDE;
+            mode   |= AM_SWAP_PAGE_COLUMN;
+            _bounds = CLIP_WIDE;
             break;
         case INVERTED_PORTRAIT:
-            _writeData(AM_BGR | AM_VERTICAL_FLIP);
-            _limits = CLIP_TALL;
+            mode   |= AM_VERTICAL_FLIP;
+            _bounds = CLIP_TALL;
             break;
         case INVERTED_LANDSCAPE:
-            _writeData(AM_BGR 
-                     | AM_SWAP_PAGE_COLUMN 
-                     | AM_HORIZONTAL_FLIP
-                     | AM_HORIZONTAL_FLIP);
-            _limits = CLIP_WIDE;
+            mode   |= AM_SWAP_PAGE_COLUMN 
+                   |  AM_HORIZONTAL_FLIP
+                   |  AM_HORIZONTAL_FLIP;
+            _bounds = CLIP_WIDE;
             break;
         }
  
-    setClip(_limits);
+    setClip(_bounds);
  
     /*************************************************************************\
-    |* Stop the command (handle /CS)
+    |* And send it
     \*************************************************************************/
-    CMD_STOP;
+    _addressMode = mode;
+    _rotation    = rotation;
+    _sendCommand(SPI_CMD_SET_ADDRESS_MODE, &mode, 1);
     }
 
 /*****************************************************************************\
@@ -404,34 +915,8 @@ void Ili9481::circle(Point xy, int r, RGB rgb, bool filled)
     if (filled == false)
         _circle(xy.x, xy.y, r, rgb);
     else
-        {
-        int x   = xy.x;
-        int y   = xy.y;
-        int  xx = 0;
-        int  dx = 1;
-        int  dy = r+r;
-        int  p  = -(r>>1);
-
-        _hline(x-r, y, dy+1, rgb);
-        while (xx < r)
-            {
-            if (p>=0)
-                {
-                _hline(x - xx, y + r, dx, rgb);
-                _hline(x - xx, y - r, dx, rgb);
-                dy-=2;
-                p-=dy;
-                r--;
-                }
-
-            dx+=2;
-            p+=dx;
-            xx++;
-
-            _hline(x - r, y + xx, dy+1, rgb);
-            _hline(x - r, y - xx, dy+1, rgb);
-            }
-        }
+        _fillShape({xy.x - r, xy.y - r, 2 * r + 1, 2 * r + 1}, rgb,
+                   [&]{ _circleFill(xy.x, xy.y, r, rgb); });
     }
 
 /*****************************************************************************\
@@ -440,7 +925,8 @@ void Ili9481::circle(Point xy, int r, RGB rgb, bool filled)
 void Ili9481::ellipse(Point p, int rx, int ry, RGB rgb, bool filled)
     {
     if (filled)
-        _ellipseFill(p.x, p.y, rx, ry, rgb);
+        _fillShape({p.x - rx, p.y - ry, 2 * rx + 1, 2 * ry + 1}, rgb,
+                   [&]{ _ellipseFill(p.x, p.y, rx, ry, rgb); });
     else
         _ellipse(p.x, p.y, rx, ry, rgb);
     }
@@ -448,13 +934,23 @@ void Ili9481::ellipse(Point p, int rx, int ry, RGB rgb, bool filled)
 
 /*****************************************************************************\
 |* Method : draw a line
+|*
+|* Lines are clipped before they're stepped. Cohen-Sutherland outcodes throw
+|* out lines entirely to one side of the clip, and for the rest the range
+|* of steps that can land inside it is solved for directly (as Liang-Barsky
+|* would, but in whole pixels). Bresenham then starts at the first of them
+|* with the error term it would have had there, so the pixels drawn are
+|* exactly those of the unclipped line
 \*****************************************************************************/
 void Ili9481::line(Point p0, Point p1, RGB rgb)
     {
+    if ((_outcode(p0) & _outcode(p1)) != 0)
+        return;
+
     if (p0.y == p1.y)
-        _hline(p0.x, p0.y, p1.x - p0.x, rgb);
+        _hline(MIN(p0.x, p1.x), p0.y, ABS(p1.x - p0.x) + 1, rgb);
     else if (p0.x == p1.x)
-        _vline(p0.x, p0.y, p1.y - p0.y, rgb);
+        _vline(p0.x, MIN(p0.y, p1.y), ABS(p1.y - p0.y) + 1, rgb);
     else
         {
         int x0 = p0.x;
@@ -486,6 +982,35 @@ void Ili9481::line(Point p0, Point p1, RGB rgb)
         if (y0 < y1) 
             ystep = 1;
 
+        /*********************************************************************\
+        |* Clip, in the stepping frame. After k steps, y has moved on
+        |* n(k) = ceil((k*dy - dx/2) / dx) times (or none, if that's <= 0),
+        |* and n only ever grows, so each edge of the clip bounds k
+        \*********************************************************************/
+        int64_t half    = dx >> 1;
+        int64_t kLo     = MAX(0, (steep ? _clip.y : _clip.x) - x0);
+        int64_t kHi     = MIN(dx, (steep ? _clip.y + _clip.h
+                                         : _clip.x + _clip.w) - 1 - x0);
+        int yLo         = steep ? _clip.x : _clip.y;
+        int yHi         = (steep ? _clip.x + _clip.w : _clip.y + _clip.h) - 1;
+        int64_t nLo     = (ystep > 0) ? yLo - y0 : y0 - yHi;
+        int64_t nHi     = (ystep > 0) ? yHi - y0 : y0 - yLo;
+
+        if (nHi < 0)
+            return;
+        if (nLo > 0)
+            kLo = MAX(kLo, ((nLo - 1) * dx + half) / dy + 1);
+        kHi = MIN(kHi, (nHi * dx + half) / dy);
+        if (kLo > kHi)
+            return;
+
+        int64_t n   = (kLo * dy > half) ? (kLo * dy - half + dx - 1) / dx : 0;
+        err         = (int)(half - kLo * dy + n * dx);
+        y0         += ystep * (int)n;
+        x1          = x0 + (int)kHi;
+        x0         += (int)kLo;
+        xs          = x0;
+
         // Split into steep and not steep for FastH/V separation
         if (steep) 
             {
@@ -551,15 +1076,27 @@ void Ili9481::box(Rect r, RGB rgb, bool filled, int pix)
         int rx2 = r.x + r.w - pix - 1;
         int ry2 = r.y + r.h - pix - 1;
         
-        if (filled)
-            {
-            _rectFill({r.x, r.y + pix, r.w, r.h - px2}, rgb);
+        /*********************************************************************\
+        |* With the background known, a filled box with a table for its
+        |* corners goes out as one window, rather than a window per row
+        \*********************************************************************/
+        const int16_t *half = filled ? _arcs.table(pix, ARC_CORNER) : nullptr;
+
+        if ((half != nullptr) && _haveBackdrop && _region.rectangular()
+            && (_ink < 0) && (_mono == nullptr)
+            && ((_renderMode == RENDER_AUTO) || (_renderMode == RENDER_BOX))
+            && (r.w >= px2) && (r.h >= px2))
+            fillRect(r, RoundBoxShader{r, pix, half, rgb, &_backdrop});
+        else if (filled)
+            _fillShape(r, rgb, [&]
+                {
+                _rectFill({r.x, r.y + pix, r.w, r.h - px2}, rgb);
 
-            // draw four corners
-            int delta = r.w - px2 - 1;
-            _filledCircleHelper(r.x + pix, ry2, pix, 1, r.w - px2 - 1, rgb);
-            _filledCircleHelper(r.x + pix, r.y + pix, pix, 2, delta, rgb);
-            }
+                // draw four corners
+                int delta = r.w - px2 - 1;
+                _filledCircleHelper(r.x + pix, ry2, pix, 1, delta, rgb);
+                _filledCircleHelper(r.x + pix, r.y + pix, pix, 2, delta, rgb);
+                });
         else
             {
             _hline(r.x + pix    , r.y          , r.w - px2, rgb); // Top
@@ -579,9 +1116,9 @@ void Ili9481::box(Rect r, RGB rgb, bool filled, int pix)
     else
         {
         _hline(r.x, r.y, r.w, rgb);
-        _hline(r.x, r.y+r.h, r.w, rgb);
+        _hline(r.x, r.y+r.h-1, r.w, rgb);
         _vline(r.x, r.y, r.h, rgb);
-        _vline(r.x+r.w, r.y, r.h, rgb);
+        _vline(r.x+r.w-1, r.y, r.h, rgb);
         }
     }
 
@@ -591,7 +1128,7 @@ void Ili9481::box(Rect r, RGB rgb, bool filled, int pix)
 \*****************************************************************************/
 void Ili9481::clear(RGB rgb)
     {
-    _rectFill(_limits, rgb);
+    _rectFill(_bounds, rgb);
     }
 
 /*****************************************************************************\
@@ -600,7 +1137,14 @@ void Ili9481::clear(RGB rgb)
 void Ili9481::triangle(Point p0, Point p1, Point p2, RGB rgb, bool filled)
     {
     if (filled)
-        _triangleFill(p0, p1, p2, rgb);
+        {
+        int x0 = MIN(p0.x, MIN(p1.x, p2.x));
+        int y0 = MIN(p0.y, MIN(p1.y, p2.y));
+        int x1 = MAX(p0.x, MAX(p1.x, p2.x));
+        int y1 = MAX(p0.y, MAX(p1.y, p2.y));
+        _fillShape({x0, y0, x1 - x0 + 1, y1 - y0 + 1}, rgb,
+                   [&]{ _triangleFill(p0, p1, p2, rgb); });
+        }
     else
         {
         line(p0, p1, rgb);
@@ -609,340 +1153,1971 @@ void Ili9481::triangle(Point p0, Point p1, Point p2, RGB rgb, bool filled)
         }
     }
 
-#pragma mark - Private Methods
-
 /*****************************************************************************\
-|* Private Method : write a command over the SPI bus
+|* Methods : Draw a quadratic or cubic Bézier curve
 \*****************************************************************************/
-void Ili9481::_writeCommand(uint8_t c, bool handleCS)
+void Ili9481::bezier(Point p0, Point c, Point p1, RGB colour)
     {
-    /*************************************************************************\
-    |* Take CS low
-    \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::LO);
-    
-    /*************************************************************************\
-    |* Enter command mode
-    \*************************************************************************/
-    LCD_CMD;
-
-    /*************************************************************************\
-    |* Write the SPI command
-    \*************************************************************************/
-    SPI_WRITE(&c, 1); 
-     
-    /*************************************************************************\
-    |* Return to data mode
-    \*************************************************************************/
-    LCD_DATA;
+    Point ctl[3] = {p0, c, p1};
+    _curve(ctl, 2, colour);
+    }
 
-    /*************************************************************************\
-    |* Take CS high
-    \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::HI);
-   }
+void Ili9481::bezier(Point p0, Point c0, Point c1, Point p1, RGB colour)
+    {
+    Point ctl[4] = {p0, c0, c1, p1};
+    _curve(ctl, 3, colour);
+    }
 
 /*****************************************************************************\
-|* Private Method : write a data byte over the SPI bus
+|* Method : Draw a path as one pixel wide lines, holding CS for all of it
 \*****************************************************************************/
-void Ili9481::_writeData(uint8_t d, bool handleCS)
+void Ili9481::strokePath(Path &path, RGB colour)
     {
-    /*************************************************************************\
-    |* Take CS low
-    \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::LO);
-    
-    /*************************************************************************\
-    |* Should already be in data mode, but...
-    \*************************************************************************/
-    LCD_DATA;
-
-    /*************************************************************************\
-    |* Write the SPI data
-    \*************************************************************************/
-    SPI_WRITE(&d, 1); 
-     
-    /*************************************************************************\
-    |* This is just a delay, really
-    \*************************************************************************/
-    LCD_CS(Gpio::LO);
+    if (path.empty() || _offClip(path.bounds()))
+        return;
 
-    /*************************************************************************\
-    |* Take CS high
-    \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::HI);
+    PathRun run = {this, colour};
+    _spi.begin();
+    path.trace(_pathRun, &run);
+    _spi.end();
     }
 
 /*****************************************************************************\
-|* Private Method : set the active window in which to write data.
+|* Method : Fill a path, a band of rows at a time, just within the clip
 \*****************************************************************************/
-void Ili9481::_setWindow(Rect r, bool handleCS)
+void Ili9481::fillPath(Path &path, RGB colour, FillRule rule)
     {
-    /*************************************************************************\
-    |* Take CS low
-    \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::LO);
+    Rect box = path.bounds();
+    if (path.empty() || _offClip(box))
+        return;
 
-    /*************************************************************************\
-    |* Set the top-left corner
+    PathRun run = {this, colour};
+    int bottom  = MIN(box.y + box.h, _clip.y + _clip.h);
+
+    _spi.begin();
+    for (int y=MAX(box.y, _clip.y); y<bottom; y+=PATH_BAND)
+        {
+        path.scan({_clip.x, y, _clip.w, MIN(PATH_BAND, bottom - y)}, rule,
+                  _pathRun, &run);
+        _spi.yield();
+        }
+    _spi.end();
+    }
+
+/*****************************************************************************\
+|* Method : Fill several rectangles with one colour. Sorting on the top row
+|* and height puts rectangles that share rows together, and then only the
+|* column addresses change between them
+\*****************************************************************************/
+void Ili9481::fillRects(const Rect *rects, int num, RGB colour)
+    {
+    uint8_t order[BATCH_SORT];
+
+    _spi.begin();
+    for (int at=0; at<num; at+=BATCH_SORT)
+        {
+        const Rect *r   = rects + at;
+        int n           = MIN(num - at, BATCH_SORT);
+        _sortBatch(order, n, [=](int a, int b)
+            {
+            if (r[a].y != r[b].y)
+                return r[a].y < r[b].y;
+            if (r[a].h != r[b].h)
+                return r[a].h < r[b].h;
+            return r[a].x < r[b].x;
+            });
+
+        for (int i=0; i<n; i++)
+            _batchFill(r[order[i]], colour);
+        _spi.yield();
+        }
+    _spi.end();
+    }
+
+/*****************************************************************************\
+|* Method : Draw several lines of one colour, from ends[2i] to ends[2i+1].
+|* These aren't sorted, since each line is spread over many rows anyway
+\*****************************************************************************/
+void Ili9481::drawLines(const Point *ends, int num, RGB colour)
+    {
+    _spi.begin();
+    for (int i=0; i<num; i++)
+        {
+        line(ends[2 * i], ends[2 * i + 1], colour);
+        if ((i % BATCH_SORT) == BATCH_SORT - 1)
+            _spi.yield();
+        }
+    _spi.end();
+    }
+
+/*****************************************************************************\
+|* Method : Plot several points of one colour. In row order, each point only
+|* needs its column address, and points next to each other in a row are
+|* sent as one run
+\*****************************************************************************/
+void Ili9481::drawPoints(const Point *points, int num, RGB colour)
+    {
+    uint8_t order[BATCH_SORT];
+
+    _spi.begin();
+    for (int at=0; at<num; at+=BATCH_SORT)
+        {
+        const Point *p  = points + at;
+        int n           = MIN(num - at, BATCH_SORT);
+        _sortBatch(order, n, [=](int a, int b)
+            {
+            return (p[a].y < p[b].y)
+                || ((p[a].y == p[b].y) && (p[a].x < p[b].x));
+            });
+
+        for (int i=0; i<n; )
+            {
+            Point first = p[order[i]];
+            int w       = 1;
+            for (i++; i<n; i++)
+                {
+                Point next = p[order[i]];
+                if ((next.y != first.y) || (next.x > first.x + w))
+                    break;
+                if (next.x == first.x + w)
+                    w ++;
+                }
+            _batchFill({first.x, first.y, w, 1}, colour);
+            }
+        _spi.yield();
+        }
+    _spi.end();
+    }
+
+/*****************************************************************************\
+|* Method : Draw several horizontal lines, each in its own colour. Only
+|* lines in the same row can overlap, and the sort keeps those in the order
+|* they were given, so the last one still ends up on top
+\*****************************************************************************/
+void Ili9481::drawHLines(const HLine *lines, int num)
+    {
+    uint8_t order[BATCH_SORT];
+
+    _spi.begin();
+    for (int at=0; at<num; at+=BATCH_SORT)
+        {
+        const HLine *l  = lines + at;
+        int n           = MIN(num - at, BATCH_SORT);
+        _sortBatch(order, n, [=](int a, int b)
+            {
+            return l[a].y < l[b].y;
+            });
+
+        for (int i=0; i<n; i++)
+            {
+            const HLine &h = l[order[i]];
+            _batchFill({h.x, h.y, h.w, 1}, h.colour);
+            }
+        _spi.yield();
+        }
+    _spi.end();
+    }
+
+/*****************************************************************************\
+|* Method : Stream an image to the screen through two line buffers. While
+|* one is on its way out (by DMA, if the SPI is in DMA mode), the source
+|* fills the other, so decoding overlaps the transfer
+\*****************************************************************************/
+int Ili9481::drawImage(Point p, ImageSource *src)
+    {
+    if (src == nullptr)
+        return E_INVALID;
+
+    return drawImage(p, src, {0, 0, src->width(), src->height()});
+    }
+
+/*****************************************************************************\
+|* Method : Stream part of an image, with the top-left of 'part' at 'p'
+\*****************************************************************************/
+int Ili9481::drawImage(Point p, ImageSource *src, Rect part)
+    {
+    if (src == nullptr)
+        return E_INVALID;
+
+    int w       = src->width();
+    int h       = src->height();
+
+    /*************************************************************************\
+    |* Keep the part inside the image, moving 'p' to match
     \*************************************************************************/
-    _writeCommand(SPI_CMD_SET_COLUMN_ADDRESS, false);
-    _writeData((r.x >> 8) & 0xFF, false);
-    _writeData((r.x & 0xFF), false);
-    _writeData(((r.x + r.w) >> 8) & 0xFF, false);
-    _writeData(((r.x + r.w) & 0xFF), false);
- 
+    int px0     = MAX(part.x, 0);
+    int py0     = MAX(part.y, 0);
+    int px1     = MIN(part.x + part.w, w);
+    int py1     = MIN(part.y + part.h, h);
+    p.x        += px0 - part.x;
+    p.y        += py0 - part.y;
+
     /*************************************************************************\
-    |* Set the bottom right corner
+    |* Clipping : work out the visible part, and return if there isn't one
     \*************************************************************************/
-    _writeCommand(SPI_CMD_SET_ROW_ADDRESS, false);
-    _writeData((r.y >> 8) & 0xFF, false);
-    _writeData((r.y & 0xFF), false);
-    _writeData(((r.y + r.h) >> 8) & 0xFF, false);
-    _writeData(((r.y + r.h) & 0xFF), false);
- 
+    int x0      = MAX(p.x, _clip.x);
+    int y0      = MAX(p.y, _clip.y);
+    int x1      = MIN(p.x + px1 - px0, _clip.x + _clip.w);
+    int y1      = MIN(p.y + py1 - py0, _clip.y + _clip.h);
+    if ((x1 <= x0) || (y1 <= y0))
+        return E_OK;
+
+    /*************************************************************************\
+    |* Image rows [top, bottom) and columns [skip, skip+span) are visible
+    \*************************************************************************/
+    int top     = py0 + y0 - p.y;
+    int bottom  = py0 + y1 - p.y;
+    int stride  = w * 3;
+    int skip    = (px0 + x0 - p.x) * 3;
+    int span    = (x1 - x0) * 3;
+    int per     = MAX(1, PIPE_BUFFER_BYTES / stride);
+    bool rect   = _region.rectangular();
+    if (_reserveLines(per * stride) != E_OK)
+        return E_NO_RESOURCE;
+
     /*************************************************************************\
-    |* Take CS high
+    |* Open the window, then alternate between the two buffers. If the clip
+    |* isn't a rectangle, each batch of lines goes through its own windows
     \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::HI);
+    _spi.begin();
+    if (rect)
+        {
+        Rect win = {x0, y0, x1 - x0, y1 - y0};
+        _note(win);
+        _setWindow(win);
+        _sendCommand(SPI_CMD_WRITE_MEMORY_START);
+        }
+
+    int y   = 0;
+    int cur = 0;
+    while (y < bottom)
+        {
+        int n = src->readLines(_lines[cur], MIN(per, bottom - y));
+        if (n <= 0)
+            break;
+
+        /*********************************************************************\
+        |* Lines above the visible part are read but not sent. If whole 
+        |* lines are visible they can all go in one transfer
+        \*********************************************************************/
+        int first       = MAX(0, top - y);
+        uint8_t *line   = _lines[cur] + first * stride;
+        if (!rect)
+            {
+            if (n > first)
+                _pushWireClipped({x0, p.y + y + first - py0, x1 - x0,
+                                  n - first}, line + skip, stride);
+            }
+        else if (span == stride)
+            {
+            if (n > first)
+                _spi.writeAsync(line, (n - first) * stride);
+            }
+        else
+            for (int i=first; i<n; i++, line += stride)
+                _spi.writeAsync(line + skip, span);
+
+        y   += n;
+        cur ^= 1;
+
+        if (!rect)
+            _spi.yield();
+        else if (y < bottom)
+            _yieldWrite();
+        }
+    _spi.end();
+
+    return E_OK;
     }
 
+/*****************************************************************************\
+|* Method : Decode a JPEG straight to the screen, one MCU at a time
+\*****************************************************************************/
+int Ili9481::drawJpeg(Point p, JpegDecoder *jpg)
+    {
+    if (jpg == nullptr)
+        return E_INVALID;
+
+    jpg->rewind();
+
+    /*************************************************************************\
+    |* The clip, in image co-ordinates, so the decoder can skip MCUs
+    \*************************************************************************/
+    Rect visible = {_clip.x - p.x, _clip.y - p.y, _clip.w, _clip.h};
+    int bottom   = _clip.y + _clip.h;
+
+    const uint8_t *pixels;
+    Rect where;
+    int ok;
+
+    _spi.begin();
+    while ((ok = jpg->decodeMcu(&pixels, &where, &visible)) > 0)
+        {
+        if (where.y + p.y >= bottom)
+            break;
+        if ((where.w == 0) || (where.h == 0))
+            continue;
+
+        where.x += p.x;
+        where.y += p.y;
+        _pushWireClipped(where, pixels, where.w * 3);
+        _spi.yield();
+        }
+    _spi.end();
+
+    return (ok < 0) ? ok : E_OK;
+    }
 
 /*****************************************************************************\
-|* Private Method : Push a block of N 16-bit words to the LCD.
-|*
-|* On entry to this method, CS ought to be already low
+|* Method : Draw an RLE asset, span by span. Each part of it inside the clip
+|* region is a window of its own, and the asset is decoded again for each
 \*****************************************************************************/
-void Ili9481::_pushBlock(Rect r, RGB rgb, bool handleCS)
+int Ili9481::drawRle(Point p, RleSource *img)
     {
+    if (img == nullptr)
+        return E_INVALID;
+
     /*************************************************************************\
-    |* Take CS low
+    |* Indexed literals have to be expanded before they can be sent
     \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::LO);
+    if (img->paletted() && (_reserveLines(RLE_MAX_LITERAL * 3) != E_OK))
+        return E_NO_RESOURCE;
+
+    Rect r  = {p.x, p.y, img->width(), img->height()};
+    int ok  = E_OK;
+
+    _spi.begin();
+    _region.clip(r, [&](Rect part)
+        {
+        if (ok == E_OK)
+            ok = _sendRle(img, r, part);
+        });
+    _spi.end();
+
+    return ok;
+    }
+
+/*****************************************************************************\
+|* Method : Fill a rectangle from a plain shader function
+\*****************************************************************************/
+int Ili9481::fillRect(Rect r, ShaderFn fn, void *ctx)
+    {
+    if (fn == nullptr)
+        return E_INVALID;
+
+    return fillRect(r, [fn, ctx](int x, int y, int n, uint8_t *dst)
+                        { fn(ctx, x, y, n, dst); });
+    }
+
+/*****************************************************************************\
+|* Method : Transformed blit. The next row is sampled while the last one is
+|* still going out
+\*****************************************************************************/
+int Ili9481::blitTransformed(const Bitmap &src, PixelFormat fmt,
+                             const Affine &matrix, Rect dstClip,
+                             AffineSampler::Filter filter)
+    {
+    AffineSampler sampler;
+    if (sampler.setup(src, fmt, matrix, filter) != E_OK)
+        return E_INVALID;
+
+    Rect b  = sampler.bounds();
+    int x0  = MAX(MAX(b.x, dstClip.x), _clip.x);
+    int y0  = MAX(MAX(b.y, dstClip.y), _clip.y);
+    int x1  = MIN(MIN(b.x + b.w, dstClip.x + dstClip.w), _clip.x + _clip.w);
+    int y1  = MIN(MIN(b.y + b.h, dstClip.y + dstClip.h), _clip.y + _clip.h);
+    if ((x1 <= x0) || (y1 <= y0))
+        return E_OK;
+
+    if (_reserveLines((x1 - x0) * 3) != E_OK)
+        return E_NO_RESOURCE;
+
+    int cur = 0;
+    _spi.begin();
+    for (int y=y0; y<y1; y++)
+        {
+        int sx0, sx1;
+        if (!sampler.span(y, &sx0, &sx1))
+            continue;
+        sx0 = MAX(sx0, x0);
+        sx1 = MIN(sx1, x1);
+        if (sx1 <= sx0)
+            continue;
+
+        /*********************************************************************\
+        |* A row the clip region cuts goes out a part at a time
+        \*********************************************************************/
+        const uint8_t *line = _lines[cur];
+        sampler.sample(sx0, y, sx1 - sx0, _lines[cur]);
+        _region.clip({sx0, y, sx1 - sx0, 1}, [&](Rect part)
+            {
+            _note(part);
+            _setWindow(part);
+            _sendCommand(SPI_CMD_WRITE_MEMORY_START);
+            _spi.writeAsync(line + (part.x - sx0) * 3, part.w * 3);
+            });
+        cur ^= 1;
+
+        _spi.yield();
+        }
+    _spi.end();
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Blit a bitmap rotated and/or mirrored, by changing the order the
+|* controller fills the window in rather than moving any pixels.
+|*
+|* Only the write-order bits (page/column exchange and the two address
+|* orders) are changed. The flip bits that setRotation() uses mirror the
+|* whole panel, so they're left alone
+\*****************************************************************************/
+int Ili9481::blit(Point p, const Bitmap &src, PixelFormat fmt, int op)
+    {
+    if ((src.pixels == nullptr) || (src.w <= 0) || (src.h <= 0))
+        return E_INVALID;
+
+    int dw  = (op & 1) ? src.h : src.w;
+    int dh  = (op & 1) ? src.w : src.h;
+    int ok  = E_OK;
+
+    _region.clip({p.x, p.y, dw, dh}, [&](Rect part)
+        {
+        if (ok == E_OK)
+            ok = _blitPart(p, src, fmt, op, part);
+        });
+
+    return ok;
+    }
+
+/*****************************************************************************\
+|* Method : Wu's anti-aliased line. Each step along the major axis lights
+|* the two pixels either side of the true line, split by distance
+\*****************************************************************************/
+void Ili9481::lineAA(Point p0, Point p1, RGB rgb, const Backdrop &bg)
+    {
+    int dx = p1.x - p0.x;
+    int dy = p1.y - p0.y;
 
-    
     /*************************************************************************\
-    |* Signal that we're about to write pixel data
+    |* Straight and diagonal lines fall exactly on pixels
     \*************************************************************************/
-    _writeCommand(SPI_CMD_WRITE_MEMORY_START, false);
+    if ((dx == 0) || (dy == 0) || (ABS(dx) == ABS(dy)))
+        {
+        line(p0, p1, rgb);
+        return;
+        }
+
+    bool steep = ABS(dy) > ABS(dx);
+    if (steep)
+        {
+        Swapper(p0.x, p0.y);
+        Swapper(p1.x, p1.y);
+        }
+    if (p0.x > p1.x)
+        Swapper(p0, p1);
+
+    int32_t grad    = (int32_t)(((int64_t)(p1.y - p0.y) << 16) / (p1.x - p0.x));
+    int32_t y       = p0.y << 16;
+
+    _aaBegin(rgb, bg);
+    for (int x=p0.x; x<=p1.x; x++, y += grad)
+        {
+        int yi  = y >> 16;
+        int f   = (y >> 8) & 0xFF;
+        if (steep)
+            {
+            _aaPlot(yi,     x, 255 - f);
+            _aaPlot(yi + 1, x, f);
+            }
+        else
+            {
+            _aaPlot(x, yi,     255 - f);
+            _aaPlot(x, yi + 1, f);
+            }
+        }
+    _aaEnd();
+    }
+
+/*****************************************************************************\
+|* Method : Anti-aliased circle. The edge is found exactly for each step
+|* along one octant, which is then walked eight times (once per mirror
+|* image) so that each pass stays in one part of the screen and batches
+|* well. A filled circle is the plain fill with a soft rim
+\*****************************************************************************/
+void Ili9481::circleAA(Point p, int r, RGB rgb, const Backdrop &bg, bool fill)
+    {
+    if (r <= 0)
+        {
+        plot(p, rgb);
+        return;
+        }
+
+    if (fill)
+        circle(p, r, rgb, true);
+
+    int r2 = r * r;
+
+    _aaBegin(rgb, bg);
+    for (int o=0; o<8; o++)
+        {
+        int sx      = (o & 1) ? -1 : 1;
+        int sy      = (o & 2) ? -1 : 1;
+        bool swap   = (o & 4) != 0;
+
+        /*********************************************************************\
+        |* The mirror images meet on the axes; only draw that pixel once
+        \*********************************************************************/
+        int a = ((swap ? sy : sx) < 0) ? 1 : 0;
+        for (; 2 * a * a <= r2; a++)
+            {
+            uint32_t edge   = _isqrt64((uint64_t)(r2 - a * a) << 16);
+            int b           = edge >> 8;
+            int f           = edge & 0xFF;
+            int in          = fill ? 255 : 255 - f;
+
+            if (swap)
+                {
+                _aaPlot(p.x + sx * b,       p.y + sy * a, in);
+                _aaPlot(p.x + sx * (b + 1), p.y + sy * a, f);
+                }
+            else
+                {
+                _aaPlot(p.x + sx * a, p.y + sy * b,       in);
+                _aaPlot(p.x + sx * a, p.y + sy * (b + 1), f);
+                }
+            }
+        _aaFlush();
+        }
+    _aaEnd();
+    }
+
+/*****************************************************************************\
+|* Method : Draw through a coverage map. The whole rectangle goes out as one
+|* window, through the shader path, with each row built from the backdrop
+\*****************************************************************************/
+int Ili9481::drawCoverage(Point p, const uint8_t *alpha, int w, int h,
+                          RGB rgb, const Backdrop &bg)
+    {
+    if ((alpha == nullptr) || (w <= 0) || (h <= 0))
+        return E_INVALID;
+
+    struct
+        {
+        Point           p;
+        const uint8_t * alpha;
+        int             w;
+        RGB             fg;
+        const Backdrop *bg;
+
+        inline void operator()(int x, int y, int n, uint8_t *dst)
+            {
+            (*bg)(x, y, n, dst);
+            const uint8_t *cov = alpha + (y - p.y) * w + (x - p.x);
+            for (int i=0; i<n; i++, dst += 3)
+                if (cov[i] != 0)
+                    blendWire(dst, fg, cov[i]);
+            }
+        } shader = {p, alpha, w, rgb, &bg};
+
+    return fillRect({p.x, p.y, w, h}, shader);
+    }
+
+/*****************************************************************************\
+|* Method : Read a rectangle of GRAM back. Wire-format reads go straight
+|* into the caller's buffer; RGB565 goes through the line buffers a few
+|* rows at a time
+\*****************************************************************************/
+int Ili9481::readRect(Rect r, void *dst, PixelFormat fmt)
+    {
+    if ((dst == nullptr) || (r.w <= 0) || (r.h <= 0)
+        || (r.x < _bounds.x) || (r.y < _bounds.y)
+        || (r.x + r.w > _bounds.x + _bounds.w)
+        || (r.y + r.h > _bounds.y + _bounds.h))
+        return E_INVALID;
+
+    if (fmt == PF_WIRE)
+        {
+        _readBlock(r, (uint8_t *)dst);
+        _fixReadback((uint8_t *)dst, r.w * r.h);
+        return E_OK;
+        }
+
+    int stride = r.w * 3;
+    if (_reserveLines(stride) != E_OK)
+        return E_NO_RESOURCE;
+
+    uint16_t *out   = (uint16_t *)dst;
+    int per         = MAX(1, _lineBytes / stride);
+    int bottom      = r.y + r.h;
+    for (int y=r.y; y<bottom; y+=per)
+        {
+        int n = MIN(per, bottom - y);
+        _readBlock({r.x, y, r.w, n}, _lines[0]);
+        _fixReadback(_lines[0], r.w * n);
+
+        const uint8_t *p = _lines[0];
+        for (int i=0; i<r.w*n; i++, p += 3)
+            *out++ = ((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3);
+        }
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Send the screen (or part of it) over stdio as a binary PPM.
+|* Bytes go out raw, since CR/LF translation would corrupt the image
+\*****************************************************************************/
+int Ili9481::screenshot(void)
+    {
+    return screenshot(_bounds);
+    }
+
+int Ili9481::screenshot(Rect r)
+    {
+    int stride = r.w * 3;
+    if ((r.w <= 0) || (r.h <= 0))
+        return E_INVALID;
+    if (_reserveLines(stride) != E_OK)
+        return E_NO_RESOURCE;
+
+    char header[32];
+    int len = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", r.w, r.h);
+
+    int per     = MAX(1, _lineBytes / stride);
+    int bottom  = r.y + r.h;
+    for (int y=r.y; y<bottom; y+=per)
+        {
+        int n   = MIN(per, bottom - y);
+        int ok  = readRect({r.x, y, r.w, n}, _lines[0], PF_WIRE);
+        if (ok != E_OK)
+            return ok;
+
+        for (int i=0; (y == r.y) && (i<len); i++)
+            putchar_raw(header[i]);
+
+        /*********************************************************************\
+        |* Widen each 6-bit value to 8 bits, so white is 255
+        \*********************************************************************/
+        for (int i=0; i<n*stride; i++)
+            putchar_raw(_lines[0][i] | (_lines[0][i] >> 6));
+        }
+    fflush(stdout);
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Blend a colour over what's on the screen, by reading it back.
+|* Meant for small regions: it costs a slow read as well as a write
+\*****************************************************************************/
+int Ili9481::blendRect(Rect r, RGB rgb, int alpha)
+    {
+    int x0 = MAX(r.x, _clip.x);
+    int x1 = MIN(r.x + r.w, _clip.x + _clip.w);
+    if ((x1 <= x0) || (alpha <= 0))
+        return E_OK;
+
+    alpha       = MIN(alpha, 255);
+    int stride  = (x1 - x0) * 3;
+    if (_reserveLines(stride) != E_OK)
+        return E_NO_RESOURCE;
 
     /*************************************************************************\
-    |* And do so...
+    |* Each part inside the clip region is read and written back in strips
     \*************************************************************************/
-    uint8_t buf[3]  = {rgb.r, rgb.g, rgb.b};
-    int num         = (r.w + 1) * (r.h + 1);
-    for (int i=0; i<num; i++)
-        spi_write_blocking(_spi.device(), buf,3);
+    int per = MAX(1, _lineBytes / stride);
+    _region.clip(r, [&](Rect part)
+        {
+        for (int y=part.y; y<part.y+part.h; y+=per)
+            {
+            Rect strip = {part.x, y, part.w, MIN(per, part.y + part.h - y)};
+            _readBlock(strip, _lines[0]);
+            _fixReadback(_lines[0], strip.w * strip.h);
+
+            uint8_t *p = _lines[0];
+            for (int i=0; i<strip.w*strip.h; i++, p += 3)
+                blendWire(p, rgb, alpha);
+
+            _spi.begin();
+            _note(strip);
+            _setWindow(strip);
+            _pushWire(strip, _lines[0]);
+            _spi.end();
+            }
+        });
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Move a rectangle of GRAM. It's read back in strips of whole
+|* rows, as many as fit in a line buffer, and each strip is written out
+|* before the next is read. When moving down the strips go bottom-up (and
+|* otherwise top-down), so no source row is overwritten before it's read.
+|* The bus is half-duplex, so strips are read and then written in turn,
+|* with nothing overlapping, and one line buffer does
+\*****************************************************************************/
+int Ili9481::copyRect(Rect src, Point dst)
+    {
+    int dx = dst.x - src.x;
+    int dy = dst.y - src.y;
 
     /*************************************************************************\
-    |* Take CS high
+    |* The destination has to be inside the clip, and the source on the panel
     \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::HI);
+    int x0 = MAX(dst.x, MAX(_clip.x, _bounds.x + dx));
+    int y0 = MAX(dst.y, MAX(_clip.y, _bounds.y + dy));
+    int x1 = MIN(dst.x + src.w,
+                 MIN(_clip.x + _clip.w, _bounds.x + _bounds.w + dx));
+    int y1 = MIN(dst.y + src.h,
+                 MIN(_clip.y + _clip.h, _bounds.y + _bounds.h + dy));
+    if ((x1 <= x0) || (y1 <= y0) || ((dx == 0) && (dy == 0)))
+        return E_OK;
+
+    int w       = x1 - x0;
+    int h       = y1 - y0;
+    int stride  = w * 3;
+    if (_reserveLines(stride) != E_OK)
+        return E_NO_RESOURCE;
+
+    int per         = MAX(1, _lineBytes / stride);
+    uint8_t *strip  = _lines[0];
+
+    _spi.begin();
+    for (int k=0; k<h; k+=per)
+        {
+        int n   = MIN(per, h - k);
+        int off = (dy > 0) ? h - k - n : k;
+
+        _readBlock({x0 - dx, y0 + off - dy, w, n}, strip);
+        _fixReadback(strip, w * n);
+
+        /*********************************************************************\
+        |* The whole strip is read before any of it is written, so it can go
+        |* back out a part of the clip region at a time
+        \*********************************************************************/
+        _region.clip({x0, y0 + off, w, n}, [&](Rect part)
+            {
+            const uint8_t *line = strip + (part.y - y0 - off) * stride
+                                + (part.x - x0) * 3;
+            _note(part);
+            _setWindow(part);
+            _sendCommand(SPI_CMD_WRITE_MEMORY_START);
+            if (part.w == w)
+                _spi.writeAsync(line, part.h * stride);
+            else
+                for (int y=0; y<part.h; y++, line += stride)
+                    _spi.writeAsync(line, part.w * 3);
+            });
+
+        _spi.yield();
+        }
+    _spi.end();
+
+    return E_OK;
+    }
+
+#pragma mark - Private Methods
+
+/*****************************************************************************\
+|* Private Method : Run the init script up to the next delay, or the end
+\*****************************************************************************/
+void Ili9481::_stepInitScript(void)
+    {
+	uint8_t numBytes;
+
+	while ((numBytes=(*_initAddr++))>0)         // end marker == 0
+        { 
+		if ( numBytes & LCD_DELAY) 
+            {
+			uint8_t tmp = *_initAddr++;         // up to 255 millis
+            if (!_initWarm)
+                {
+                _initWake = make_timeout_time_ms(tmp);
+                return;
+                }
+		    } 
+        else
+            {
+            uint8_t cmd = _initAddr[0];
+
+            /*****************************************************************\
+            |* A warm panel is already awake, and resetting it would undo that
+            \*****************************************************************/
+            if (!_initWarm 
+                || ((cmd != SPI_CMD_SOFT_RESET) && (cmd != SPI_CMD_EXIT_SLEEP)))
+                _sendCommand(cmd, _initAddr + 1, numBytes - 1);
+            _initAddr += numBytes;
+		    }
+	    }
+
+    /*************************************************************************\
+    |* Optionally find out how fast this particular panel can go
+    \*************************************************************************/
+    if (_ctx.calibrate)
+        calibrate();
+
+    _initState = INIT_DONE;
+    }
+
+/*****************************************************************************\
+|* Private Method : Check whether the panel is awake, on, and in our pixel
+|* format - ie: it survived an MCU-only reboot
+\*****************************************************************************/
+bool Ili9481::_isConfigured(void)
+    {
+    uint8_t power[2]    = {0, 0};
+    uint8_t format[2]   = {0, 0};
+
+    _readRegister(SPI_CMD_READ_POWER_MODE, power, 2);
+    _readRegister(SPI_CMD_READ_PIXEL_FORMAT, format, 2);
+
+    return ((power[1] & (PM_SLEEP_OUT | PM_DISPLAY_ON)) 
+                     == (PM_SLEEP_OUT | PM_DISPLAY_ON))
+        && (format[1] == PIXEL_FORMAT_18BPP);
+    }
+
+/*****************************************************************************\
+|* Private Method : Read a register. The first byte back is a dummy
+\*****************************************************************************/
+void Ili9481::_readRegister(uint8_t cmd, uint8_t *dst, int len)
+    {
+    Spi::Segment seg = {Spi::COMMAND, &cmd, 1, 1};
+
+    _spi.setSpeed(_readMhz);
+    _spi.begin();
+    _spi.transaction(&seg, 1);
+    _spi.read(dst, len);
+    _spi.end();
+    _spi.setSpeed(_writeMhz);
+    }
+
+/*****************************************************************************\
+|* Private Method : send a command and its parameters as one transaction
+\*****************************************************************************/
+void Ili9481::_sendCommand(uint8_t cmd, const uint8_t *params, int num)
+    {
+    Spi::Segment segs[2] =
+        {
+        {Spi::COMMAND,  &cmd,   1,      1},
+        {Spi::DATA,     params, num,    1},
+        };
+
+    _spi.transaction(segs, (num > 0) ? 2 : 1);
+    }
+
+/*****************************************************************************\
+|* Private Method : set the active window in which to write data. The
+|* controller keeps the column and page ranges until they're changed, so
+|* either half that's the same as last time isn't sent again
+\*****************************************************************************/
+void Ili9481::_setWindow(Rect r)
+    {
+    int x1 = r.x + r.w - 1;
+    int y1 = r.y + r.h - 1;
+
+    uint8_t cols[4] = {(uint8_t)(r.x >> 8), (uint8_t)r.x, 
+                       (uint8_t)(x1  >> 8), (uint8_t)x1};
+    uint8_t rows[4] = {(uint8_t)(r.y >> 8), (uint8_t)r.y, 
+                       (uint8_t)(y1  >> 8), (uint8_t)y1};
+    uint8_t cmds[2] = {SPI_CMD_SET_COLUMN_ADDRESS, SPI_CMD_SET_ROW_ADDRESS};
+
+    /*************************************************************************\
+    |* Top-left and bottom-right corners, all under one CS assertion
+    \*************************************************************************/
+    Spi::Segment segs[4];
+    int num = 0;
+
+    if ((r.x != _window.x) || (r.w != _window.w))
+        {
+        segs[num++] = {Spi::COMMAND,  &cmds[0],   1,  1};
+        segs[num++] = {Spi::DATA,     cols,       4,  1};
+        }
+    if ((r.y != _window.y) || (r.h != _window.h))
+        {
+        segs[num++] = {Spi::COMMAND,  &cmds[1],   1,  1};
+        segs[num++] = {Spi::DATA,     rows,       4,  1};
+        }
+
+    _window = r;
+    if (num > 0)
+        _spi.transaction(segs, num);
+    }
+
+/*****************************************************************************\
+|* Private Method : Keep the palette shadow in step with what's drawn, so an
+|* entry that changes later isn't repainted over something else
+\*****************************************************************************/
+void Ili9481::_note(Rect r, bool solid)
+    {
+    if (_palette != nullptr)
+        _palette->mark(r, (solid && (_ink >= 0)) ? _ink : PALETTE_NONE);
+    }
+
+/*****************************************************************************\
+|* Private Method : Fill the current window with a colour
+\*****************************************************************************/
+void Ili9481::_pushBlock(Rect r, RGB rgb)
+    {
+    _pushRun(rgb, r.w * r.h, true);
+    }
+
+/*****************************************************************************\
+|* Private Method : Send 'num' pixels of one colour. If 'start' is set this
+|* begins a new write to the window, otherwise it carries on from wherever
+|* the last write got to.
+|*
+|* The colour is pre-packed into a short run of pixels which is then repeated,
+|* so the FIFO is fed without any per-pixel work
+\*****************************************************************************/
+void Ili9481::_pushRun(RGB rgb, int num, bool start)
+    {
+    uint32_t key = (rgb.r << 16) | (rgb.g << 8) | rgb.b;
+    if (key != _fillKey)
+        {
+        for (int i=0; i<FILL_PIXELS*3; i+=3)
+            {
+            _fill[i]    = rgb.r;
+            _fill[i+1]  = rgb.g;
+            _fill[i+2]  = rgb.b;
+            }
+        _fillKey = key;
+        }
+
+    uint8_t cmd = SPI_CMD_WRITE_MEMORY_START;
+    int cmdLen  = start ? 1 : 0;
+    int chunk   = _chunkPixels(num);
+
+    /*************************************************************************\
+    |* On a shared bus this goes out a chunk at a time. If another core takes
+    |* the bus in between, the write picks up again with "memory continue"
+    \*************************************************************************/
+    _spi.begin();
+    while (num > 0)
+        {
+        int n = MIN(num, chunk);
+
+        Spi::Segment segs[3] =
+            {
+            {Spi::COMMAND,  &cmd,   cmdLen,                 1},
+            {Spi::DATA,     _fill,  FILL_PIXELS * 3,        n / FILL_PIXELS},
+            {Spi::DATA,     _fill,  (n % FILL_PIXELS) * 3,  1},
+            };
+
+        _spi.transaction(segs, 3);
+        num    -= n;
+        cmdLen  = 0;
+
+        if ((num > 0) && _spi.yield())
+            {
+            cmd     = SPI_CMD_WRITE_MEMORY_CONTINUE;
+            cmdLen  = 1;
+            }
+        }
+    _spi.end();
+    }
+
+/*****************************************************************************\
+|* Private Method : Push a block of RGB565 pixels to the current window
+\*****************************************************************************/
+void Ili9481::_pushBlock(Rect r, uint16_t *rgb)
+    {
+    uint8_t cmd         = SPI_CMD_WRITE_MEMORY_START;
+    Spi::Segment seg    = {Spi::COMMAND, &cmd, 1, 1};
+
+    _spi.begin();
+    _spi.transaction(&seg, 1);
+
+    /*************************************************************************\
+    |* Convert a short run at a time, and send each as it's ready
+    \*************************************************************************/
+    uint8_t buf[FILL_PIXELS * 3];
+    int num     = r.w * r.h;
+    int chunk   = _chunkPixels(num);
+    int sent    = 0;
+    while (num > 0)
+        {
+        int n = MIN(num, FILL_PIXELS);
+        for (int i=0; i<n*3; i+=3)
+            {
+            uint16_t pix = *rgb ++;
+            buf[i]      = (pix >> 8) & 0xF8;
+            buf[i+1]    = (pix >> 3) & 0xFC;
+            buf[i+2]    = (pix << 3) & 0xF8;
+            }
+
+        seg = {Spi::DATA, buf, n * 3, 1};
+        _spi.transaction(&seg, 1);
+        num    -= n;
+        sent   += n;
+
+        /*********************************************************************\
+        |* Let another core at a shared bus, then carry on where we left off
+        \*********************************************************************/
+        if ((num > 0) && (sent >= chunk))
+            {
+            sent = 0;
+            if (_spi.yield())
+                _sendCommand(SPI_CMD_WRITE_MEMORY_CONTINUE);
+            }
+        }
+
+    _spi.end();
+    }
+
+
+/*****************************************************************************\
+|* Private Method : How many pixels to send between chances to yield a
+|* shared bus. Without one, there's no reason to split anything up
+\*****************************************************************************/
+int Ili9481::_chunkPixels(int num)
+    {
+    if (_spi.bus() == nullptr)
+        return num;
+
+    int chunk = _spi.bus()->chunkBytes() / (3 * FILL_PIXELS);
+    return MAX(1, chunk) * FILL_PIXELS;
+    }
+
+/*****************************************************************************\
+|* Private Method : Grow the image line buffers if they're too small
+\*****************************************************************************/
+int Ili9481::_reserveLines(int bytes)
+    {
+    if (bytes <= _lineBytes)
+        return E_OK;
+
+    FREE(_lines[0]);
+    FREE(_lines[1]);
+    _lineBytes  = 0;
+    _lines[0]   = (uint8_t *) malloc(bytes);
+    _lines[1]   = (uint8_t *) malloc(bytes);
+
+    if ((_lines[0] == nullptr) || (_lines[1] == nullptr))
+        {
+        printf(T_ERR "Cannot allocate %d bytes for image lines\n", bytes * 2);
+        FREE(_lines[0]);
+        FREE(_lines[1]);
+        return E_NO_RESOURCE;
+        }
+
+    _lineBytes = bytes;
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Make room for the rows of a recorded shape
+\*****************************************************************************/
+int Ili9481::_reserveRows(int rows)
+    {
+    if (rows <= _spanRowsNum)
+        return E_OK;
+
+    FREE(_spanRows);
+    _spanRowsNum    = 0;
+    _spanRows       = (int16_t *) malloc(rows * 2 * sizeof(int16_t));
+    if (_spanRows == nullptr)
+        return E_NO_RESOURCE;
+
+    _spanRowsNum = rows;
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Push wire-ready pixel data to the current window
+\*****************************************************************************/
+void Ili9481::_pushWire(Rect r, const uint8_t *data)
+    {
+    uint8_t cmd = SPI_CMD_WRITE_MEMORY_START;
+
+    Spi::Segment segs[2] =
+        {
+        {Spi::COMMAND,  &cmd,   1,              1},
+        {Spi::DATA,     data,   r.w * r.h * 3,  1},
+        };
+
+    _spi.transaction(segs, 2);
+    }
+
+/*****************************************************************************\
+|* Private Method : Push a block of wire-ready pixels covering 'r', rows
+|* 'stride' bytes apart, sending each part inside the clip region through
+|* its own window. Rows that are whole and packed go out in one transfer
+\*****************************************************************************/
+void Ili9481::_pushWireClipped(Rect r, const uint8_t *data, int stride)
+    {
+    _region.clip(r, [&](Rect part)
+        {
+        const uint8_t *line = data + (part.y - r.y) * stride
+                            + (part.x - r.x) * 3;
+        bool packed         = (part.w * 3 == stride);
+        uint8_t cmd         = SPI_CMD_WRITE_MEMORY_START;
+        Spi::Segment segs[2] =
+            {
+            {Spi::COMMAND,  &cmd,   1,                                  1},
+            {Spi::DATA,     line,   part.w * (packed ? part.h : 1) * 3, 1},
+            };
+
+        _note(part);
+        _setWindow(part);
+        _spi.transaction(segs, 2);
+        for (int y=1; !packed && (y<part.h); y++)
+            {
+            line           += stride;
+            segs[1].data    = line;
+            _spi.transaction(&segs[1], 1);
+            }
+        });
+    }
+
+/*****************************************************************************\
+|* Private Method : Start streaming rows into a part of the clip region
+\*****************************************************************************/
+int Ili9481::_beginStream(Rect r)
+    {
+    if (_record != nullptr)
+        {
+        _recordPart(r);
+        return 0;
+        }
+
+    int per = MAX(1, PIPE_BUFFER_BYTES / (r.w * 3));
+    if (_reserveLines(per * r.w * 3) != E_OK)
+        return E_NO_RESOURCE;
+
+    _spi.begin();
+    _note(r);
+    _setWindow(r);
+    _sendCommand(SPI_CMD_WRITE_MEMORY_START);
+    return per;
+    }
+
+/*****************************************************************************\
+|* Private Method : Blit the part 'vis' of the screen, in a write order of
+|* its own
+\*****************************************************************************/
+int Ili9481::_blitPart(Point p, const Bitmap &src, PixelFormat fmt, int op,
+                       Rect vis)
+    {
+    /*************************************************************************\
+    |* The visible part of the screen is a rectangle of the source too
+    \*************************************************************************/
+    int x1  = vis.x + vis.w;
+    int y1  = vis.y + vis.h;
+    Point a = _blitSource(op, src.w, src.h, vis.x - p.x, vis.y - p.y);
+    Point b = _blitSource(op, src.w, src.h, x1 - 1 - p.x, y1 - 1 - p.y);
+    Rect s  = {MIN(a.x, b.x), MIN(a.y, b.y), ABS(a.x - b.x) + 1,
+               ABS(a.y - b.y) + 1};
+
+    /*************************************************************************\
+    |* Find the write order that steps through the source in raster order:
+    |* the pixel after the first one in a row has to land one column on, and
+    |* the first pixel of the next row one page on
+    \*************************************************************************/
+    Point o     = _blitPlace(op, src.w, src.h, s.x,     s.y);
+    Point ox    = _blitPlace(op, src.w, src.h, s.x + 1, s.y);
+    Point oy    = _blitPlace(op, src.w, src.h, s.x,     s.y + 1);
+    Point m0    = _toMemory(_addressMode, {p.x + o.x,  p.y + o.y});
+    Point mx    = _toMemory(_addressMode, {p.x + ox.x, p.y + ox.y});
+    Point my    = _toMemory(_addressMode, {p.x + oy.x, p.y + oy.y});
+
+    uint8_t mode    = _addressMode;
+    Point start     = {0, 0};
+    bool found      = false;
+    for (int k=0; (k<8) && !found; k++)
+        {
+        mode = (_addressMode & ~AM_WRITE_ORDER)
+             | ((k & 1) ? AM_COLUMN_ORDER       : 0)
+             | ((k & 2) ? AM_PAGE_ORDER         : 0)
+             | ((k & 4) ? AM_SWAP_PAGE_COLUMN   : 0);
+
+        start       = _fromMemory(mode, m0);
+        Point cx    = _fromMemory(mode, mx);
+        Point cy    = _fromMemory(mode, my);
+        found       = (cx.x == start.x + 1) && (cx.y == start.y)
+                   && (cy.x == start.x) && (cy.y == start.y + 1);
+        }
+
+    if (!found)
+        {
+        printf(T_ERR "No write order blits op %d in address mode 0x%02x\n",
+               op, _addressMode);
+        return E_INVALID;
+        }
+
+    if ((fmt != PF_WIRE) && (_reserveLines(s.w * 3) != E_OK))
+        return E_NO_RESOURCE;
+
+    /*************************************************************************\
+    |* Switch the write order, send the rows, and put it back
+    \*************************************************************************/
+    _spi.begin();
+    _sendCommand(SPI_CMD_SET_ADDRESS_MODE, &mode, 1);
+    _note(vis);
+    _setWindow({start.x, start.y, s.w, s.h});
+    _sendCommand(SPI_CMD_WRITE_MEMORY_START);
+
+    int cur = 0;
+    for (int j=s.y; j<s.y+s.h; j++)
+        {
+        if (fmt == PF_WIRE)
+            {
+            const uint8_t *row = (const uint8_t *)src.pixels
+                               + (j * src.w + s.x) * 3;
+            if (s.w == src.w)
+                {
+                _spi.writeAsync(row, s.w * s.h * 3);
+                break;
+                }
+            _spi.writeAsync(row, s.w * 3);
+            }
+        else
+            {
+            uint8_t *dst = _lines[cur];
+            for (int i=s.x; i<s.x+s.w; i++, dst += 3)
+                bitmapFetch(src, fmt, i, j, dst);
+            _spi.writeAsync(_lines[cur], s.w * 3);
+            cur ^= 1;
+            }
+
+        if (j < s.y + s.h - 1)
+            _yieldWrite();
+        }
+
+    _sendCommand(SPI_CMD_SET_ADDRESS_MODE, &_addressMode, 1);
+    _spi.end();
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Send the part 'vis' of an RLE asset placed at 'r'. If it
+|* only loses rows, spans are just trimmed at either end; otherwise each is
+|* cut into rows, leaving out the columns outside the window
+\*****************************************************************************/
+int Ili9481::_sendRle(RleSource *img, Rect r, Rect vis)
+    {
+    int left    = vis.x - r.x;
+    int right   = left + vis.w;
+    int top     = (vis.y - r.y) * r.w;
+    int bottom  = (vis.y + vis.h - r.y) * r.w;
+    bool rows   = (vis.w == r.w);
+    int at      = 0;
+    int ok      = 0;
+    RleSource::Span span;
+
+    img->rewind();
+    _note(vis);
+    _setWindow(vis);
+    _sendCommand(SPI_CMD_WRITE_MEMORY_START);
+
+    while ((at < bottom) && ((ok = img->nextSpan(&span)) > 0))
+        {
+        if (rows)
+            {
+            int from    = MAX(at, top);
+            int to      = MIN(at + span.count, bottom);
+            if (to > from)
+                _pushRleSpan(img, span, from - at, to - from);
+            }
+        else
+            for (int done=0; done<span.count; )
+                {
+                int x   = (at + done) % r.w;
+                int k   = MIN(span.count - done, r.w - x);
+                int a   = MAX(x, left);
+                int b   = MIN(x + k, right);
+                if ((at + done >= top) && (at + done < bottom) && (b > a))
+                    _pushRleSpan(img, span, done + a - x, b - a);
+                done   += k;
+                }
+
+        at += span.count;
+        _yieldWrite();
+        }
+
+    return (ok < 0) ? ok : E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Send 'num' pixels of an RLE span, starting 'skip' pixels
+|* in, to the current write. Long runs go through the solid-fill path
+\*****************************************************************************/
+void Ili9481::_pushRleSpan(RleSource *img, const RleSource::Span &span,
+                           int skip, int num)
+    {
+    if (span.run && (num >= FILL_PIXELS))
+        {
+        RGB rgb;
+        rgb.r = span.data[0];
+        rgb.g = span.data[1];
+        rgb.b = span.data[2];
+        _pushRun(rgb, num, false);
+        return;
+        }
+
+    Spi::Segment seg;
+    if (span.run)
+        seg = {Spi::DATA, span.data, 3, num};
+    else if (!img->paletted())
+        seg = {Spi::DATA, span.data + skip * 3, num * 3, 1};
+    else
+        {
+        uint8_t *dst = _lines[0];
+        for (int i=0; i<num; i++, dst += 3)
+            memcpy(dst, img->colour(span.data[skip + i]), 3);
+        seg = {Spi::DATA, _lines[0], num * 3, 1};
+        }
+    _spi.transaction(&seg, 1);
+    }
+
+/*****************************************************************************\
+|* Private Method : Yield a shared bus mid-write, and pick the write up again
+\*****************************************************************************/
+void Ili9481::_yieldWrite(void)
+    {
+    if (_spi.yield())
+        _sendCommand(SPI_CMD_WRITE_MEMORY_CONTINUE);
+    }
+
+/*****************************************************************************\
+|* Private Method : Start gathering anti-aliased pixels, under one CS
+\*****************************************************************************/
+void Ili9481::_aaBegin(RGB fg, const Backdrop &bg)
+    {
+    _aaNum  = 0;
+    _aaFg   = fg;
+    _aaBg   = &bg;
+    _spi.begin();
+    }
+
+/*****************************************************************************\
+|* Private Method : Add a pixel. If the window would then hold more than
+|* about twice as many pixels as are lit, send what's there first
+\*****************************************************************************/
+void Ili9481::_aaPlot(int x, int y, int cov)
+    {
+    if (cov <= 0)
+        return;
+
+    Rect box = {x, y, 1, 1};
+    if (_aaNum > 0)
+        {
+        int x0 = MIN(x, _aaBox.x);
+        int y0 = MIN(y, _aaBox.y);
+        int x1 = MAX(x + 1, _aaBox.x + _aaBox.w);
+        int y1 = MAX(y + 1, _aaBox.y + _aaBox.h);
+        box    = {x0, y0, x1 - x0, y1 - y0};
+
+        if ((_aaNum == AA_BATCH)
+            || (box.w * box.h > 2 * (_aaNum + 1) + AA_SLACK))
+            {
+            _aaFlush();
+            box = {x, y, 1, 1};
+            }
+        }
+
+    _aaPix[_aaNum++]    = {(int16_t)x, (int16_t)y, (uint8_t)MIN(cov, 255)};
+    _aaBox              = box;
+    }
+
+/*****************************************************************************\
+|* Private Method : Send the gathered pixels as one window: the backdrop,
+|* with each pixel blended over it. Where a pixel was added twice, the
+|* larger coverage wins
+\*****************************************************************************/
+void Ili9481::_aaFlush(void)
+    {
+    if (_aaNum == 0)
+        return;
+
+    uint8_t cov[2 * AA_BATCH + AA_SLACK];
+    uint8_t buf[(2 * AA_BATCH + AA_SLACK) * 3];
+    Rect b = _aaBox;
+
+    memset(cov, 0, b.w * b.h);
+    for (int i=0; i<_aaNum; i++)
+        {
+        int at  = (_aaPix[i].y - b.y) * b.w + (_aaPix[i].x - b.x);
+        cov[at] = MAX(cov[at], _aaPix[i].cov);
+        }
+
+    uint8_t *dst = buf;
+    for (int j=0; j<b.h; j++)
+        {
+        (*_aaBg)(b.x, b.y + j, b.w, dst);
+        for (int i=0; i<b.w; i++, dst += 3)
+            if (cov[j * b.w + i] != 0)
+                blendWire(dst, _aaFg, cov[j * b.w + i]);
+        }
+
+    _pushWireClipped(b, buf, b.w * 3);
+    _spi.yield();
+    _aaNum = 0;
+    }
+
+/*****************************************************************************\
+|* Private Method : Send anything left, and let CS go
+\*****************************************************************************/
+void Ili9481::_aaEnd(void)
+    {
+    _aaFlush();
+    _spi.end();
+    }
+
+/*****************************************************************************\
+|* Private Method : Integer square root, rounded down
+\*****************************************************************************/
+uint32_t Ili9481::_isqrt64(uint64_t v)
+    {
+    uint64_t root = 0;
+    uint64_t bit  = (uint64_t)1 << 62;
+
+    while (bit > v)
+        bit >>= 2;
+
+    while (bit != 0)
+        {
+        if (v >= root + bit)
+            {
+            v    -= root + bit;
+            root  = (root >> 1) + bit;
+            }
+        else
+            root >>= 1;
+        bit >>= 2;
+        }
+    return (uint32_t)root;
+    }
+
+/*****************************************************************************\
+|* Private Method : Where source pixel (i,j) goes, relative to the top-left
+|* of the destination. The mirror is applied first, then a clockwise turn
+\*****************************************************************************/
+Point Ili9481::_blitPlace(int op, int sw, int sh, int i, int j)
+    {
+    if (op & BLIT_MIRROR)
+        i = sw - 1 - i;
+
+    switch (op & 3)
+        {
+        case BLIT_ROTATE_90:
+            return {sh - 1 - j, i};
+        case BLIT_ROTATE_180:
+            return {sw - 1 - i, sh - 1 - j};
+        case BLIT_ROTATE_270:
+            return {j, sw - 1 - i};
+        default:
+            return {i, j};
+        }
+    }
+
+/*****************************************************************************\
+|* Private Method : The reverse of _blitPlace()
+\*****************************************************************************/
+Point Ili9481::_blitSource(int op, int sw, int sh, int x, int y)
+    {
+    Point s;
+    switch (op & 3)
+        {
+        case BLIT_ROTATE_90:
+            s = {y, sh - 1 - x};
+            break;
+        case BLIT_ROTATE_180:
+            s = {sw - 1 - x, sh - 1 - y};
+            break;
+        case BLIT_ROTATE_270:
+            s = {sw - 1 - y, x};
+            break;
+        default:
+            s = {x, y};
+            break;
+        }
+
+    if (op & BLIT_MIRROR)
+        s.x = sw - 1 - s.x;
+    return s;
+    }
+
+/*****************************************************************************\
+|* Private Method : Map a column/page address to a display memory location
+|* under an address mode. With the exchange bit set the column counter
+|* drives the memory pages and vice versa; the two order bits then reverse
+|* the memory columns and pages
+\*****************************************************************************/
+Point Ili9481::_toMemory(uint8_t mode, Point cp)
+    {
+    Point m = (mode & AM_SWAP_PAGE_COLUMN) ? Point{cp.y, cp.x} : cp;
+    if (mode & AM_COLUMN_ORDER)
+        m.x = GRAM_COLUMNS - 1 - m.x;
+    if (mode & AM_PAGE_ORDER)
+        m.y = GRAM_PAGES - 1 - m.y;
+    return m;
+    }
+
+/*****************************************************************************\
+|* Private Method : The reverse of _toMemory()
+\*****************************************************************************/
+Point Ili9481::_fromMemory(uint8_t mode, Point m)
+    {
+    if (mode & AM_COLUMN_ORDER)
+        m.x = GRAM_COLUMNS - 1 - m.x;
+    if (mode & AM_PAGE_ORDER)
+        m.y = GRAM_PAGES - 1 - m.y;
+    return (mode & AM_SWAP_PAGE_COLUMN) ? Point{m.y, m.x} : m;
+    }
+
+/*****************************************************************************\
+|* Private Method : Read pixels back from GRAM. The first byte after the
+|* command is a dummy, and the clock has to drop to the read rate. The read
+|* goes in chunks, and if another core takes the bus in between, it picks
+|* up again with Read Memory Continue (which has its own dummy byte)
+\*****************************************************************************/
+void Ili9481::_readBlock(Rect r, uint8_t *dst)
+    {
+    uint8_t cmd         = SPI_CMD_READ_MEMORY_START;
+    uint8_t dummy;
+    Spi::Segment seg    = {Spi::COMMAND, &cmd, 1, 1};
+    int left            = r.w * r.h * 3;
+
+    _spi.begin();
+    _setWindow(r);
+
+    _spi.setSpeed(_readMhz);
+    _spi.transaction(&seg, 1);
+    _spi.read(&dummy, 1);
+
+    while (left > 0)
+        {
+        int n = MIN(left, READ_CHUNK_BYTES);
+        _spi.read(dst, n);
+        dst  += n;
+        left -= n;
+
+        if ((left > 0) && _spi.yield())
+            {
+            cmd = SPI_CMD_READ_MEMORY_CONTINUE;
+            _spi.transaction(&seg, 1);
+            _spi.read(&dummy, 1);
+            }
+        }
+    _spi.end();
+
+    _spi.setSpeed(_writeMhz);
+    }
+
+/*****************************************************************************\
+|* Private Method : Tidy up pixels read back: drop the undefined low bits,
+|* and put the channels back in the order they were written
+\*****************************************************************************/
+void Ili9481::_fixReadback(uint8_t *data, int num)
+    {
+    for (int i=0; i<num; i++, data += 3)
+        {
+        uint8_t r = data[0] & 0xFC;
+        uint8_t b = data[2] & 0xFC;
+        data[0]   = _readBgr ? b : r;
+        data[1]  &= 0xFC;
+        data[2]   = _readBgr ? r : b;
+        }
+    }
+
+/*****************************************************************************\
+|* Private Method : Put back what calibration wrote its pattern over
+\*****************************************************************************/
+void Ili9481::_restoreCorner(Rect r, const uint8_t *data)
+    {
+    _window = {0, 0, 0, 0};
+    _spi.begin();
+    _setWindow(r);
+    _pushWire(r, data);
+    _spi.end();
     }
 
 /*****************************************************************************\
-|* Private Method : Push a block of N 16-bit words to the LCD.
+|* Private Method : Check a write clock / read clock pair.
 |*
-|* On entry to this method, CS ought to be already low
+|* The panel may hand pixels back in BGR order, so either order is accepted
+|* as long as every pixel agrees
 \*****************************************************************************/
-void Ili9481::_pushBlock(Rect r, uint16_t *rgb, bool handleCS)
+bool Ili9481::_verifyClocks(int writeMhz, int readMhz, const uint8_t *pattern)
     {
-    /*************************************************************************\
-    |* Take CS low
-    \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::LO);
+    _writeMhz   = writeMhz;
+    _readMhz    = readMhz;
+    _spi.setSpeed(_writeMhz);
 
     /*************************************************************************\
-    |* Signal that we're about to write pixel data
+    |* Address mode round-trip
     \*************************************************************************/
-    _writeCommand(SPI_CMD_WRITE_MEMORY_START, false);
+    _sendCommand(SPI_CMD_SET_ADDRESS_MODE, &_addressMode, 1);
+    if (fetchAddressMode() != (_addressMode & 0xF8))
+        return false;
 
     /*************************************************************************\
-    |* And do so...
+    |* GRAM round-trip, in the top-left corner
     \*************************************************************************/
-    uint8_t  buf[3];
-    int num         = (r.w + 1) * (r.h + 1);
-    for (int i=0; i<num; i++)
+    Rect r = {0, 0, CAL_PIXELS, 1};
+    uint8_t back[CAL_PIXELS * 3];
+
+    _window = {0, 0, 0, 0};
+    _spi.begin();
+    _setWindow(r);
+    _pushWire(r, pattern);
+    _spi.end();
+
+    // At a bad clock the window may not have arrived as sent
+    _window = {0, 0, 0, 0};
+    _readBlock(r, back);
+
+    bool rgb = true;
+    bool bgr = true;
+    for (int i=0; i<CAL_PIXELS*3; i+=3)
         {
-        uint16_t pix = *rgb ++;
-        buf[0] = (pix & 0xF800) >> 9;
-        buf[1] = (pix & 0x07E0) >> 3;
-        buf[2] = (pix & 0x003F) << 2;
-        spi_write_blocking(_spi.device(), buf,3);
+        rgb &= ((back[i]   & 0xFC) == pattern[i])
+            && ((back[i+1] & 0xFC) == pattern[i+1])
+            && ((back[i+2] & 0xFC) == pattern[i+2]);
+        bgr &= ((back[i]   & 0xFC) == pattern[i+2])
+            && ((back[i+1] & 0xFC) == pattern[i+1])
+            && ((back[i+2] & 0xFC) == pattern[i]);
         }
 
-    /*************************************************************************\
-    |* Take CS high
-    \*************************************************************************/
-    if (handleCS)
-        LCD_CS(Gpio::HI);
+    if (rgb || bgr)
+        _readBgr = !rgb;
+    return rgb || bgr;
     }
 
-
 /*****************************************************************************\
 |* Private Method : Optimised method to draw a horizontal line
 \*****************************************************************************/
 void Ili9481::_hline(int x, int y, int w, RGB colour)
+    {
+    _rectFill({x, y, w, 1}, colour);
+    }
+
+/*****************************************************************************\
+|* Private Method : Optimised method to draw a vertical line
+\*****************************************************************************/
+void Ili9481::_vline(int x, int y, int h, RGB colour)
+    {
+    _rectFill({x, y, 1, h}, colour);
+    }
+
+/*****************************************************************************\
+|* Private Method : Fill a rectangle on the display with a colour
+\*****************************************************************************/
+void Ili9481::_rectFill(Rect r, RGB colour)
     {
     /*************************************************************************\
-    |* Clipping : early exit if we're entirely out of bounds
+    |* Clipping : the region hands back each visible part, and CS stays low
+    |* for all of them
     \*************************************************************************/
-    if ((y < _clip.y) || (x >= _clip.x + _clip.w) || (y >= _clip.y + _clip.h))
+    if ((r.w < 1) || (r.h < 1)
+        || (r.x >= _clip.x + _clip.w) || (r.x + r.w <= _clip.x)
+        || (r.y >= _clip.y + _clip.h) || (r.y + r.h <= _clip.y))
         return;
-    
-    /*************************************************************************\
-    |* Clipping : adjust x
-    \*************************************************************************/
-    if (x < _clip.x)
+
+    if (_record != nullptr)
         {
-        w += x - _clip.x;
-        x  = _clip.x;
+        _region.clip(r, [&](Rect part) { _recordPart(part); });
+        return;
         }
-    
-    if (x+w > _clip.x  + _clip.w)
-        w = _clip.w - x;
-    
-    /*************************************************************************\
-    |* Clipping : exit if we're invisible
-    \*************************************************************************/
-    if (w < 1)
+
+    if (_mono != nullptr)
+        {
+        bool ink = _mono->isInk(colour);
+        _region.clip(r, [&](Rect part) { _mono->fill(part, ink); });
         return;
-    
+        }
 
-    /*************************************************************************\
-    |* Take CS low
-    \*************************************************************************/
-    LCD_CS(Gpio::LO);
+    _spi.begin();
+    _region.clip(r, [&](Rect part)
+        {
+        _note(part, true);
+        _setWindow(part);
+        _pushBlock(part, colour);
+        });
+    _spi.end();
+    }
 
-    /*************************************************************************\
-    |* Set the window on-screen that we want to fill to
-    \*************************************************************************/
-    Rect r = {x, y, w, 1};
+/*****************************************************************************\
+|* Private Method : Fill one rectangle of a batch. With a plain rectangular
+|* clip, it's cut down here and sent straight out
+\*****************************************************************************/
+void Ili9481::_batchFill(Rect r, RGB colour)
+    {
+    if (!_region.rectangular() || (_record != nullptr) || (_mono != nullptr))
+        {
+        _rectFill(r, colour);
+        return;
+        }
+
+    int x0 = MAX(r.x, _clip.x);
+    int y0 = MAX(r.y, _clip.y);
+    int x1 = MIN(r.x + r.w, _clip.x + _clip.w);
+    int y1 = MIN(r.y + r.h, _clip.y + _clip.h);
+    if ((x1 <= x0) || (y1 <= y0))
+        return;
+
+    r = {x0, y0, x1 - x0, y1 - y0};
+    _note(r, true);
     _setWindow(r);
-    _pushBlock(r, colour);
- 
-    /*************************************************************************\
-    |* Take CS high
-    \*************************************************************************/
-    LCD_CS(Gpio::HI);
+    _pushRun(colour, r.w * r.h, true);
     }
 
 /*****************************************************************************\
-|* Private Method : Optimised method to draw a vertical line
+|* Private Method : Draw a filled shape the cheapest way. Its spans are
+|* recorded first, into a table of one span per row, and then costed as:
+|*
+|*  spans   : a window per span sent, and the shape's own pixels
+|*  box     : one window over the lot, the backdrop filling in around the
+|*            shape. Only with a backdrop, and a clip that's a rectangle
+|*  columns : a window per column, and the shape's own pixels. Better than
+|*            spans for tall, thin shapes
+|*
+|* If a row turns out to have more than one span (the clip region cut it,
+|* say) or there's no room for the table, it just goes out as spans
 \*****************************************************************************/
-void Ili9481::_vline(int x, int y, int h, RGB colour)
+template <class Draw>
+void Ili9481::_fillShape(Rect box, RGB colour, Draw draw)
     {
-    /*************************************************************************\
-    |* Clipping : early exit if we're entirely out of bounds
-    \*************************************************************************/
-    if ((x < _clip.x) || (x >= _clip.x + _clip.w) || (y >= _clip.y + _clip.h))
+    int top     = MAX(box.y, _clip.y);
+    int bottom  = MIN(box.y + box.h, _clip.y + _clip.h);
+    if ((bottom <= top)
+        || (box.x >= _clip.x + _clip.w) || (box.x + box.w <= _clip.x))
         return;
-    
-    /*************************************************************************\
-    |* Clipping : adjust x
-    \*************************************************************************/
-    if (y < _clip.y)
+
+    bool spans = (_renderMode == RENDER_SPANS) || (_ink >= 0)
+              || (_mono != nullptr);
+    if (spans && (_record == nullptr))
         {
-        h += y - _clip.y;
-        y  = _clip.y;
+        draw();
+        return;
         }
-    
-    if (y+h > _clip.y  + _clip.h)
-        h = _clip.h - y;
-    
+
     /*************************************************************************\
-    |* Clipping : exit if we're invisible
+    |* Record the spans
     \*************************************************************************/
-    if (h < 1)
+    SpanRecord rec = {0, 0, nullptr, top, bottom - top};
+    if (_reserveRows(rec.num) == E_OK)
+        {
+        rec.rows = _spanRows;
+        for (int i=0; i<rec.num; i++)
+            {
+            rec.rows[2 * i]     = INT16_MAX;
+            rec.rows[2 * i + 1] = INT16_MIN;
+            }
+        }
+
+    SpanRecord *outer = _record;
+    _record = &rec;
+    draw();
+    _record = outer;
+
+    if (rec.windows == 0)
         return;
-    
-    /*************************************************************************\
-    |* Take CS low
-    \*************************************************************************/
-    LCD_CS(Gpio::LO);
 
     /*************************************************************************\
-    |* Set the window on-screen that we want to fill to
+    |* Cost each way of sending it
     \*************************************************************************/
-    Rect r = {x, y, 1, h};
-    _setWindow(r);
-    _pushBlock(r, colour);
- 
+    RenderMode mode = RENDER_SPANS;
+    RenderCost best = _cost(rec.windows, rec.bytes);
+    Rect ext        = {0, 0, 0, 0};
+
+    if (rec.rows != nullptr)
+        {
+        int x0      = INT16_MAX;
+        int x1      = INT16_MIN;
+        int y0      = -1;
+        int y1      = -1;
+        int64_t in  = 0;
+        for (int i=0; i<rec.num; i++)
+            if (rec.rows[2 * i] < rec.rows[2 * i + 1])
+                {
+                x0  = MIN(x0, rec.rows[2 * i]);
+                x1  = MAX(x1, rec.rows[2 * i + 1]);
+                y0  = (y0 < 0) ? i : y0;
+                y1  = i + 1;
+                in += rec.rows[2 * i + 1] - rec.rows[2 * i];
+                }
+        ext = {x0, top + y0, x1 - x0, y1 - y0};
+
+        RenderCost cols = _cost(ext.w, (int64_t)ext.w * COST_WINDOW_BYTES
+                                       + 3 * in);
+        RenderCost all  = _cost(1, COST_WINDOW_BYTES
+                                   + 3 * (int64_t)ext.w * ext.h);
+        bool boxOk      = _haveBackdrop && _region.rectangular();
+
+        if ((_renderMode == RENDER_BOX) && boxOk)
+            {
+            mode = RENDER_BOX;
+            best = all;
+            }
+        else if (_renderMode == RENDER_COLUMNS)
+            {
+            mode = RENDER_COLUMNS;
+            best = cols;
+            }
+        else if (_renderMode == RENDER_AUTO)
+            {
+            if (cols.us < best.us)
+                {
+                mode = RENDER_COLUMNS;
+                best = cols;
+                }
+            if (boxOk && (all.us < best.us))
+                {
+                mode = RENDER_BOX;
+                best = all;
+                }
+            }
+
+        if ((mode == RENDER_COLUMNS) && !_sendColumns(rec, ext, colour, false))
+            {
+            mode = RENDER_SPANS;
+            best = _cost(rec.windows, rec.bytes);
+            }
+        }
+
     /*************************************************************************\
-    |* Take CS high
+    |* Send it, or just add it to the total if this is only an estimate
     \*************************************************************************/
-    LCD_CS(Gpio::HI);
+    if (outer != nullptr)
+        {
+        outer->windows += best.windows;
+        outer->bytes   += best.bytes;
+        return;
+        }
+
+    switch (mode)
+        {
+        case RENDER_BOX:
+            fillRect(ext, SpanShader{rec.rows + 2 * (ext.y - top), ext.y,
+                                     colour, &_backdrop});
+            break;
+        case RENDER_COLUMNS:
+            _sendColumns(rec, ext, colour, true);
+            break;
+        default:
+            draw();
+            break;
+        }
     }
 
 /*****************************************************************************\
-|* Private Method : Fill a rectangle on the display with a colour
+|* Private Method : Note what a part would have cost, and add it to the
+|* shape's row table. A row with two separate spans can't be in the table,
+|* so that throws it away
 \*****************************************************************************/
-void Ili9481::_rectFill(Rect r, RGB colour)
+void Ili9481::_recordPart(Rect part)
     {
-    /*************************************************************************\
-    |* Clipping : If we're entirely OUB just return
-    \*************************************************************************/
-    if ((r.x >= _clip.x + _clip.w) || (r.y >= _clip.y + _clip.h))
+    SpanRecord &rec = *_record;
+    rec.windows ++;
+    rec.bytes += COST_WINDOW_BYTES + 3 * (int64_t)part.w * part.h;
+
+    if (rec.rows == nullptr)
         return;
-    
-    /*************************************************************************\
-    |* Clipping : If we're off to the left, clip x & adjust w
-    \*************************************************************************/
-    if (r.x < _clip.x)
+
+    int x1 = part.x + part.w;
+    for (int y=part.y; y<part.y+part.h; y++)
         {
-        r.w += r.x - _clip.x;
-        r.x  = _clip.x;
+        int16_t *span = rec.rows + 2 * (y - rec.top);
+        if ((y < rec.top) || (y >= rec.top + rec.num)
+            || ((span[0] < span[1]) && ((part.x > span[1]) || (x1 < span[0]))))
+            {
+            rec.rows = nullptr;
+            return;
+            }
+        span[0] = (int16_t) MIN(span[0], part.x);
+        span[1] = (int16_t) MAX(span[1], x1);
         }
-  
-    /*************************************************************************\
-    |* Clipping : If we're up above, clip y & adjust h
-    \*************************************************************************/
-    if (r.y < _clip.y)
+    }
+
+/*****************************************************************************\
+|* Private Method : Bytes and windows to a cost, at the write clock
+\*****************************************************************************/
+Ili9481::RenderCost Ili9481::_cost(int windows, int64_t bytes)
+    {
+    int64_t mhz = MAX(1, _writeMhz);
+    int64_t ns  = bytes * 8 * 1000 / mhz + (int64_t)windows * COST_WINDOW_NS;
+
+    RenderCost cost;
+    cost.bytes      = (int)bytes;
+    cost.windows    = windows;
+    cost.us         = (int)((ns + 999) / 1000);
+    return cost;
+    }
+
+/*****************************************************************************\
+|* Private Method : Send a recorded shape a column at a time, or with 'send'
+|* clear, just check that it can be: each column has to cross the shape in
+|* one run, which is true of anything convex
+\*****************************************************************************/
+bool Ili9481::_sendColumns(const SpanRecord &rec, Rect ext, RGB colour,
+                           bool send)
+    {
+    int first   = ext.y - rec.top;
+    int last    = first + ext.h - 1;
+
+    if (send)
+        _spi.begin();
+
+    for (int x=ext.x; x<ext.x+ext.w; x++)
         {
-        r.h += r.y - _clip.y;
-        r.y  = _clip.y;
+        int y0 = first;
+        int y1 = last;
+        while ((y0 <= y1) && ((x < rec.rows[2*y0]) || (x >= rec.rows[2*y0+1])))
+            y0 ++;
+        while ((y1 >= y0) && ((x < rec.rows[2*y1]) || (x >= rec.rows[2*y1+1])))
+            y1 --;
+
+        if (!send)
+            {
+            for (int y=y0; y<=y1; y++)
+                if ((x < rec.rows[2 * y]) || (x >= rec.rows[2 * y + 1]))
+                    return false;
+            }
+        else if (y0 <= y1)
+            {
+            Rect col = {x, rec.top + y0, 1, y1 - y0 + 1};
+            _note(col, true);
+            _setWindow(col);
+            _pushRun(colour, col.h, true);
+            }
         }
-   
-    /*************************************************************************\
-    |* Clipping : Make sure we're not too wide or too tall
-    \*************************************************************************/
-    if ((r.x + r.w) > _clip.w)
-        r.w = _clip.w - r.x;
-    
-    if ((r.y + r.h) > _clip.h)
-        r.h = _clip.h - r.y;
-   
-    /*************************************************************************\
-    |* Clipping : If clipping means nothing to draw, return
-    \*************************************************************************/
-    if ((r.w < 1) || (r.h < 1))
-        return;
 
-    /*************************************************************************\
-    |* Take CS low
-    \*************************************************************************/
-    LCD_CS(Gpio::LO);
+    if (send)
+        _spi.end();
+    return true;
+    }
 
-    /*************************************************************************\
-    |* Set the window on-screen that we want to fill to
-    \*************************************************************************/
-    _setWindow(r);
-    _pushBlock(r, colour);
- 
-    /*************************************************************************\
-    |* Take CS high
-    \*************************************************************************/
-    LCD_CS(Gpio::HI);
-   }
+/*****************************************************************************\
+|* Private Method : Cohen-Sutherland outcode of a point against the clip
+\*****************************************************************************/
+int Ili9481::_outcode(Point p)
+    {
+    int code = 0;
+    if (p.x < _clip.x)
+        code |= 1;
+    else if (p.x >= _clip.x + _clip.w)
+        code |= 2;
+    if (p.y < _clip.y)
+        code |= 4;
+    else if (p.y >= _clip.y + _clip.h)
+        code |= 8;
+    return code;
+    }
+
+/*****************************************************************************\
+|* Private Method : Whether a shape's bounding box misses the clip entirely
+\*****************************************************************************/
+bool Ili9481::_offClip(Rect r)
+    {
+    return (r.w <= 0) || (r.h <= 0)
+        || (r.x >= _clip.x + _clip.w) || (r.x + r.w <= _clip.x)
+        || (r.y >= _clip.y + _clip.h) || (r.y + r.h <= _clip.y);
+    }
 
 /*****************************************************************************\
 |* Private Method : plot a circle
@@ -957,14 +3132,69 @@ void Ili9481::_circle(int x, int y, int r, RGB rgb)
     int len     =  0;
 
     bool first  = true;
+
+    if (_offClip({x - r, y - r, 2 * r + 1, 2 * r + 1}))
+        return;
+
+    /*************************************************************************\
+    |* Step 'j' draws the runs 'r-j' out from the centre, each covering the
+    |* columns (or rows) between the previous step's end and this one's, so
+    |* work out the steps where either orientation can reach the clip, and
+    |* start from the first of them
+    \*************************************************************************/
+    int R       = r;
+    Reach cols  = _reach(x, _clip.x, _clip.x + _clip.w - 1);
+    Reach rows  = _reach(y, _clip.y, _clip.y + _clip.h - 1);
+    int start   = R + 1;
+    int last    = -1;
+
+    for (int swap=0; swap<2; swap++)
+        {
+        Reach out   = swap ? cols : rows;
+        Reach side  = swap ? rows : cols;
+        int lo      = MAX(R - out.hi, _firstTrue(0, R, [=](int j)
+                        { return _circleEdge(R, j) >= side.lo; }));
+        int hi      = MIN(R - out.lo, _firstTrue(0, R, [=](int j)
+                        { return _circleEdge(R, j) > side.hi; }));
+        if (lo <= hi)
+            {
+            start   = MIN(start, lo);
+            last    = MAX(last, hi);
+            }
+        }
+    if (start > last)
+        return;
+
+    const int16_t *steps = _arcs.table(R, ARC_OUTLINE);
+
+    if (start > 0)
+        {
+        xe      = _circleEdge(R, start - 1);
+        xs      = xe;
+        r       = R - start;
+        if (xe >= r)
+            return;
+
+        f       = (int)(1 - R + (int64_t)xe * xe + 2 * xe - 2LL * R * start
+                        + (int64_t)start * start + start);
+        ddfX    = 1 + 2 * xe;
+        ddfY    = -2 * R + 2 * start;
+        first   = false;
+        }
+
     do
         {
-        while (f < 0)
+        if (steps != nullptr)
+            xe = steps[R - r];
+        else
             {
-            xe ++;
-            f  += (ddfX += 2);
+            while (f < 0)
+                {
+                xe ++;
+                f  += (ddfX += 2);
+                }
+            f += (ddfY += 2);
             }
-        f += (ddfY += 2);
 
         if (xe > xs - 1)
             {
@@ -1006,7 +3236,103 @@ void Ili9481::_circle(int x, int y, int r, RGB rgb)
             }
         xs = xe;
         }
-    while (xe < --r);
+    while ((xe < --r) && (R - r <= last));
+    }
+
+/*****************************************************************************\
+|* Private Method : fill a circle
+\*****************************************************************************/
+void Ili9481::_circleFill(int x, int y, int r, RGB rgb)
+    {
+    int  xx = 0;
+    int  dx = 1;
+    int  dy = r+r;
+    int  p  = -(r>>1);
+
+    if (_offClip({x - r, y - r, dy + 1, dy + 1}))
+        return;
+
+    /*************************************************************************\
+    |* Common radii have the widths of the rows already worked out, so just
+    |* the rows that can be seen are sent
+    \*************************************************************************/
+    const int16_t *half = _arcs.table(r, ARC_DISC);
+    if (half != nullptr)
+        {
+        Reach rows = _reach(y, _clip.y, _clip.y + _clip.h - 1);
+        for (int d=rows.lo; d<=MIN(r, rows.hi); d++)
+            if (half[d] >= 0)
+                {
+                _hline(x - half[d], y - d, 2 * half[d] + 1, rgb);
+                if (d > 0)
+                    _hline(x - half[d], y + d, 2 * half[d] + 1, rgb);
+                }
+        return;
+        }
+
+    _hline(x-r, y, dy+1, rgb);
+
+    /*************************************************************************\
+    |* Step 'k' draws the caps 'r' rows out (k columns either side) and
+    |* the rows k+1 out (r columns either side), so only the steps where
+    |* one of those can reach the clip are run. The loop is started at
+    |* the first of them from the closed form of its state
+    \*************************************************************************/
+    int R       = r;
+    Reach cols  = _reach(x, _clip.x, _clip.x + _clip.w - 1);
+    Reach rows  = _reach(y, _clip.y, _clip.y + _clip.h - 1);
+
+    int capLo   = MAX(cols.lo, _firstTrue(0, R, [=](int k)
+                    { return _circleFillStep(R, k) >= R - rows.hi; }));
+    int capHi   = _firstTrue(0, R, [=](int k)
+                    { return _circleFillStep(R, k) > R - rows.lo; }) - 1;
+    int rowLo   = MAX(0, rows.lo - 1);
+    int rowHi   = MIN(rows.hi - 1, _firstTrue(0, R, [=](int k)
+                    { return _circleFillStep(R, k + 1) > R - cols.lo; }) - 1);
+
+    int first   = R + 1;
+    int last    = -1;
+    if (capLo <= capHi)
+        {
+        first   = capLo;
+        last    = capHi;
+        }
+    if (rowLo <= rowHi)
+        {
+        first   = MIN(first, rowLo);
+        last    = MAX(last, rowHi);
+        }
+    if (first > last)
+        return;
+
+    if (first > 0)
+        {
+        int m   = _circleFillStep(R, first);
+        xx      = first;
+        dx      = 1 + 2 * first;
+        dy      = 2 * (R - m);
+        r       = R - m;
+        p       = (int)_circleFillError(R, first, m);
+        }
+
+    while ((xx < r) && (xx <= last))
+        {
+        if (p>=0)
+            {
+            _hline(x - xx, y + r, dx, rgb);
+            _hline(x - xx, y - r, dx, rgb);
+            dy-=2;
+            p-=dy;
+            r--;
+            }
+
+        dx+=2;
+        p+=dx;
+        xx++;
+
+        _hline(x - r, y + xx, dy+1, rgb);
+        _hline(x - r, y - xx, dy+1, rgb);
+        }
     }
 
 /*****************************************************************************\
@@ -1023,16 +3349,24 @@ void Ili9481::_circleHelper(int x0, int y0, int rr, uint8_t corner, RGB rgb)
     int xe    = 0;
     int xs    = 0;
     int len   = 0;
+    int R     = rr;
+
+    const int16_t *steps = _arcs.table(R, ARC_OUTLINE);
 
     while (xe < rr--)
         {
-        while (f < 0) 
+        if (steps != nullptr)
+            xe = steps[R - 1 - rr];
+        else
             {
-            xe ++;
-            f += (ddF_x += 2);
+            while (f < 0) 
+                {
+                xe ++;
+                f += (ddF_x += 2);
+                }
+            
+            f += (ddF_y += 2);
             }
-        
-        f += (ddF_y += 2);
 
         if (xe-xs==1) 
             {
@@ -1060,7 +3394,7 @@ void Ili9481::_circleHelper(int x0, int y0, int rr, uint8_t corner, RGB rgb)
                 plot({x0 - xe, y0 + rr    }, rgb);
                 }
             }
-        else 
+        else
             {
             len = xe - xs++;
         
@@ -1105,6 +3439,23 @@ void Ili9481::_filledCircleHelper(int x0, int y0, int r,
 
     delta++;
 
+    /*************************************************************************\
+    |* Common radii have the widths of the rows already worked out
+    \*************************************************************************/
+    const int16_t *half = _arcs.table(r, ARC_CORNER);
+    if (half != nullptr)
+        {
+        for (int d=1; d<=r; d++)
+            if (half[d] >= 0)
+                {
+                if (corner & 0x1) 
+                    _hline(x0 - half[d], y0 + d, 2 * half[d] + delta, rgb);
+                if (corner & 0x2) 
+                    _hline(x0 - half[d], y0 - d, 2 * half[d] + delta, rgb);
+                }
+        return;
+        }
+
     while (y < r) 
         {
         if (f >= 0) 
@@ -1142,9 +3493,20 @@ void Ili9481::_ellipse(int x, int y, int rx, int ry, RGB rgb)
     int ry2 = ry * ry;
     int fx2 = 4 * rx2;
     int fy2 = 4 * ry2;
-    int s;
+    int64_t s;
+
+    if (_offClip({x - rx, y - ry, 2 * rx + 1, 2 * ry + 1}))
+        return;
+
+    Reach cols  = _reach(x, _clip.x, _clip.x + _clip.w - 1);
+    Reach rows  = _reach(y, _clip.y, _clip.y + _clip.h - 1);
+    int steps[4];
+    _ellipseSteps(rx, ry, cols, rows, false, steps);
 
-    for (xx = 0, yy = ry, s = 2*ry2+rx2*(1-2*ry); ry2*xx <= rx2*yy; xx++) 
+    xx  = steps[0];
+    yy  = _ellipseMinor(rx, ry, xx);
+    s   = _ellipseError(rx, ry, xx, yy);
+    for (; (ry2*xx <= rx2*yy) && (xx <= steps[1]); xx++) 
         {
         // These are ordered to minimise coordinate changes in x or y
         // drawPixel can then send fewer bounding box commands
@@ -1160,7 +3522,10 @@ void Ili9481::_ellipse(int x, int y, int rx, int ry, RGB rgb)
         s += ry2 * ((4 * xx) + 6);
         }
 
-    for (xx = rx, yy = 0, s = 2*rx2+ry2*(1-2*rx); rx2*yy <= ry2*xx; yy++) 
+    yy  = steps[2];
+    xx  = _ellipseMinor(ry, rx, yy);
+    s   = _ellipseError(ry, rx, yy, xx);
+    for (; (rx2*yy <= ry2*xx) && (yy <= steps[3]); yy++) 
         {
         // These are ordered to minimise coordinate changes in x or y
         // drawPixel can then send fewer bounding box commands
@@ -1190,9 +3555,20 @@ void Ili9481::_ellipseFill(int x, int y, int rx, int ry, RGB rgb)
     int ry2 = ry * ry;
     int fx2 = 4 * rx2;
     int fy2 = 4 * ry2;
-    int s;
+    int64_t s;
+
+    if (_offClip({x - rx, y - ry, 2 * rx + 1, 2 * ry + 1}))
+        return;
 
-    for (xx = 0, yy = ry, s = 2*ry2+rx2*(1-2*ry); ry2*xx <= rx2*yy; xx++) 
+    Reach cols  = _reach(x, _clip.x, _clip.x + _clip.w - 1);
+    Reach rows  = _reach(y, _clip.y, _clip.y + _clip.h - 1);
+    int steps[4];
+    _ellipseSteps(rx, ry, cols, rows, true, steps);
+
+    xx  = steps[0];
+    yy  = _ellipseMinor(rx, ry, xx);
+    s   = _ellipseError(rx, ry, xx, yy);
+    for (; (ry2*xx <= rx2*yy) && (xx <= steps[1]); xx++) 
         {
         _hline(x - xx, y - yy, xx + xx + 1, rgb);
         _hline(x - xx, y + yy, xx + xx + 1, rgb);
@@ -1205,7 +3581,10 @@ void Ili9481::_ellipseFill(int x, int y, int rx, int ry, RGB rgb)
         s += ry2 * ((4 * xx) + 6);
         }
 
-    for (xx = rx, yy = 0, s = 2*rx2+ry2*(1-2*rx); rx2*yy <= ry2*xx; yy++) 
+    yy  = steps[2];
+    xx  = _ellipseMinor(ry, rx, yy);
+    s   = _ellipseError(ry, rx, yy, xx);
+    for (; (rx2*yy <= ry2*xx) && (yy <= steps[3]); yy++) 
         {
         _hline(x - xx, y - yy, xx + xx + 1, rgb);
         _hline(x - xx, y + yy, xx + xx + 1, rgb);
@@ -1258,8 +3637,17 @@ void Ili9481::_triangleFill(Point p0, Point p1, Point p2, RGB rgb)
     int dy02 = p2.y - p0.y;
     int dx12 = p2.x - p1.x;
     int dy12 = p2.y - p1.y;
-    int sa   = 0;
-    int sb   = 0;
+    int64_t sa;
+    int64_t sb;
+
+    // Only the rows inside the clip are stepped through, each edge
+    // starting from where it crosses the first of them
+    int top     = MAX(p0.y, _clip.y);
+    int bottom  = MIN(p2.y, _clip.y + _clip.h - 1);
+    int left    = MIN(p0.x, MIN(p1.x, p2.x));
+    int right   = MAX(p0.x, MAX(p1.x, p2.x));
+    if ((top > bottom) || (right < _clip.x) || (left >= _clip.x + _clip.w))
+        return;
 
     // For upper part of triangle, find scanline crossings for segments
     // 0-1 and 0-2.  If p1.y=p2.y (flat-bottomed triangle), the scanline p1.y
@@ -1272,10 +3660,13 @@ void Ili9481::_triangleFill(Point p0, Point p1, Point p2, RGB rgb)
     else
         last = p1.y - 1;    // Skip it
 
-    for (y = p0.y; y <= last; y++) 
+    y  = top;
+    sa = (int64_t)dx01 * (y - p0.y);
+    sb = (int64_t)dx02 * (y - p0.y);
+    for (; y <= MIN(last, bottom); y++) 
         {
-        a   = p0.x + sa / dy01;
-        b   = p0.x + sb / dy02;
+        a   = p0.x + (int)(sa / dy01);
+        b   = p0.x + (int)(sb / dy02);
         sa += dx01;
         sb += dx02;
 
@@ -1286,12 +3677,13 @@ void Ili9481::_triangleFill(Point p0, Point p1, Point p2, RGB rgb)
 
     // For lower part of triangle, find scanline crossings for segments
     // 0-2 and 1-2.  This loop is skipped if y1=y2.
-    sa = dx12 * (y - p1.y);
-    sb = dx02 * (y - p0.y);
-    for (; y <= p2.y; y++) 
+    y  = MAX(last + 1, top);
+    sa = (int64_t)dx12 * (y - p1.y);
+    sb = (int64_t)dx02 * (y - p0.y);
+    for (; y <= bottom; y++) 
         {
-        a   = p1.x + sa / dy12;
-        b   = p0.x + sb / dy02;
+        a   = p1.x + (int)(sa / dy12);
+        b   = p0.x + (int)(sb / dy02);
         sa += dx12;
         sb += dx02;
 
@@ -1301,3 +3693,65 @@ void Ili9481::_triangleFill(Point p0, Point p1, Point p2, RGB rgb)
         _hline(a, y, b - a + 1, rgb);
         }
     }
+
+/*****************************************************************************\
+|* Private Method : Trace a curve. It lies inside the box around its control
+|* points, so if that can't be seen, nor can the curve
+\*****************************************************************************/
+void Ili9481::_curve(const Point *ctl, int order, RGB colour)
+    {
+    int x0 = ctl[0].x;
+    int y0 = ctl[0].y;
+    int x1 = x0;
+    int y1 = y0;
+    for (int i=1; i<=order; i++)
+        {
+        x0 = MIN(x0, ctl[i].x);
+        y0 = MIN(y0, ctl[i].y);
+        x1 = MAX(x1, ctl[i].x);
+        y1 = MAX(y1, ctl[i].y);
+        }
+    if (_offClip({x0, y0, x1 - x0 + 1, y1 - y0 + 1}))
+        return;
+
+    /*************************************************************************\
+    |* Into path units, kept to the range a Path has so flattening (which
+    |* adds more fraction bits) can't overflow
+    \*************************************************************************/
+    struct Curve
+        {
+        Point   fix[4];                     // Control points, path units
+        int     order;                      // 2 or 3
+        } curve;
+
+    curve.order = order;
+    for (int i=0; i<=order; i++)
+        curve.fix[i] = {MIN(MAX(ctl[i].x, -2047), 2046) * PATH_ONE + PATH_HALF,
+                        MIN(MAX(ctl[i].y, -2047), 2046) * PATH_ONE + PATH_HALF};
+
+    PathRun run = {this, colour};
+    PathTracer tracer(_pathRun, &run, _curveRuns, PATH_TRACE_RUNS);
+
+    _spi.begin();
+    tracer.stroke(MAX(y0, _clip.y), MIN(y1 + 1, _clip.y + _clip.h),
+                  [](void *ctx, PathTracer *tracer)
+        {
+        Curve *c = (Curve *)ctx;
+        tracer->moveTo(c->fix[0].x, c->fix[0].y);
+        Path::flatten(c->fix, c->order, PATH_TOLERANCE,
+                      [](void *ctx, int x, int y)
+            {
+            ((PathTracer *)ctx)->lineTo(x, y);
+            }, tracer);
+        }, &curve);
+    _spi.end();
+    }
+
+/*****************************************************************************\
+|* Private Method : Send one run of a path or curve
+\*****************************************************************************/
+void Ili9481::_pathRun(void *ctx, int x, int y, int w)
+    {
+    PathRun *run = (PathRun *)ctx;
+    run->dpy->_hline(x, y, w, run->colour);
+    }
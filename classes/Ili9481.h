@@ -6,6 +6,16 @@
 #include "pico/stdlib.h"
 
 #include "spi.h"
+#include "imagesource.h"
+#include "jpeg.h"
+#include "rle.h"
+#include "shader.h"
+#include "affine.h"
+#include "clipregion.h"
+#include "arcs.h"
+#include "path.h"
+#include "palette.h"
+#include "mono.h"
 
 #include "../include/errors.h"
 #include "../include/properties.h"
@@ -19,8 +29,39 @@ typedef struct
     Spi::SpiContext spi;    // Spi interface
     int pinRST;             // LCD reset pin, active low
     int pinCD;              // LCD command/data pin
+    bool calibrate;         // Search for the fastest reliable SPI clocks
     } DpyContext;
 
+/*****************************************************************************\
+|* Number of pixels pre-packed into the buffer used for solid fills
+\*****************************************************************************/
+#define FILL_PIXELS     32
+
+/*****************************************************************************\
+|* Anti-aliased pixels gathered before they go out as one window, and the
+|* spare pixels that window may have over twice that
+\*****************************************************************************/
+#define AA_BATCH        32
+#define AA_SLACK        4
+
+/*****************************************************************************\
+|* Items of a batched call put in row order at a time
+\*****************************************************************************/
+#define BATCH_SORT      64
+
+/*****************************************************************************\
+|* Rows of a filled path sent between chances to let another core use the bus
+\*****************************************************************************/
+#define PATH_BAND       16
+
+/*****************************************************************************\
+|* Cost model: the bytes it takes to open a window and start writing to it
+|* (column and page addresses, then "memory start"), and the time each
+|* window costs on top of its bytes, in D/C turnarounds and call overhead
+\*****************************************************************************/
+#define COST_WINDOW_BYTES   11
+#define COST_WINDOW_NS      2000
+
 
 /*****************************************************************************\
 |* Helper construct : swap any type
@@ -50,27 +91,133 @@ class Ili9481
             INVERTED_LANDSCAPE
             };
 
+        struct HLine
+            {
+            int16_t x;                      // Left end
+            int16_t y;                      // Row
+            int16_t w;                      // Length
+            RGB colour;                     // Colour
+            };
+
+        enum RenderMode
+            {
+            RENDER_AUTO                      = 0,   // Cheapest of the below
+            RENDER_SPANS,                   // A window per row span
+            RENDER_BOX,                     // One window, backdrop around
+            RENDER_COLUMNS,                 // A window per column
+            };
+
+        struct RenderCost
+            {
+            int bytes;                      // Sent over the bus
+            int windows;                    // Windows opened
+            int us;                         // Time at the write clock
+            };
+
+        enum BlitOp
+            {
+            BLIT_ROTATE_0                    = 0,
+            BLIT_ROTATE_90,                 // Clockwise
+            BLIT_ROTATE_180,
+            BLIT_ROTATE_270,
+            BLIT_MIRROR                      = 4,   // Or'd in, before turning
+            };
+
+    private:
+        enum InitState
+            {
+            INIT_IDLE                        = 0,
+            INIT_RESET_PULSE,
+            INIT_RESET_RELEASE,
+            INIT_SCRIPT,
+            INIT_DONE,
+            INIT_FAILED
+            };
+
  	/*************************************************************************\
     |* Properties
     \*************************************************************************/
     GET(Rect, bounds);                      // Overall bounds of the display
-    GETSET(Rect, clip, Clip);               // Current clipping rectangle
+    GET(Rect, clip);                        // Bounding box of the clip
     GET(Rotation, rotation);                // Orientation of the display
+    GET(int, writeMhz);                     // SPI clock used for writes
+    GET(int, readMhz);                      // SPI clock used for reads
+    GET(bool, readBgr);                     // GRAM reads come back as BGR
+    GETSET(RenderMode, renderMode, RenderMode); // How filled shapes go out
 
     private:
         DpyContext _ctx;                    // The display context
         Spi        _spi;                    // The SPI connection
+        uint8_t    _fill[FILL_PIXELS*3];    // Pre-packed solid-fill pixels
+        uint32_t   _fillKey;                // Colour currently in _fill
+        uint8_t    _addressMode;            // Last value sent to MADCTL
+
+        InitState       _initState;         // Where init has got to
+        const uint8_t * _initAddr;          // Next entry in the init script
+        absolute_time_t _initWake;          // When init can next proceed
+        bool            _initWarm;          // Panel survived a reboot
+
+        ClipRegion      _region;            // Where drawing is allowed
+        Rect            _window;            // Last window sent, 0 if unknown
+
+        uint8_t *       _lines[2];          // Ping-pong image line buffers
+        int             _lineBytes;         // Size of each of _lines
+
+        struct AaPixel
+            {
+            int16_t x;                      // Screen position
+            int16_t y;
+            uint8_t cov;                    // Coverage, out of 255
+            };
+
+        AaPixel         _aaPix[AA_BATCH];   // Pixels waiting to be blended
+        int             _aaNum;             // Number of them
+        Rect            _aaBox;             // Their bounding box
+        RGB             _aaFg;              // Colour being drawn
+        const Backdrop *_aaBg;              // What it's blended against
+
+        struct SpanRecord
+            {
+            int         windows;            // Windows that would be opened
+            int64_t     bytes;              // Bytes that would be sent
+            int16_t *   rows;               // [x0,x1) per row, or nullptr
+            int         top;                // Row of rows[0]
+            int         num;                // Rows in 'rows'
+            };
+
+        SpanRecord *    _record;            // Collecting costs, not drawing
+        int16_t *       _spanRows;          // Space for SpanRecord::rows
+        int             _spanRowsNum;       // Rows it has room for
+        Backdrop        _backdrop;          // What's behind filled shapes
+        bool            _haveBackdrop;      // Whether _backdrop is known
+
+        ArcCache        _arcs;              // Tables for round things
+        PathTracer::Run _curveRuns[PATH_TRACE_RUNS];    // For curves
+
+        Palette *       _palette;           // Palette mode, or nullptr
+        int             _ink;               // Entry being painted, or -1
+
+        MonoBuffer *    _mono;              // 1bpp mode, or nullptr
 
     public:
         /*********************************************************************\
         |* Constructors and Destructor
         \*********************************************************************/
         explicit Ili9481(void);
+        ~Ili9481(void);
 
         /*********************************************************************\
-        |* Initialise the set of GPIOs to a known state
+        |* Initialise the display, blocking until it's ready. If 'warm' is set
+        |* and the panel is still configured, the reset is skipped
         \*********************************************************************/
-        int init(DpyContext *ctx);
+        int init(DpyContext *ctx, bool warm=false);
+
+        /*********************************************************************\
+        |* Start initialising the display, then call poll() until it stops
+        |* returning E_PENDING
+        \*********************************************************************/
+        int initAsync(DpyContext *ctx, bool warm=false);
+        int poll(void);
 
 
         /*********************************************************************\
@@ -78,11 +225,26 @@ class Ili9481
         \*********************************************************************/
         int fetchAddressMode(void);
 
+        /*********************************************************************\
+        |* Find the fastest clocks at which writes and reads verify, and use
+        |* them (less a safety margin) from now on
+        \*********************************************************************/
+        int calibrate(void);
+
         /*********************************************************************\
         |* Reset the clip rectangle
         \*********************************************************************/
         void resetClipRectangle(void);
 
+        /*********************************************************************\
+        |* Clip to a rectangle, or to a region of several. Every primitive,
+        |* images, shaders, blits and copies included, is cut to the region
+        |* itself, so there's no need to draw a part of it at a time
+        \*********************************************************************/
+        void setClip(Rect r);
+        void setClipRegion(const ClipRegion &region);
+        const ClipRegion& clipRegion(void)  { return _region; }
+
         /*********************************************************************\
         |* Set the display orienatation
         \*********************************************************************/
@@ -118,32 +280,308 @@ class Ili9481
         \*********************************************************************/
         void triangle(Point p0, Point p1, Point p2, RGB rgb, bool fill=false);
         
+        /*********************************************************************\
+        |* Draw a quadratic (one control point) or cubic (two) Bézier curve,
+        |* flattened to within PATH_TOLERANCE. Each pixel goes out once
+        \*********************************************************************/
+        void bezier(Point p0, Point c, Point p1, RGB colour);
+        void bezier(Point p0, Point c0, Point c1, Point p1, RGB colour);
+
+        /*********************************************************************\
+        |* Draw a path (see path.h) as one pixel wide lines, or fill it.
+        |* Either way, a pixel goes out at most once
+        \*********************************************************************/
+        void strokePath(Path &path, RGB colour);
+        void fillPath(Path &path, RGB colour, FillRule rule=FILL_NONZERO);
+
+        /*********************************************************************\
+        |* Batched drawing, for many small items: CS stays low for the whole
+        |* batch, and each block of BATCH_SORT items is put in row order so
+        |* they can share window addresses. Lines are pairs of points, and
+        |* points next to each other in a row go out as one run
+        \*********************************************************************/
+        void fillRects(const Rect *rects, int num, RGB colour);
+        void drawLines(const Point *ends, int num, RGB colour);
+        void drawPoints(const Point *points, int num, RGB colour);
+        void drawHLines(const HLine *lines, int num);
+
+        /*********************************************************************\
+        |* Tell the driver what's behind the filled shapes about to be drawn,
+        |* which lets small ones go out as their bounding box with the
+        |* backdrop around them, through one window. It has to match what's
+        |* on the screen until it's cleared
+        \*********************************************************************/
+        void setBackdrop(const Backdrop &bg);
+        void clearBackdrop(void);
+
+        /*********************************************************************\
+        |* Work out what 'draw' (anything callable) would cost on the bus,
+        |* without drawing it. Filled shapes are costed the way they would be
+        |* sent. Only the primitives, batches and shader fills are held
+        |* back; images, blits and anti-aliased drawing would still go out
+        \*********************************************************************/
+        template <class Draw> RenderCost estimateCost(Draw draw);
+
+        /*********************************************************************\
+        |* Palette mode (see palette.h). While a palette is set, solid
+        |* drawing done through paint() is noted in its shadow by entry:
+        |* 'draw' is handed the entry's colour and draws as usual. Changing
+        |* an entry with setPaletteEntry() then repaints just the pixels
+        |* that have it. Filled shapes go out as spans in this mode. Any
+        |* other drawing (outside paint(), or images, shaders, blits and
+        |* anti-aliased drawing inside it) leaves its pixels with no entry
+        \*********************************************************************/
+        void setPalette(Palette *palette);
+        template <class Draw> void paint(int index, Draw draw);
+        int setPaletteEntry(int index, RGB colour);
+
+        /*********************************************************************\
+        |* Monochrome mode (see mono.h). While a buffer is set, lines, boxes,
+        |* circles and the rest of the solid primitives are drawn into it
+        |* (each colour as ink or paper) rather than sent, and flush() sends
+        |* the rows that have changed, a window per run of them, expanded
+        |* into the line buffers while the last lines go out. The buffer's
+        |* top-left is the screen's. Images, shaders, blits and anti-aliased
+        |* drawing still go straight to the screen
+        \*********************************************************************/
+        void setMono(MonoBuffer *mono);
+        int flush(void);
+
         /*********************************************************************\
         |* Clear the screen to a colour
         \*********************************************************************/
         void clear( RGB rgb = RGB(0,0,0));
+
+        /*********************************************************************\
+        |* Stream an image with its top-left at 'p'. With a DMA-mode SPI, the
+        |* next lines are decoded while the previous ones are being sent. If
+        |* the clip isn't a rectangle, each batch of lines is sent a part of
+        |* the region at a time
+        \*********************************************************************/
+        int drawImage(Point p, ImageSource *src);
+
+        /*********************************************************************\
+        |* As above, but only the 'part' of the image, placed at 'p'. Rows of
+        |* the image below the part aren't decoded at all
+        \*********************************************************************/
+        int drawImage(Point p, ImageSource *src, Rect part);
+
+        /*********************************************************************\
+        |* Decode a JPEG with its top-left at 'p', at whatever scale the
+        |* decoder is set to. Each MCU goes out through its own window, and
+        |* MCUs outside the clip are skipped without an IDCT
+        \*********************************************************************/
+        int drawJpeg(Point p, JpegDecoder *jpg);
+
+        /*********************************************************************\
+        |* Draw an RLE asset with its top-left at 'p'. Literals go straight
+        |* from flash, and long runs go out through the solid-fill path.
+        |* Only the parts inside the clip region are sent
+        \*********************************************************************/
+        int drawRle(Point p, RleSource *img);
+
+        /*********************************************************************\
+        |* Fill a rectangle from a shader (see shader.h), which generates a
+        |* few rows at a time into the image line buffers. Each part inside
+        |* the clip region goes out through one window, and with a DMA-mode
+        |* SPI the next rows are generated while the last ones are sent
+        \*********************************************************************/
+        template <class Shader> int fillRect(Rect r, Shader shader);
+        int fillRect(Rect r, ShaderFn fn, void *ctx=nullptr);
+
+        /*********************************************************************\
+        |* Draw a bitmap through an affine transform (source to screen),
+        |* limited to 'dstClip' as well as the clip. Each row goes out as one
+        |* span covering just the pixels that land inside the source, so the
+        |* corners of a rotated image leave the background alone
+        \*********************************************************************/
+        int blitTransformed(const Bitmap &src, PixelFormat fmt,
+                            const Affine &matrix, Rect dstClip,
+                            AffineSampler::Filter filter
+                                = AffineSampler::NEAREST);
+
+        /*********************************************************************\
+        |* Blit a bitmap with its top-left at 'p', turned and/or mirrored by
+        |* 'op' (a BlitOp). The controller's write order is changed for the
+        |* transfer, so rows go out as stored, with no CPU transposition.
+        |* Returns E_INVALID if no write order gives 'op'
+        \*********************************************************************/
+        int blit(Point p, const Bitmap &src, PixelFormat fmt,
+                 int op=BLIT_ROTATE_0);
+
+        /*********************************************************************\
+        |* Read a rectangle of the screen back, at the read clock, as packed
+        |* RGB565 or wire-format pixels. 'r' must be inside the bounds
+        \*********************************************************************/
+        int readRect(Rect r, void *dst, PixelFormat fmt);
+
+        /*********************************************************************\
+        |* Write the screen, or part of it, to stdio (USB serial, usually)
+        |* as a binary PPM. Nothing else should print while it runs
+        \*********************************************************************/
+        int screenshot(void);
+        int screenshot(Rect r);
+
+        /*********************************************************************\
+        |* Blend 'colour' over what's already on the screen, 'alpha' out of
+        |* 255, reading the pixels back first. For small regions
+        \*********************************************************************/
+        int blendRect(Rect r, RGB colour, int alpha);
+
+        /*********************************************************************\
+        |* Move what's on screen in 'src' so its top-left is at 'dst'. The
+        |* two may overlap. Only the part that lands inside the clip is
+        |* written, and what's left behind isn't touched
+        \*********************************************************************/
+        int copyRect(Rect src, Point dst);
+
+        /*********************************************************************\
+        |* Anti-aliased drawing. Rather than reading the screen back, edge
+        |* pixels are blended against 'bg', which has to match what's there.
+        |* Nearby pixels are sent together through small windows, with the
+        |* backdrop filling the gaps
+        \*********************************************************************/
+        void lineAA(Point p0, Point p1, RGB colour, const Backdrop &bg);
+        void circleAA(Point p, int r, RGB colour, const Backdrop &bg,
+                      bool fill=false);
+
+        /*********************************************************************\
+        |* Draw 'colour' through a w x h map of 8-bit coverage (a rendered
+        |* glyph, say) with its top-left at 'p', blended against 'bg'
+        \*********************************************************************/
+        int drawCoverage(Point p, const uint8_t *alpha, int w, int h,
+                         RGB colour, const Backdrop &bg);
+
+        /*********************************************************************\
+        |* Fill one row of 'w' pixels from a shader
+        \*********************************************************************/
+        template <class Shader> int fillSpan(int x, int y, int w, Shader shader)
+            { return fillRect({x, y, w, 1}, shader); }
     
     private:
         /*********************************************************************\
-        |* Write a command to the display
+        |* Init helpers: run the script to the next delay, check for a panel
+        |* that is already set up, and read a register back
         \*********************************************************************/
-        void _writeCommand(uint8_t c, bool handleCS=true);
+        void _stepInitScript(void);
+        bool _isConfigured(void);
+        void _readRegister(uint8_t cmd, uint8_t *dst, int len);
 
         /*********************************************************************\
-        |* Write data to the display
+        |* Write a command and its parameters to the display
         \*********************************************************************/
-        void _writeData(uint8_t d, bool handleCS=true);
+        void _sendCommand(uint8_t cmd, const uint8_t *params=nullptr, int num=0);
 
         /*********************************************************************\
         |* Set the display active-window to be the supplied rect
         \*********************************************************************/
-        void _setWindow(Rect r, bool handleCS=false);
+        void _setWindow(Rect r);
+
+        /*********************************************************************\
+        |* In palette mode, note in the shadow what 'r' is about to be drawn
+        |* with: the entry being painted if it's a 'solid' fill of it, and
+        |* otherwise no entry
+        \*********************************************************************/
+        void _note(Rect r, bool solid=false);
 
         /*********************************************************************\
         |* Push a block of colour data to the LCD, which will be expecting it
         \*********************************************************************/
-        void _pushBlock(Rect r, RGB rgb, bool handleCS=false);
-        void _pushBlock(Rect r, uint16_t *rgb, bool handleCS=false);
+        void _pushBlock(Rect r, RGB rgb);
+        void _pushBlock(Rect r, uint16_t *rgb);
+
+        /*********************************************************************\
+        |* Send 'num' pixels of one colour, starting a new write to the
+        |* window or carrying on with the current one
+        \*********************************************************************/
+        void _pushRun(RGB rgb, int num, bool start);
+
+        /*********************************************************************\
+        |* Pixels to send between chances to let another core use the bus
+        \*********************************************************************/
+        int _chunkPixels(int num);
+
+        /*********************************************************************\
+        |* Make sure the image line buffers are at least 'bytes' long
+        \*********************************************************************/
+        int _reserveLines(int bytes);
+
+        /*********************************************************************\
+        |* Push wire-ready (3 bytes per pixel) data to the current window
+        \*********************************************************************/
+        void _pushWire(Rect r, const uint8_t *data);
+
+        /*********************************************************************\
+        |* Push the parts of a block of wire-ready data inside the clip
+        |* region, a window for each. Rows are 'stride' bytes apart
+        \*********************************************************************/
+        void _pushWireClipped(Rect r, const uint8_t *data, int stride);
+
+        /*********************************************************************\
+        |* Send the part 'vis' of an RLE asset at 'r' through its own
+        |* window, and part of one of its spans to the current write
+        \*********************************************************************/
+        int _sendRle(RleSource *img, Rect r, Rect vis);
+        void _pushRleSpan(RleSource *img, const RleSource::Span &span,
+                          int skip, int num);
+
+        /*********************************************************************\
+        |* Make sure the line buffers are there, and start writing to the
+        |* window 'r', which has to be inside the clip region. Returns the
+        |* rows that fit in a line buffer, 0 if there's nothing to send, or
+        |* <0 on error. If it's >0, the caller has to finish with
+        |* _spi.end()
+        \*********************************************************************/
+        int _beginStream(Rect r);
+
+        /*********************************************************************\
+        |* Per-call blit orientation: where a source pixel lands in the
+        |* destination, and back again
+        \*********************************************************************/
+        static Point _blitPlace(int op, int sw, int sh, int i, int j);
+        static Point _blitSource(int op, int sw, int sh, int x, int y);
+
+        /*********************************************************************\
+        |* Blit the part 'vis' of the screen, through its own window and
+        |* write order
+        \*********************************************************************/
+        int _blitPart(Point p, const Bitmap &src, PixelFormat fmt, int op,
+                      Rect vis);
+
+        /*********************************************************************\
+        |* Map window addresses under an address mode to display memory
+        \*********************************************************************/
+        static Point _toMemory(uint8_t mode, Point cp);
+        static Point _fromMemory(uint8_t mode, Point m);
+
+        /*********************************************************************\
+        |* Gather anti-aliased pixels into windows: start, add a pixel (which
+        |* may send the ones so far), send what's left, and finish
+        \*********************************************************************/
+        void _aaBegin(RGB fg, const Backdrop &bg);
+        void _aaPlot(int x, int y, int cov);
+        void _aaFlush(void);
+        void _aaEnd(void);
+        static uint32_t _isqrt64(uint64_t v);
+
+        /*********************************************************************\
+        |* Let another core have a shared bus, carrying on with the current
+        |* write afterwards
+        \*********************************************************************/
+        void _yieldWrite(void);
+
+        /*********************************************************************\
+        |* Read back pixels from GRAM at the read clock, and tidy them up
+        \*********************************************************************/
+        void _readBlock(Rect r, uint8_t *dst);
+        void _fixReadback(uint8_t *data, int num);
+
+        /*********************************************************************\
+        |* Write a pattern at one clock, read it back at another, and compare;
+        |* and put back what the pattern was written over
+        \*********************************************************************/
+        bool _verifyClocks(int writeMhz, int readMhz, const uint8_t *pattern);
+        void _restoreCorner(Rect r, const uint8_t *data);
 
         /*********************************************************************\
         |* Draw a horizontal or vertical line
@@ -156,10 +594,41 @@ class Ili9481
         \*********************************************************************/
         void _rectFill(Rect r, RGB rgb);
 
+        /*********************************************************************\
+        |* As above, for one item of a batch, which has CS held already
+        \*********************************************************************/
+        void _batchFill(Rect r, RGB rgb);
+
+        /*********************************************************************\
+        |* Draw a filled shape whose rows are each one span, within 'box', as
+        |* spans, its bounding box or columns, whichever costs least. 'draw'
+        |* sends the spans; it's run once to record them, and again if they
+        |* turn out to be the way to go
+        \*********************************************************************/
+        template <class Draw> void _fillShape(Rect box, RGB rgb, Draw draw);
+
+        /*********************************************************************\
+        |* Cost model helpers: note a part that would have been sent, turn
+        |* windows and bytes into a cost, make room for a shape's rows, and
+        |* check (or send) a recorded shape a column at a time
+        \*********************************************************************/
+        void _recordPart(Rect part);
+        RenderCost _cost(int windows, int64_t bytes);
+        int _reserveRows(int rows);
+        bool _sendColumns(const SpanRecord &rec, Rect ext, RGB rgb, bool send);
+
+        /*********************************************************************\
+        |* Where a point lies relative to the clip, as Cohen-Sutherland has
+        |* it, and whether a bounding box is entirely outside it
+        \*********************************************************************/
+        int _outcode(Point p);
+        bool _offClip(Rect r);
+
         /*********************************************************************\
         |* Draw/fill a circle
         \*********************************************************************/
         void _circle(int x, int y, int r, RGB rgb);
+        void _circleFill(int x, int y, int r, RGB rgb);
         void _circleHelper(int x, int y, int r, uint8_t corner, RGB rgb);
         void _filledCircleHelper(int x0, int y0, int r, 
                                  uint8_t corner, int delta, RGB rgb);
@@ -176,4 +645,90 @@ class Ili9481
         \*********************************************************************/
         void _triangleFill(Point p0, Point p1, Point p2, RGB rgb);
 
-   };
\ No newline at end of file
+        /*********************************************************************\
+        |* Paths and curves: trace a curve through 'ctl' (order+1 points),
+        |* and send one run of a path, 'ctx' being a PathRun
+        \*********************************************************************/
+        struct PathRun
+            {
+            Ili9481 *   dpy;                // Where it goes
+            RGB         colour;             // What colour
+            };
+
+        void _curve(const Point *ctl, int order, RGB colour);
+        static void _pathRun(void *ctx, int x, int y, int w);
+
+   };
+
+/*****************************************************************************\
+|* Method : Cost a piece of drawing by running it with the bus switched off
+\*****************************************************************************/
+template <class Draw>
+Ili9481::RenderCost Ili9481::estimateCost(Draw draw)
+    {
+    SpanRecord rec      = {0, 0, nullptr, 0, 0};
+    SpanRecord *outer   = _record;
+
+    _record = &rec;
+    draw();
+    _record = outer;
+
+    return _cost(rec.windows, rec.bytes);
+    }
+
+/*****************************************************************************\
+|* Method : Draw with a palette entry, noting it in the shadow as it goes
+\*****************************************************************************/
+template <class Draw>
+void Ili9481::paint(int index, Draw draw)
+    {
+    if ((_palette == nullptr) || (index < 0) || (index >= PALETTE_SIZE))
+        return;
+
+    int outer   = _ink;
+    _ink        = index;
+    draw(_palette->colour(index));
+    _ink        = outer;
+    }
+
+/*****************************************************************************\
+|* Method : Fill a rectangle from a shader, streaming through the two line
+|* buffers, a window for each part inside the clip region. This is a
+|* template so that the shader can be inlined
+\*****************************************************************************/
+template <class Shader>
+int Ili9481::fillRect(Rect r, Shader shader)
+    {
+    int ok = E_OK;
+    _region.clip(r, [&](Rect part)
+        {
+        int per = (ok == E_OK) ? _beginStream(part) : 0;
+        if (per <= 0)
+            {
+            ok = (per < 0) ? per : ok;
+            return;
+            }
+
+        int stride  = part.w * 3;
+        int bottom  = part.y + part.h;
+        int cur     = 0;
+
+        for (int y=part.y; y<bottom; )
+            {
+            int n           = (per < bottom - y) ? per : bottom - y;
+            uint8_t *line   = _lines[cur];
+            for (int i=0; i<n; i++, line += stride)
+                shader(part.x, y + i, part.w, line);
+
+            _spi.writeAsync(_lines[cur], n * stride);
+            y   += n;
+            cur ^= 1;
+
+            if (y < bottom)
+                _yieldWrite();
+            }
+        _spi.end();
+        });
+
+    return ok;
+    }
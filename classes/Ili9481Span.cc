@@ -0,0 +1,285 @@
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+#include "Ili9481Span.h"
+#include "../include/macros.h"
+
+/*****************************************************************************\
+|* Defines
+\*****************************************************************************/
+
+#define SPAN_QUEUE_DEPTH    32      // Primitives core 1 can fall behind by
+
+/*****************************************************************************\
+|* Statics
+\*****************************************************************************/
+
+static Ili9481Span * _active = nullptr;    // The span core 1 is serving
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Ili9481Span::Ili9481Span(Ili9481 *left, Ili9481 *right)
+        :_bounds({0, 0, 0, 0})
+        ,_left(left)
+        ,_right(right)
+        ,_split(0)
+        ,_issued(0)
+        ,_completed(0)
+    {}
+
+/*****************************************************************************\
+|* Destructor. Let core 1 finish, then stop it
+\*****************************************************************************/
+Ili9481Span::~Ili9481Span(void)
+    {
+    if (_active == this)
+        {
+        sync();
+        multicore_reset_core1();
+        queue_free(&_queue);
+        _active = nullptr;
+        }
+    }
+
+/*****************************************************************************\
+|* Method : Work out the logical canvas, and start core 1
+\*****************************************************************************/
+int Ili9481Span::init(void)
+    {
+    if ((_left == nullptr) || (_right == nullptr))
+        {
+        printf(T_ERR "Span needs two displays\n");
+        return E_INVALID;
+        }
+
+    if (_active != nullptr)
+        {
+        printf(T_ERR "Core 1 is already driving a span\n");
+        return E_NO_RESOURCE;
+        }
+
+    _split  = _left->bounds().w;
+    _bounds = {0, 0, _split + _right->bounds().w, 
+               MAX(_left->bounds().h, _right->bounds().h)};
+
+    queue_init(&_queue, sizeof(SpanOp), SPAN_QUEUE_DEPTH);
+    _active = this;
+    multicore_launch_core1(_core1Main);
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Wait until core 1 has drawn everything it has been sent
+\*****************************************************************************/
+void Ili9481Span::sync(void)
+    {
+    while (_completed != _issued)
+        tight_loop_contents();
+    __dmb();
+    }
+
+/*****************************************************************************\
+|* Method : Set the clip rectangle
+\*****************************************************************************/
+void Ili9481Span::setClip(Rect r)
+    {
+    SpanOp op   = _newOp(OP_CLIP);
+    op.r        = r;
+    _dispatch(op, 0, _bounds.w - 1);
+    }
+
+/*****************************************************************************\
+|* Method : Reset the clip rectangle
+\*****************************************************************************/
+void Ili9481Span::resetClipRectangle(void)
+    {
+    setClip(_bounds);
+    }
+
+/*****************************************************************************\
+|* Method : draw a line
+\*****************************************************************************/
+void Ili9481Span::line(Point p0, Point p1, RGB rgb)
+    {
+    SpanOp op   = _newOp(OP_LINE);
+    op.p[0]     = p0;
+    op.p[1]     = p1;
+    op.rgb      = rgb;
+    _dispatch(op, MIN(p0.x, p1.x), MAX(p0.x, p1.x));
+    }
+
+/*****************************************************************************\
+|* Method : draw a rectangle, filled or not
+\*****************************************************************************/
+void Ili9481Span::box(Rect r, RGB rgb, bool filled, int rounded)
+    {
+    SpanOp op   = _newOp(OP_BOX);
+    op.r        = r;
+    op.a        = rounded;
+    op.rgb      = rgb;
+    op.fill     = filled;
+    _dispatch(op, r.x, r.x + r.w - 1);
+    }
+
+/*****************************************************************************\
+|* Method : plot a pixel
+\*****************************************************************************/
+void Ili9481Span::plot(Point p, RGB rgb)
+    {
+    SpanOp op   = _newOp(OP_PLOT);
+    op.p[0]     = p;
+    op.rgb      = rgb;
+    _dispatch(op, p.x, p.x);
+    }
+
+/*****************************************************************************\
+|* Method : draw a circle, optionally filled
+\*****************************************************************************/
+void Ili9481Span::circle(Point p, int r, RGB rgb, bool filled)
+    {
+    SpanOp op   = _newOp(OP_CIRCLE);
+    op.p[0]     = p;
+    op.a        = r;
+    op.rgb      = rgb;
+    op.fill     = filled;
+    _dispatch(op, p.x - r, p.x + r);
+    }
+
+/*****************************************************************************\
+|* Method : draw an ellipse, optionally filled
+\*****************************************************************************/
+void Ili9481Span::ellipse(Point p, int rx, int ry, RGB rgb, bool filled)
+    {
+    SpanOp op   = _newOp(OP_ELLIPSE);
+    op.p[0]     = p;
+    op.a        = rx;
+    op.b        = ry;
+    op.rgb      = rgb;
+    op.fill     = filled;
+    _dispatch(op, p.x - rx, p.x + rx);
+    }
+
+/*****************************************************************************\
+|* Method : Draw a triangle, optionally filled
+\*****************************************************************************/
+void Ili9481Span::triangle(Point p0, Point p1, Point p2, RGB rgb, bool filled)
+    {
+    SpanOp op   = _newOp(OP_TRIANGLE);
+    op.p[0]     = p0;
+    op.p[1]     = p1;
+    op.p[2]     = p2;
+    op.rgb      = rgb;
+    op.fill     = filled;
+    _dispatch(op, MIN(p0.x, MIN(p1.x, p2.x)), MAX(p0.x, MAX(p1.x, p2.x)));
+    }
+
+/*****************************************************************************\
+|* Method : Fill both screens with a colour
+\*****************************************************************************/
+void Ili9481Span::clear(RGB rgb)
+    {
+    box(_bounds, rgb, true);
+    }
+
+#pragma mark - Private Methods
+
+/*****************************************************************************\
+|* Private Method : A primitive with every field set
+\*****************************************************************************/
+Ili9481Span::SpanOp Ili9481Span::_newOp(OpType type)
+    {
+    SpanOp op =
+        {
+        type,
+        {{0, 0}, {0, 0}, {0, 0}},
+        {0, 0, 0, 0},
+        0,
+        0,
+        RGB(0, 0, 0),
+        false
+        };
+    return op;
+    }
+
+/*****************************************************************************\
+|* Private Method : Queue the right-hand half first so both panels draw at
+|* the same time, then draw the left-hand half here. Primitives that only
+|* touch one panel are only sent to that one
+\*****************************************************************************/
+void Ili9481Span::_dispatch(const SpanOp &op, int x0, int x1)
+    {
+    if (x1 >= _split)
+        {
+        _issued ++;
+        queue_add_blocking(&_queue, &op);
+        }
+
+    if (x0 < _split)
+        _apply(_left, op, 0);
+    }
+
+/*****************************************************************************\
+|* Private Method : Draw a primitive on one panel, in its own co-ordinates
+\*****************************************************************************/
+void Ili9481Span::_apply(Ili9481 *dpy, const SpanOp &op, int dx)
+    {
+    Point p0 = {op.p[0].x - dx, op.p[0].y};
+    Point p1 = {op.p[1].x - dx, op.p[1].y};
+    Point p2 = {op.p[2].x - dx, op.p[2].y};
+
+    switch (op.type)
+        {
+        case OP_CLIP:
+            {
+            /*****************************************************************\
+            |* The panel's clip must never extend past its own edges
+            \*****************************************************************/
+            Rect b  = dpy->bounds();
+            int x0  = MAX(op.r.x - dx, b.x);
+            int y0  = MAX(op.r.y, b.y);
+            int x1  = MIN(op.r.x - dx + op.r.w, b.x + b.w);
+            int y1  = MIN(op.r.y + op.r.h, b.y + b.h);
+            dpy->setClip({x0, y0, MAX(0, x1 - x0), MAX(0, y1 - y0)});
+            break;
+            }
+        case OP_LINE:
+            dpy->line(p0, p1, op.rgb);
+            break;
+        case OP_BOX:
+            dpy->box({op.r.x - dx, op.r.y, op.r.w, op.r.h}, 
+                     op.rgb, op.fill, op.a);
+            break;
+        case OP_PLOT:
+            dpy->plot(p0, op.rgb);
+            break;
+        case OP_CIRCLE:
+            dpy->circle(p0, op.a, op.rgb, op.fill);
+            break;
+        case OP_ELLIPSE:
+            dpy->ellipse(p0, op.a, op.b, op.rgb, op.fill);
+            break;
+        case OP_TRIANGLE:
+            dpy->triangle(p0, p1, p2, op.rgb, op.fill);
+            break;
+        }
+    }
+
+/*****************************************************************************\
+|* Private Method : Core 1 just draws whatever arrives on the queue
+\*****************************************************************************/
+void Ili9481Span::_core1Main(void)
+    {
+    Ili9481Span *span = _active;
+    SpanOp op;
+
+    for (;;)
+        {
+        queue_remove_blocking(&span->_queue, &op);
+        _apply(span->_right, op, span->_split);
+
+        __dmb();
+        span->_completed = span->_completed + 1;
+        }
+    }
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+
+#include "Ili9481.h"
+
+/*****************************************************************************\
+|* Two displays side by side, on separate SPI blocks, presented as a single
+|* logical canvas. The left panel is drawn from the calling core, while the
+|* right panel is drawn by core 1 from a queue of primitives, so both buses
+|* are busy at once.
+|*
+|* Both displays must already be initialised and rotated before init(). Only
+|* one span can exist at a time, since it takes over core 1
+\*****************************************************************************/
+class Ili9481Span
+    {
+    NON_COPYABLE_NOR_MOVEABLE(Ili9481Span)
+
+ 	/*************************************************************************\
+    |* Enums
+    \*************************************************************************/
+    private:
+        enum OpType
+            {
+            OP_CLIP                          = 0,
+            OP_LINE,
+            OP_BOX,
+            OP_PLOT,
+            OP_CIRCLE,
+            OP_ELLIPSE,
+            OP_TRIANGLE,
+            };
+
+        /*********************************************************************\
+        |* A queued primitive, in logical co-ordinates
+        \*********************************************************************/
+        struct SpanOp
+            {
+            OpType type;        // What to draw
+            Point p[3];         // Points: ends, centre or corners
+            Rect r;             // Rectangle for boxes and clips
+            int a;              // Radius, x-radius or corner rounding
+            int b;              // y-radius
+            RGB rgb;            // Colour to draw in
+            bool fill;          // Filled or outline
+            };
+
+ 	/*************************************************************************\
+    |* Properties
+    \*************************************************************************/
+    GET(Rect, bounds);                      // Overall bounds of both panels
+
+    private:
+        Ili9481 *           _left;          // Drawn by the calling core
+        Ili9481 *           _right;         // Drawn by core 1
+        int                 _split;         // Logical x of the right panel
+        queue_t             _queue;         // Primitives waiting for core 1
+        uint32_t            _issued;        // Primitives sent to core 1
+        volatile uint32_t   _completed;     // Primitives core 1 has drawn
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit Ili9481Span(Ili9481 *left, Ili9481 *right);
+        ~Ili9481Span(void);
+
+        /*********************************************************************\
+        |* Start core 1 running the right-hand panel
+        \*********************************************************************/
+        int init(void);
+
+        /*********************************************************************\
+        |* Wait until core 1 has caught up
+        \*********************************************************************/
+        void sync(void);
+
+        /*********************************************************************\
+        |* Clip rectangle, in logical co-ordinates
+        \*********************************************************************/
+        void setClip(Rect r);
+        void resetClipRectangle(void);
+
+        /*********************************************************************\
+        |* Primitives, as for Ili9481, but across both panels
+        \*********************************************************************/
+        void line(Point p0, Point p1, RGB colour);
+        void box(Rect r, RGB rgb, bool filled=false, int rounded=0);
+        void plot(Point p, RGB colour);
+        void circle(Point p, int r, RGB colour, bool fill=false);
+        void ellipse(Point p, int rx, int ry, RGB rgb, bool fill=false);
+        void triangle(Point p0, Point p1, Point p2, RGB rgb, bool fill=false);
+        void clear(RGB rgb = RGB(0,0,0));
+
+    private:
+        /*********************************************************************\
+        |* Send a primitive to whichever panels it touches
+        \*********************************************************************/
+        void _dispatch(const SpanOp &op, int x0, int x1);
+
+        /*********************************************************************\
+        |* A primitive of a given type, with everything else zeroed
+        \*********************************************************************/
+        static SpanOp _newOp(OpType type);
+
+        /*********************************************************************\
+        |* Draw a primitive on one panel, shifted left by 'dx'
+        \*********************************************************************/
+        static void _apply(Ili9481 *dpy, const SpanOp &op, int dx);
+
+        /*********************************************************************\
+        |* Core 1 entry point
+        \*********************************************************************/
+        static void _core1Main(void);
+    };
@@ -0,0 +1,325 @@
+#include <math.h>
+
+#include "affine.h"
+#include "../include/errors.h"
+
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#  include "hardware/interp.h"
+#  define USE_INTERP
+#endif
+
+/*****************************************************************************\
+|* Defines
+\*****************************************************************************/
+
+#define FIX_ONE             0x10000
+#define FIX_HALF            0x8000
+
+/*****************************************************************************\
+|* Statics
+\*****************************************************************************/
+
+static inline int32_t _fix(float v)
+    {
+    return (int32_t) lrintf(v * FIX_ONE);
+    }
+
+static inline int32_t _mul(int32_t a, int32_t b)
+    {
+    return (int32_t)(((int64_t)a * b) >> 16);
+    }
+
+static inline int64_t _floorDiv(int64_t a, int64_t b)
+    {
+    int64_t q = a / b;
+    return ((a % b != 0) && ((a < 0) != (b < 0))) ? q - 1 : q;
+    }
+
+static inline int64_t _ceilDiv(int64_t a, int64_t b)
+    {
+    return -_floorDiv(-a, b);
+    }
+
+static inline int _clampInt(int v, int lo, int hi)
+    {
+    return (v < lo) ? lo : (v > hi) ? hi : v;
+    }
+
+/*****************************************************************************\
+|* Narrow [x0,x1] (inclusive) to the x where lo <= k + step*x <= hi
+\*****************************************************************************/
+static void _limit(int64_t k, int64_t step, int64_t lo, int64_t hi,
+                   int64_t *x0, int64_t *x1)
+    {
+    if (step == 0)
+        {
+        if ((k < lo) || (k > hi))
+            *x1 = *x0 - 1;
+        return;
+        }
+
+    int64_t a = (step > 0) ? _ceilDiv(lo - k, step)  : _ceilDiv(hi - k, step);
+    int64_t b = (step > 0) ? _floorDiv(hi - k, step) : _floorDiv(lo - k, step);
+    if (a > *x0)
+        *x0 = a;
+    if (b < *x1)
+        *x1 = b;
+    }
+
+/*****************************************************************************\
+|* Steps a pair of 16.16 source co-ordinates along a row
+\*****************************************************************************/
+class Stepper
+    {
+    private:
+#ifdef USE_INTERP
+        interp_hw_save_t _saved;
+#else
+        int32_t _u, _v, _du, _dv;
+#endif
+
+    public:
+        inline Stepper(int32_t u, int32_t v, int32_t du, int32_t dv)
+            {
+#ifdef USE_INTERP
+            /*****************************************************************\
+            |* Both lanes just add their base each pop. A lane's result is
+            |* the accumulator plus base, so start one step behind
+            \*****************************************************************/
+            interp_save(interp0, &_saved);
+
+            interp_config cfg = interp_default_config();
+            interp_config_set_add_raw(&cfg, true);
+            interp_set_config(interp0, 0, &cfg);
+            interp_set_config(interp0, 1, &cfg);
+
+            interp0->accum[0]   = u - du;
+            interp0->base[0]    = du;
+            interp0->accum[1]   = v - dv;
+            interp0->base[1]    = dv;
+#else
+            _u  = u;
+            _v  = v;
+            _du = du;
+            _dv = dv;
+#endif
+            }
+
+        inline ~Stepper(void)
+            {
+#ifdef USE_INTERP
+            interp_restore(interp0, &_saved);
+#endif
+            }
+
+        inline void next(int32_t *u, int32_t *v)
+            {
+#ifdef USE_INTERP
+            *v = (int32_t) interp0->peek[1];
+            *u = (int32_t) interp0->pop[0];
+#else
+            *u  = _u;
+            *v  = _v;
+            _u += _du;
+            _v += _dv;
+#endif
+            }
+    };
+
+#pragma mark - Affine
+
+/*****************************************************************************\
+|* Builders
+\*****************************************************************************/
+Affine Affine::identity(void)
+    {
+    return {FIX_ONE, 0, 0, FIX_ONE, 0, 0};
+    }
+
+Affine Affine::translate(int dx, int dy)
+    {
+    return {FIX_ONE, 0, 0, FIX_ONE, dx * FIX_ONE, dy * FIX_ONE};
+    }
+
+Affine Affine::scale(float sx, float sy)
+    {
+    return {_fix(sx), 0, 0, _fix(sy), 0, 0};
+    }
+
+/*****************************************************************************\
+|* With y pointing down the screen, positive angles turn clockwise
+\*****************************************************************************/
+Affine Affine::rotate(float degrees)
+    {
+    float rad = degrees * (float)M_PI / 180.0f;
+    int32_t s = _fix(sinf(rad));
+    int32_t c = _fix(cosf(rad));
+    return {c, -s, s, c, 0, 0};
+    }
+
+/*****************************************************************************\
+|* Method : Compose, 'next' applied after this one
+\*****************************************************************************/
+Affine Affine::then(const Affine &n) const
+    {
+    Affine r;
+    r.a  = _mul(n.a, a)  + _mul(n.b, c);
+    r.b  = _mul(n.a, b)  + _mul(n.b, d);
+    r.c  = _mul(n.c, a)  + _mul(n.d, c);
+    r.d  = _mul(n.c, b)  + _mul(n.d, d);
+    r.tx = _mul(n.a, tx) + _mul(n.b, ty) + n.tx;
+    r.ty = _mul(n.c, tx) + _mul(n.d, ty) + n.ty;
+    return r;
+    }
+
+/*****************************************************************************\
+|* Method : Invert. The determinant is kept at 32.32 so small scales don't
+|* lose all their precision
+\*****************************************************************************/
+bool Affine::invert(Affine *inv) const
+    {
+    int64_t det = (int64_t)a * d - (int64_t)b * c;
+    if (det == 0)
+        return false;
+
+    inv->a  = (int32_t)((int64_t) d * FIX_ONE * FIX_ONE / det);
+    inv->b  = (int32_t)((int64_t)-b * FIX_ONE * FIX_ONE / det);
+    inv->c  = (int32_t)((int64_t)-c * FIX_ONE * FIX_ONE / det);
+    inv->d  = (int32_t)((int64_t) a * FIX_ONE * FIX_ONE / det);
+    inv->tx = -(_mul(inv->a, tx) + _mul(inv->b, ty));
+    inv->ty = -(_mul(inv->c, tx) + _mul(inv->d, ty));
+    return true;
+    }
+
+#pragma mark - AffineSampler
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+AffineSampler::AffineSampler(void)
+        :_src({nullptr, 0, 0})
+        ,_fmt(PF_WIRE)
+        ,_inv(Affine::identity())
+        ,_filter(NEAREST)
+        ,_bounds({0, 0, 0, 0})
+    {}
+
+/*****************************************************************************\
+|* Method : Invert the transform and find the destination bounding box
+\*****************************************************************************/
+int AffineSampler::setup(const Bitmap &src, PixelFormat fmt, const Affine &m,
+                         Filter filter)
+    {
+    _bounds = {0, 0, 0, 0};
+    if ((src.pixels == nullptr) || (src.w <= 0) || (src.h <= 0)
+        || !m.invert(&_inv))
+        return E_INVALID;
+
+    _src    = src;
+    _fmt    = fmt;
+    _filter = filter;
+
+    /*************************************************************************\
+    |* Map the corners across, and take the pixels that cover them
+    \*************************************************************************/
+    int32_t xs[2]   = {0, src.w * FIX_ONE};
+    int32_t ys[2]   = {0, src.h * FIX_ONE};
+    int32_t minX    = INT32_MAX;
+    int32_t minY    = INT32_MAX;
+    int32_t maxX    = INT32_MIN;
+    int32_t maxY    = INT32_MIN;
+
+    for (int i=0; i<4; i++)
+        {
+        int32_t x = _mul(m.a, xs[i & 1]) + _mul(m.b, ys[i >> 1]) + m.tx;
+        int32_t y = _mul(m.c, xs[i & 1]) + _mul(m.d, ys[i >> 1]) + m.ty;
+        minX = (x < minX) ? x : minX;
+        maxX = (x > maxX) ? x : maxX;
+        minY = (y < minY) ? y : minY;
+        maxY = (y > maxY) ? y : maxY;
+        }
+
+    _bounds.x = minX >> 16;
+    _bounds.y = minY >> 16;
+    _bounds.w = ((maxX + FIX_ONE - 1) >> 16) - _bounds.x;
+    _bounds.h = ((maxY + FIX_ONE - 1) >> 16) - _bounds.y;
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Solve for the run of pixel centres on row 'y' that map inside
+|* the source, in both u and v
+\*****************************************************************************/
+bool AffineSampler::span(int y, int *x0, int *x1)
+    {
+    int64_t lo = _bounds.x;
+    int64_t hi = _bounds.x + _bounds.w - 1;
+
+    int64_t ku = (int64_t)_inv.b * y + ((_inv.a + _inv.b) >> 1) + _inv.tx;
+    int64_t kv = (int64_t)_inv.d * y + ((_inv.c + _inv.d) >> 1) + _inv.ty;
+    _limit(ku, _inv.a, 0, (int64_t)_src.w * FIX_ONE - 1, &lo, &hi);
+    _limit(kv, _inv.c, 0, (int64_t)_src.h * FIX_ONE - 1, &lo, &hi);
+
+    if (hi < lo)
+        return false;
+
+    *x0 = (int) lo;
+    *x1 = (int) hi + 1;
+    return true;
+    }
+
+/*****************************************************************************\
+|* Method : Sample part of a row. Co-ordinates are clamped to the source,
+|* so rounding at the edge of a span can't read outside it
+\*****************************************************************************/
+void AffineSampler::sample(int x, int y, int n, uint8_t *dst)
+    {
+    int32_t su  = _inv.a * x + _inv.b * y + ((_inv.a + _inv.b) >> 1) + _inv.tx;
+    int32_t sv  = _inv.c * x + _inv.d * y + ((_inv.c + _inv.d) >> 1) + _inv.ty;
+    int wMax    = _src.w - 1;
+    int hMax    = _src.h - 1;
+
+    Stepper step(su, sv, _inv.a, _inv.c);
+
+    if (_filter == NEAREST)
+        {
+        for (int i=0; i<n; i++, dst += 3)
+            {
+            step.next(&su, &sv);
+            bitmapFetch(_src, _fmt,
+                        _clampInt(su >> 16, 0, wMax),
+                        _clampInt(sv >> 16, 0, hMax), dst);
+            }
+        return;
+        }
+
+    /*************************************************************************\
+    |* Bilinear: sample positions are relative to pixel centres, and the
+    |* fractions are cut to 8 bits for the blend
+    \*************************************************************************/
+    for (int i=0; i<n; i++, dst += 3)
+        {
+        step.next(&su, &sv);
+        int32_t fu  = su - FIX_HALF;
+        int32_t fv  = sv - FIX_HALF;
+        int wu      = (fu >> 8) & 0xFF;
+        int wv      = (fv >> 8) & 0xFF;
+        int u0      = _clampInt(fu >> 16,       0, wMax);
+        int u1      = _clampInt((fu >> 16) + 1, 0, wMax);
+        int v0      = _clampInt(fv >> 16,       0, hMax);
+        int v1      = _clampInt((fv >> 16) + 1, 0, hMax);
+
+        uint8_t p00[3], p10[3], p01[3], p11[3];
+        bitmapFetch(_src, _fmt, u0, v0, p00);
+        bitmapFetch(_src, _fmt, u1, v0, p10);
+        bitmapFetch(_src, _fmt, u0, v1, p01);
+        bitmapFetch(_src, _fmt, u1, v1, p11);
+
+        for (int k=0; k<3; k++)
+            {
+            int top = p00[k] * (256 - wu) + p10[k] * wu;
+            int bot = p01[k] * (256 - wu) + p11[k] * wu;
+            dst[k]  = ((top * (256 - wv) + bot * wv + FIX_HALF) >> 16) & 0xFC;
+            }
+        }
+    }
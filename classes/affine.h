@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bitmap.h"
+#include "../include/structures.h"
+
+/*****************************************************************************\
+|* A 2D affine transform in 16.16 fixed point, mapping (x,y) to
+|*
+|*      (a.x + b.y + tx, c.x + d.y + ty)
+|*
+|* Transforms are built up with then(), so that
+|*
+|*      Affine::translate(-8,-40).then(Affine::rotate(30)).then(
+|*          Affine::translate(160,240))
+|*
+|* spins an image about (8,40) and puts that point at (160,240)
+\*****************************************************************************/
+struct Affine
+    {
+    int32_t a, b, c, d;     // Linear part
+    int32_t tx, ty;         // Translation
+
+    static Affine identity(void);
+    static Affine translate(int dx, int dy);
+    static Affine scale(float sx, float sy);
+    static Affine rotate(float degrees);
+
+    /*************************************************************************\
+    |* This transform followed by 'next'
+    \*************************************************************************/
+    Affine then(const Affine &next) const;
+
+    /*************************************************************************\
+    |* The reverse mapping. Returns false if the transform squashes the
+    |* image to a line or a point
+    \*************************************************************************/
+    bool invert(Affine *inverse) const;
+    };
+
+/*****************************************************************************\
+|* Samples a bitmap through an affine transform, a destination row at a time.
+|*
+|* The source co-ordinates are stepped along the row with fixed-point adds.
+|* On the RP2040 the two accumulators are the interpolator's (saved and
+|* restored around each row, so other users of interp0 aren't disturbed);
+|* elsewhere they're plain integers
+\*****************************************************************************/
+class AffineSampler
+    {
+    public:
+        typedef enum
+            {
+            NEAREST = 0,        // Closest source pixel
+            BILINEAR            // Blend of the four closest source pixels
+            } Filter;
+
+    private:
+        Bitmap      _src;           // The source image
+        PixelFormat _fmt;           // Its pixel format
+        Affine      _inv;           // Destination to source
+        Filter      _filter;        // How to sample
+        Rect        _bounds;        // Destination bounding box
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit AffineSampler(void);
+
+        /*********************************************************************\
+        |* Set up for a source image and a source->destination transform
+        \*********************************************************************/
+        int setup(const Bitmap &src, PixelFormat fmt, const Affine &m,
+                  Filter filter=NEAREST);
+
+        /*********************************************************************\
+        |* Destination pixels the transformed image might touch
+        \*********************************************************************/
+        Rect bounds(void)               { return _bounds; }
+
+        /*********************************************************************\
+        |* The columns [x0, x1) of row 'y' whose pixel centres land inside
+        |* the source. Returns false if there aren't any
+        \*********************************************************************/
+        bool span(int y, int *x0, int *x1);
+
+        /*********************************************************************\
+        |* Write 'n' wire-format pixels of row 'y', starting at 'x'
+        \*********************************************************************/
+        void sample(int x, int y, int n, uint8_t *dst);
+    };
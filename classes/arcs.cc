@@ -0,0 +1,86 @@
+#include <utility>
+
+#include "arcs.h"
+
+/*****************************************************************************\
+|* Statics
+\*****************************************************************************/
+
+/*****************************************************************************\
+|* Every table from radius 0 to ARC_TABLE_MAX, built by the compiler, and an
+|* index of them by radius for each kind
+\*****************************************************************************/
+template <int R, ArcKind K>
+static constexpr ArcTable<R, K> _table = ArcTable<R, K>();
+
+template <ArcKind K>
+struct ArcIndex
+    {
+    const int16_t *at[ARC_TABLE_MAX + 1];
+    };
+
+template <ArcKind K, int... R>
+static constexpr ArcIndex<K> _index(std::integer_sequence<int, R...>)
+    {
+    return ArcIndex<K>{{_table<R, K>.at...}};
+    }
+
+static constexpr std::make_integer_sequence<int, ARC_TABLE_MAX + 1> _radii{};
+
+static constexpr ArcIndex<ARC_OUTLINE>  _outline    = _index<ARC_OUTLINE>(_radii);
+static constexpr ArcIndex<ARC_CORNER>   _corner     = _index<ARC_CORNER>(_radii);
+static constexpr ArcIndex<ARC_DISC>     _disc       = _index<ARC_DISC>(_radii);
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+ArcCache::ArcCache(void)
+        :_clock(0)
+    {
+    for (int i=0; i<ARC_CACHE_SLOTS; i++)
+        {
+        _slots[i].radius    = -1;
+        _slots[i].used      = 0;
+        }
+    }
+
+/*****************************************************************************\
+|* Method : Find the table for a radius. A run-time one that isn't there
+|* goes in the slot that has gone longest without being asked for
+\*****************************************************************************/
+const int16_t * ArcCache::table(int r, ArcKind kind)
+    {
+    if ((r < 0) || (r > ARC_CACHE_MAX))
+        return nullptr;
+
+    if (r <= ARC_TABLE_MAX)
+        switch (kind)
+            {
+            case ARC_OUTLINE:
+                return _outline.at[r];
+            case ARC_CORNER:
+                return _corner.at[r];
+            default:
+                return _disc.at[r];
+            }
+
+    _clock ++;
+    Slot *oldest = &_slots[0];
+    for (int i=0; i<ARC_CACHE_SLOTS; i++)
+        {
+        Slot &slot = _slots[i];
+        if ((slot.radius == r) && (slot.kind == kind))
+            {
+            slot.used = _clock;
+            return slot.at;
+            }
+        if (slot.used < oldest->used)
+            oldest = &slot;
+        }
+
+    oldest->radius  = r;
+    oldest->kind    = kind;
+    oldest->used    = _clock;
+    arcGenerate(r, kind, oldest->at);
+    return oldest->at;
+    }
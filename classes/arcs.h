@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../include/properties.h"
+
+/*****************************************************************************\
+|* Radii up to ARC_TABLE_MAX have their tables built by the compiler, into
+|* flash. Other radii up to ARC_CACHE_MAX are worked out when first asked
+|* for, and the last ARC_CACHE_SLOTS of them kept
+\*****************************************************************************/
+#ifndef ARC_TABLE_MAX
+#  define ARC_TABLE_MAX     16
+#endif
+
+#define ARC_CACHE_SLOTS     4
+#define ARC_CACHE_MAX       64
+
+/*****************************************************************************\
+|* The three midpoint recurrences the driver runs for round things, each of
+|* which can be replaced by a table of what it works out:
+|*
+|*  ARC_OUTLINE : entry j is how far along the octant the outline has got
+|*                ('xe') on step j, as _circle() and _circleHelper() have it
+|*  ARC_CORNER  : entry d is the half-width of the row d out from the centre
+|*                of a filled rounded corner, as _filledCircleHelper() draws
+|*  ARC_DISC    : the same for circle(), filled
+|*
+|* Entries the recurrence never reaches are -1
+\*****************************************************************************/
+enum ArcKind
+    {
+    ARC_OUTLINE                     = 0,
+    ARC_CORNER,
+    ARC_DISC,
+    ARC_KINDS
+    };
+
+/*****************************************************************************\
+|* Run a recurrence for radius 'r' into r+1 entries of 'out'. This is the
+|* only copy of the three, used by the compiler and at run time alike
+\*****************************************************************************/
+constexpr void arcGenerate(int r, ArcKind kind, int16_t *out)
+    {
+    for (int i=0; i<=r; i++)
+        out[i] = -1;
+
+    if (kind == ARC_OUTLINE)
+        {
+        int f   = 1 - r;
+        int ddx = 1;
+        int ddy = -2 * r;
+        int xe  = 0;
+        for (int j=0; (j <= r) && ((j == 0) || (xe < r - j)); j++)
+            {
+            while (f < 0)
+                {
+                xe ++;
+                f += (ddx += 2);
+                }
+            f     += (ddy += 2);
+            out[j] = (int16_t)xe;
+            }
+        }
+    else if (kind == ARC_CORNER)
+        {
+        int f   = 1 - r;
+        int ddx = 1;
+        int ddy = -2 * r;
+        int y   = 0;
+        while (y < r)
+            {
+            if (f >= 0)
+                {
+                out[r] = (int16_t)((out[r] > y) ? out[r] : y);
+                r --;
+                ddy += 2;
+                f   += ddy;
+                }
+            y ++;
+            ddx += 2;
+            f   += ddx;
+            out[y] = (int16_t)((out[y] > r) ? out[y] : r);
+            }
+        }
+    else
+        {
+        int xx  = 0;
+        int dx  = 1;
+        int dy  = 2 * r;
+        int p   = -(r >> 1);
+
+        out[0] = (int16_t)r;
+        while (xx < r)
+            {
+            if (p >= 0)
+                {
+                out[r] = (int16_t)((out[r] > xx) ? out[r] : xx);
+                dy -= 2;
+                p  -= dy;
+                r --;
+                }
+            dx += 2;
+            p  += dx;
+            xx ++;
+            out[xx] = (int16_t)((out[xx] > r) ? out[xx] : r);
+            }
+        }
+    }
+
+/*****************************************************************************\
+|* The table for one radius and kind, made by the compiler when it's used
+|* as a constexpr
+\*****************************************************************************/
+template <int R, ArcKind K>
+struct ArcTable
+    {
+    int16_t at[R + 1];
+
+    constexpr ArcTable()
+        :at()
+        {
+        arcGenerate(R, K, at);
+        }
+    };
+
+/*****************************************************************************\
+|* Finds the table for a radius: from flash if it's small enough, else from
+|* a few recently used ones worked out at run time. Each display has its
+|* own, so the two cores never share one
+\*****************************************************************************/
+class ArcCache
+    {
+    NON_COPYABLE_NOR_MOVEABLE(ArcCache)
+
+    private:
+        struct Slot
+            {
+            int         radius;                     // -1 if unused
+            ArcKind     kind;                       // Which recurrence
+            uint32_t    used;                       // When last asked for
+            int16_t     at[ARC_CACHE_MAX + 1];      // The table
+            };
+
+        Slot        _slots[ARC_CACHE_SLOTS];        // Run-time tables
+        uint32_t    _clock;                         // Counts lookups
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit ArcCache(void);
+
+        /*********************************************************************\
+        |* The table for 'r', or nullptr if it's too big to have one. A
+        |* run-time table only stays put until the next call
+        \*********************************************************************/
+        const int16_t * table(int r, ArcKind kind);
+    };
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+/*****************************************************************************\
+|* Pixel formats for images held in memory or flash
+\*****************************************************************************/
+typedef enum
+    {
+    PF_RGB565 = 0,          // uint16_t per pixel, 5:6:5
+    PF_WIRE                 // 3 bytes per pixel, RGB666 in the top 6 bits
+    } PixelFormat;
+
+/*****************************************************************************\
+|* An image that can be read at random, rows packed with no padding
+\*****************************************************************************/
+struct Bitmap
+    {
+    const void *pixels;     // First pixel of the top row
+    int w;                  // Width in pixels
+    int h;                  // Height in pixels
+    };
+
+/*****************************************************************************\
+|* Fetch one pixel as wire-format bytes
+\*****************************************************************************/
+static inline void bitmapFetch(const Bitmap &bm, PixelFormat fmt,
+                               int x, int y, uint8_t *dst)
+    {
+    int i = y * bm.w + x;
+    if (fmt == PF_RGB565)
+        {
+        uint16_t pix = ((const uint16_t *)bm.pixels)[i];
+        dst[0] = (pix >> 8) & 0xF8;
+        dst[1] = (pix >> 3) & 0xFC;
+        dst[2] = (pix << 3) & 0xF8;
+        }
+    else
+        {
+        const uint8_t *p = (const uint8_t *)bm.pixels + i * 3;
+        dst[0] = p[0];
+        dst[1] = p[1];
+        dst[2] = p[2];
+        }
+    }
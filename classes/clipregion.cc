@@ -0,0 +1,294 @@
+#include "clipregion.h"
+#include "../include/errors.h"
+#include "../include/macros.h"
+
+/*****************************************************************************\
+|* Constructor : an empty region
+\*****************************************************************************/
+ClipRegion::ClipRegion(void)
+        :_numBands(0)
+        ,_numSpans(0)
+        ,_extents({0, 0, 0, 0})
+    {}
+
+/*****************************************************************************\
+|* Constructor : a single rectangle
+\*****************************************************************************/
+ClipRegion::ClipRegion(Rect r)
+        :ClipRegion()
+    {
+    set(r);
+    }
+
+/*****************************************************************************\
+|* Method : Empty the region
+\*****************************************************************************/
+void ClipRegion::clear(void)
+    {
+    _numBands   = 0;
+    _numSpans   = 0;
+    _extents    = {0, 0, 0, 0};
+    }
+
+/*****************************************************************************\
+|* Method : Make the region one rectangle
+\*****************************************************************************/
+void ClipRegion::set(Rect r)
+    {
+    clear();
+    if ((r.w <= 0) || (r.h <= 0))
+        return;
+
+    _bands[0]   = {(int16_t)r.y, (int16_t)(r.y + r.h), 0, 1};
+    _spans[0]   = {(int16_t)r.x, (int16_t)(r.x + r.w)};
+    _numBands   = 1;
+    _numSpans   = 1;
+    _extents    = r;
+    }
+
+/*****************************************************************************\
+|* Methods : Set operations with a rectangle
+\*****************************************************************************/
+int ClipRegion::unite(Rect r)
+    {
+    return _combine(r, OP_UNION);
+    }
+
+int ClipRegion::subtract(Rect r)
+    {
+    return _combine(r, OP_SUBTRACT);
+    }
+
+int ClipRegion::intersect(Rect r)
+    {
+    return _combine(r, OP_INTERSECT);
+    }
+
+/*****************************************************************************\
+|* Method : Whether a pixel is in the region
+\*****************************************************************************/
+bool ClipRegion::contains(int x, int y) const
+    {
+    int b = _firstBand(y);
+    if ((b >= _numBands) || (_bands[b].y0 > y))
+        return false;
+
+    const Span *s = _spans + _bands[b].first;
+    for (int i=0; (i < _bands[b].num) && (s[i].x0 <= x); i++)
+        if (x < s[i].x1)
+            return true;
+    return false;
+    }
+
+#pragma mark - Private Methods
+
+/*****************************************************************************\
+|* Private Method : Binary search for the first band with y1 > y
+\*****************************************************************************/
+int ClipRegion::_firstBand(int y) const
+    {
+    int lo = 0;
+    int hi = _numBands;
+    while (lo < hi)
+        {
+        int mid = (lo + hi) >> 1;
+        if (_bands[mid].y1 <= y)
+            lo = mid + 1;
+        else
+            hi = mid;
+        }
+    return lo;
+    }
+
+/*****************************************************************************\
+|* Private Method : Combine with a rectangle. Every band edge, and the top
+|* and bottom of the rectangle, starts a new strip; each strip's spans are
+|* combined with the rectangle's (if it covers the strip), and strips with
+|* the same result are joined back up. The result is built on the side, so
+|* running out of room leaves the region alone
+\*****************************************************************************/
+int ClipRegion::_combine(Rect r, Op op)
+    {
+    if ((r.w <= 0) || (r.h <= 0))
+        {
+        if (op == OP_INTERSECT)
+            clear();
+        return E_OK;
+        }
+
+    int ry0 = r.y;
+    int ry1 = r.y + r.h;
+
+    /*************************************************************************\
+    |* Strip edges, in order, without repeats
+    \*************************************************************************/
+    int edges[CLIP_MAX_BANDS * 2 + 2];
+    int numEdges = 0;
+    for (int i=-1; i<_numBands; i++)
+        for (int k=0; k<2; k++)
+            {
+            int y = (i < 0) ? (k ? ry1 : ry0)
+                            : (k ? _bands[i].y1 : _bands[i].y0);
+            int at = numEdges;
+            while ((at > 0) && (edges[at - 1] > y))
+                at --;
+            if ((at > 0) && (edges[at - 1] == y))
+                continue;
+            for (int j=numEdges; j>at; j--)
+                edges[j] = edges[j - 1];
+            edges[at] = y;
+            numEdges ++;
+            }
+
+    Band bands[CLIP_MAX_BANDS];
+    Span spans[CLIP_MAX_SPANS];
+    int nb  = 0;
+    int ns  = 0;
+    int src = 0;
+
+    for (int e=0; e<numEdges-1; e++)
+        {
+        int y0 = edges[e];
+        int y1 = edges[e + 1];
+
+        /*********************************************************************\
+        |* The existing band covering this strip, if there is one
+        \*********************************************************************/
+        while ((src < _numBands) && (_bands[src].y1 <= y0))
+            src ++;
+
+        const Span *have    = nullptr;
+        int numHave         = 0;
+        if ((src < _numBands) && (_bands[src].y0 <= y0))
+            {
+            have    = _spans + _bands[src].first;
+            numHave = _bands[src].num;
+            }
+
+        int n;
+        if ((y0 >= ry0) && (y0 < ry1))
+            n = _spanOp(have, numHave, r.x, r.x + r.w, op,
+                        spans + ns, CLIP_MAX_SPANS - ns);
+        else if (op == OP_INTERSECT)
+            n = 0;
+        else
+            n = _spanOp(have, numHave, 0, 0, OP_UNION,
+                        spans + ns, CLIP_MAX_SPANS - ns);
+
+        if (n < 0)
+            return E_NO_RESOURCE;
+        if (n == 0)
+            continue;
+
+        /*********************************************************************\
+        |* Join onto the band above if it touches and has the same spans
+        \*********************************************************************/
+        if (nb > 0)
+            {
+            Band &prev = bands[nb - 1];
+            bool same  = (prev.y1 == y0) && (prev.num == n);
+            for (int i=0; same && (i<n); i++)
+                same = (spans[prev.first + i].x0 == spans[ns + i].x0)
+                    && (spans[prev.first + i].x1 == spans[ns + i].x1);
+            if (same)
+                {
+                prev.y1 = (int16_t)y1;
+                continue;
+                }
+            }
+
+        if (nb >= CLIP_MAX_BANDS)
+            return E_NO_RESOURCE;
+
+        bands[nb++] = {(int16_t)y0, (int16_t)y1, (uint8_t)ns, (uint8_t)n};
+        ns         += n;
+        }
+
+    /*************************************************************************\
+    |* Take the result, and work out the new bounding box
+    \*************************************************************************/
+    for (int i=0; i<nb; i++)
+        _bands[i] = bands[i];
+    for (int i=0; i<ns; i++)
+        _spans[i] = spans[i];
+    _numBands = nb;
+    _numSpans = ns;
+
+    if (nb == 0)
+        {
+        _extents = {0, 0, 0, 0};
+        return E_OK;
+        }
+
+    int x0 = INT16_MAX;
+    int x1 = INT16_MIN;
+    for (int i=0; i<nb; i++)
+        {
+        x0 = MIN(x0, _spans[_bands[i].first].x0);
+        x1 = MAX(x1, _spans[_bands[i].first + _bands[i].num - 1].x1);
+        }
+    _extents = {x0, _bands[0].y0, x1 - x0, _bands[nb - 1].y1 - _bands[0].y0};
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : One band's spans against [x0,x1). Spans are sorted and
+|* disjoint, and so is the result; spans that touch are joined
+\*****************************************************************************/
+int ClipRegion::_spanOp(const Span *a, int n, int x0, int x1, Op op,
+                        Span *out, int max)
+    {
+    int num = 0;
+
+    #define EMIT(s0, s1)                                                    \
+        do                                                                  \
+            {                                                               \
+            int e0 = (s0), e1 = (s1);                                       \
+            if (e1 > e0)                                                    \
+                {                                                           \
+                if ((num > 0) && (out[num - 1].x1 >= e0))                   \
+                    out[num - 1].x1 = (int16_t) MAX(out[num - 1].x1, e1);   \
+                else if (num >= max)                                        \
+                    return -1;                                              \
+                else                                                        \
+                    out[num++] = {(int16_t)e0, (int16_t)e1};                \
+                }                                                           \
+            } while (0)
+
+    switch (op)
+        {
+        case OP_UNION:
+            {
+            bool done = (x1 <= x0);
+            for (int i=0; i<n; i++)
+                {
+                if (!done && (x0 <= a[i].x0))
+                    {
+                    EMIT(x0, x1);
+                    done = true;
+                    }
+                EMIT(a[i].x0, a[i].x1);
+                }
+            if (!done)
+                EMIT(x0, x1);
+            break;
+            }
+
+        case OP_SUBTRACT:
+            for (int i=0; i<n; i++)
+                {
+                EMIT(a[i].x0, MIN(a[i].x1, x0));
+                EMIT(MAX(a[i].x0, x1), a[i].x1);
+                }
+            break;
+
+        case OP_INTERSECT:
+            for (int i=0; i<n; i++)
+                EMIT(MAX(a[i].x0, x0), MIN(a[i].x1, x1));
+            break;
+        }
+
+    #undef EMIT
+    return num;
+    }
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../include/structures.h"
+
+/*****************************************************************************\
+|* Capacity of a region: horizontal bands, and x-spans across all of them
+\*****************************************************************************/
+#define CLIP_MAX_BANDS      32
+#define CLIP_MAX_SPANS      64
+
+/*****************************************************************************\
+|* An area of the screen made of disjoint rectangles, kept the way X11 keeps
+|* regions: a list of horizontal bands, top to bottom, each with a sorted
+|* list of x-spans that all run the full height of the band. Bands next to
+|* each other with the same spans are merged, so a plain rectangle is one
+|* band with one span.
+|*
+|* clip() is the one place drawing is cut down to the region. It finds the
+|* first band by binary search, and then only looks at the bands the
+|* rectangle actually crosses, so its cost depends on those rather than on
+|* how many rectangles make up the region
+\*****************************************************************************/
+class ClipRegion
+    {
+    public:
+        struct Span
+            {
+            int16_t x0;             // First column
+            int16_t x1;             // Column after the last
+            };
+
+        struct Band
+            {
+            int16_t y0;             // First row
+            int16_t y1;             // Row after the last
+            uint8_t first;          // Index of its first span
+            uint8_t num;            // Number of spans
+            };
+
+    private:
+        enum Op
+            {
+            OP_UNION                        = 0,
+            OP_SUBTRACT,
+            OP_INTERSECT
+            };
+
+        Band    _bands[CLIP_MAX_BANDS];     // Bands, top to bottom
+        int     _numBands;                  // Bands in use
+        Span    _spans[CLIP_MAX_SPANS];     // Spans, by band then x
+        int     _numSpans;                  // Spans in use
+        Rect    _extents;                   // Bounding box
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit ClipRegion(void);
+        explicit ClipRegion(Rect r);
+
+        /*********************************************************************\
+        |* Make the region empty, or just one rectangle
+        \*********************************************************************/
+        void clear(void);
+        void set(Rect r);
+
+        /*********************************************************************\
+        |* Add, take away or keep only a rectangle. If the result wouldn't
+        |* fit, the region is left as it was and E_NO_RESOURCE returned
+        \*********************************************************************/
+        int unite(Rect r);
+        int subtract(Rect r);
+        int intersect(Rect r);
+
+        /*********************************************************************\
+        |* Queries
+        \*********************************************************************/
+        bool empty(void) const              { return _numBands == 0; }
+        bool rectangular(void) const        { return _numSpans <= 1; }
+        Rect extents(void) const            { return _extents; }
+        int bands(void) const               { return _numBands; }
+        bool contains(int x, int y) const;
+
+        /*********************************************************************\
+        |* Call fn(Rect) for each part of 'r' inside the region, top to
+        |* bottom and left to right within a band
+        \*********************************************************************/
+        template <class Fn> void clip(Rect r, Fn fn) const;
+
+    private:
+        /*********************************************************************\
+        |* Combine with a rectangle, band by band
+        \*********************************************************************/
+        int _combine(Rect r, Op op);
+
+        /*********************************************************************\
+        |* First band that ends below row 'y'
+        \*********************************************************************/
+        int _firstBand(int y) const;
+
+        /*********************************************************************\
+        |* Combine one band's spans with [x0,x1) into 'out'. Returns the
+        |* number of spans, or <0 if there are more than 'max'
+        \*********************************************************************/
+        static int _spanOp(const Span *a, int n, int x0, int x1, Op op,
+                           Span *out, int max);
+    };
+
+/*****************************************************************************\
+|* Method : The shared clipping routine
+\*****************************************************************************/
+template <class Fn>
+void ClipRegion::clip(Rect r, Fn fn) const
+    {
+    int x1 = r.x + r.w;
+    int y1 = r.y + r.h;
+    if ((r.w <= 0) || (r.h <= 0)
+        || (r.x >= _extents.x + _extents.w) || (x1 <= _extents.x)
+        || (r.y >= _extents.y + _extents.h) || (y1 <= _extents.y))
+        return;
+
+    for (int b=_firstBand(r.y); (b < _numBands) && (_bands[b].y0 < y1); b++)
+        {
+        const Band &band    = _bands[b];
+        int top             = (r.y > band.y0) ? r.y : band.y0;
+        int bottom          = (y1 < band.y1) ? y1 : band.y1;
+        const Span *s       = _spans + band.first;
+
+        for (int i=0; (i < band.num) && (s[i].x0 < x1); i++)
+            {
+            if (s[i].x1 <= r.x)
+                continue;
+
+            int left    = (r.x > s[i].x0) ? r.x : s[i].x0;
+            int right   = (x1 < s[i].x1) ? x1 : s[i].x1;
+            fn(Rect{left, top, right - left, bottom - top});
+            }
+        }
+    }
@@ -0,0 +1,32 @@
+#include "imagesource.h"
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Rgb565Source::Rgb565Source(const uint16_t *pixels, int w, int h)
+        :_pixels(pixels)
+        ,_w(w)
+        ,_h(h)
+        ,_line(0)
+    {}
+
+/*****************************************************************************\
+|* Method : Convert the next few lines to wire format
+\*****************************************************************************/
+int Rgb565Source::readLines(uint8_t *buf, int n)
+    {
+    if (n > _h - _line)
+        n = _h - _line;
+
+    int num = n * _w;
+    for (int i=0; i<num; i++)
+        {
+        uint16_t pix = *_pixels ++;
+        *buf ++ = (pix >> 8) & 0xF8;
+        *buf ++ = (pix >> 3) & 0xFC;
+        *buf ++ = (pix << 3) & 0xF8;
+        }
+
+    _line += n;
+    return n;
+    }
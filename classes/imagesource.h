@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*****************************************************************************\
+|* Something that produces an image a few lines at a time, in the wire format
+|* the display wants (3 bytes per pixel, RGB666 in the top 6 bits of each).
+|* Decoders implement this so that Ili9481::drawImage() can stream them
+\*****************************************************************************/
+class ImageSource
+    {
+    public:
+        virtual ~ImageSource(void) {}
+
+        /*********************************************************************\
+        |* Size of the image in pixels
+        \*********************************************************************/
+        virtual int width(void)     = 0;
+        virtual int height(void)    = 0;
+
+        /*********************************************************************\
+        |* Write up to 'n' lines, each width()*3 bytes, into 'buf'. Returns
+        |* the number of lines written, 0 at the end, or <0 on error
+        \*********************************************************************/
+        virtual int readLines(uint8_t *buf, int n) = 0;
+    };
+
+
+/*****************************************************************************\
+|* An ImageSource for an RGB565 array in memory (or XIP flash)
+\*****************************************************************************/
+class Rgb565Source : public ImageSource
+    {
+    private:
+        const uint16_t *    _pixels;        // Next pixel to convert
+        int                 _w;             // Width in pixels
+        int                 _h;             // Height in pixels
+        int                 _line;          // Next line to convert
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit Rgb565Source(const uint16_t *pixels, int w, int h);
+
+        /*********************************************************************\
+        |* ImageSource
+        \*********************************************************************/
+        int width(void)     { return _w; }
+        int height(void)    { return _h; }
+        int readLines(uint8_t *buf, int n);
+    };
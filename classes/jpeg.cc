@@ -0,0 +1,858 @@
+#include <string.h>
+
+#include "jpeg.h"
+#include "../include/errors.h"
+
+/*****************************************************************************\
+|* Defines
+\*****************************************************************************/
+
+#define CONST_BITS          13
+#define PASS1_BITS          2
+#define DESCALE(x,n)        (((x) + (1 << ((n)-1))) >> (n))
+
+#define FIX_0_298631336     2446
+#define FIX_0_390180644     3196
+#define FIX_0_541196100     4433
+#define FIX_0_765366865     6270
+#define FIX_0_899976223     7373
+#define FIX_1_175875602     9633
+#define FIX_1_501321110     12299
+#define FIX_1_847759065     15137
+#define FIX_1_961570560     16069
+#define FIX_2_053119869     16819
+#define FIX_2_562915447     20995
+#define FIX_3_072711026     25172
+
+#define RED_CR              91881       // 1.40200 << 16
+#define GREEN_CB            22554       // 0.34414 << 16
+#define GREEN_CR            46802       // 0.71414 << 16
+#define BLUE_CB             116130      // 1.77200 << 16
+
+#define FAST_BITS           8
+
+/*****************************************************************************\
+|* Enums
+\*****************************************************************************/
+
+enum
+    {
+    M_SOF0                              = 0xC0,
+    M_SOF1                              = 0xC1,
+    M_DHT                               = 0xC4,
+    M_RST0                              = 0xD0,
+    M_RST7                              = 0xD7,
+    M_SOI                               = 0xD8,
+    M_EOI                               = 0xD9,
+    M_SOS                               = 0xDA,
+    M_DQT                               = 0xDB,
+    M_DRI                               = 0xDD,
+    };
+
+/*****************************************************************************\
+|* Statics
+\*****************************************************************************/
+
+// Natural position of each coefficient in zig-zag order
+static const uint8_t _zigzag[64] =
+    {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+    };
+
+// Reduced-size IDCT bases, C(u).cos((2x+1)u.PI/2N)/2 in 12-bit fixed point
+static const int16_t _idct4[4][4] =
+    {
+    { 1448,  1448,  1448,  1448 },
+    { 1892,   784,  -784, -1892 },
+    { 1448, -1448, -1448,  1448 },
+    {  784, -1892,  1892,  -784 },
+    };
+
+static const int16_t _idct2[2][2] =
+    {
+    { 1448,  1448 },
+    { 1448, -1448 },
+    };
+
+static inline int _read16(const uint8_t *p)
+    {
+    return (p[0] << 8) | p[1];
+    }
+
+static inline uint8_t _clamp(int v)
+    {
+    return (v < 0) ? 0 : (v > 255) ? 255 : v;
+    }
+
+static inline int _extend(int v, int s)
+    {
+    return (v < (1 << (s-1))) ? v - (1 << s) + 1 : v;
+    }
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+JpegDecoder::JpegDecoder(void)
+        :_width(0)
+        ,_height(0)
+        ,_mcuWidth(0)
+        ,_mcuHeight(0)
+        ,_scale(0)
+        ,_data(nullptr)
+        ,_scan(nullptr)
+        ,_pos(nullptr)
+        ,_end(nullptr)
+        ,_fullW(0)
+        ,_fullH(0)
+        ,_numComps(0)
+        ,_hMax(1)
+        ,_vMax(1)
+        ,_mcusX(0)
+        ,_mcusY(0)
+        ,_mcu(0)
+        ,_restart(0)
+        ,_toRestart(0)
+        ,_bits(0)
+        ,_numBits(0)
+        ,_hitMarker(false)
+    {
+    memset(_quant, 0, sizeof(_quant));
+    memset(_huff, 0, sizeof(_huff));
+    }
+
+/*****************************************************************************\
+|* Method : Parse the headers, leaving us at the start of the scan
+\*****************************************************************************/
+int JpegDecoder::open(const uint8_t *data, int len)
+    {
+    _data       = nullptr;
+    _scan       = nullptr;
+    _numComps   = 0;
+    _restart    = 0;
+
+    if ((data == nullptr) || (len < 4) || (data[0] != 0xFF)
+        || (data[1] != M_SOI))
+        {
+        printf(T_ERR "Not a JPEG file\n");
+        return E_INVALID;
+        }
+
+    const uint8_t *p    = data + 2;
+    const uint8_t *end  = data + len;
+    bool haveFrame      = false;
+
+    while (_scan == nullptr)
+        {
+        /*********************************************************************\
+        |* Find the next marker, skipping any fill bytes
+        \*********************************************************************/
+        while ((p < end) && (*p != 0xFF))
+            p ++;
+        while ((p < end) && (*p == 0xFF))
+            p ++;
+        if (p + 3 > end)
+            {
+            printf(T_ERR "JPEG ended before the scan\n");
+            return E_INVALID;
+            }
+
+        int marker = *p ++;
+        if ((marker == M_SOI) || ((marker >= M_RST0) && (marker <= M_RST7)))
+            continue;
+        if (marker == M_EOI)
+            {
+            printf(T_ERR "JPEG ended before the scan\n");
+            return E_INVALID;
+            }
+
+        int segLen = _read16(p);
+        if ((segLen < 2) || (p + segLen > end))
+            {
+            printf(T_ERR "Bad JPEG segment length\n");
+            return E_INVALID;
+            }
+
+        const uint8_t *body = p + 2;
+        int bodyLen         = segLen - 2;
+        int ok              = E_OK;
+
+        switch (marker)
+            {
+            case M_DQT:
+                ok = _parseDQT(body, bodyLen);
+                break;
+
+            case M_DHT:
+                ok = _parseDHT(body, bodyLen);
+                break;
+
+            case M_SOF0:
+            case M_SOF1:
+                ok = _parseSOF(body, bodyLen);
+                haveFrame = (ok == E_OK);
+                break;
+
+            case M_DRI:
+                _restart = (bodyLen >= 2) ? _read16(body) : 0;
+                break;
+
+            case M_SOS:
+                if (!haveFrame)
+                    {
+                    printf(T_ERR "JPEG scan before frame\n");
+                    return E_INVALID;
+                    }
+                ok = _parseSOS(body, bodyLen);
+                _scan = p + segLen;
+                break;
+
+            default:
+                /*************************************************************\
+                |* Any other frame type is progressive, lossless or
+                |* arithmetic coded, none of which we handle. Everything
+                |* else (APPn, COM, ...) is skipped
+                \*************************************************************/
+                if ((marker > M_SOF1) && (marker <= 0xCF)
+                    && (marker != M_DHT) && (marker != 0xC8)
+                    && (marker != 0xCC))
+                    {
+                    printf(T_ERR "Only baseline JPEG is supported\n");
+                    return E_INVALID;
+                    }
+                break;
+            }
+
+        if (ok != E_OK)
+            {
+            _scan = nullptr;
+            return ok;
+            }
+        p += segLen;
+        }
+
+    _data   = data;
+    _end    = end;
+    return setScale(_scale);
+    }
+
+/*****************************************************************************\
+|* Method : Choose the reduction, and work out the scaled geometry
+\*****************************************************************************/
+int JpegDecoder::setScale(int shift)
+    {
+    if ((shift < 0) || (shift > 3))
+        return E_INVALID;
+
+    _scale      = shift;
+    int round   = (1 << shift) - 1;
+    _width      = (_fullW + round) >> shift;
+    _height     = (_fullH + round) >> shift;
+    _mcuWidth   = (8 * _hMax) >> shift;
+    _mcuHeight  = (8 * _vMax) >> shift;
+
+    rewind();
+    return (_data == nullptr) ? E_INVALID : E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Start again from the first MCU
+\*****************************************************************************/
+void JpegDecoder::rewind(void)
+    {
+    _pos        = _scan;
+    _bits       = 0;
+    _numBits    = 0;
+    _hitMarker  = false;
+    _mcu        = 0;
+    _toRestart  = _restart;
+    for (int i=0; i<3; i++)
+        _comps[i].pred = 0;
+    }
+
+/*****************************************************************************\
+|* Method : Decode the next MCU, skipping the maths if it isn't visible
+\*****************************************************************************/
+int JpegDecoder::decodeMcu(const uint8_t **pixels, Rect *where,
+                           const Rect *visible)
+    {
+    if ((_data == nullptr) || (_mcu >= _mcusX * _mcusY))
+        return 0;
+
+    if (_restart > 0)
+        {
+        if (_toRestart == 0)
+            {
+            int ok = _processRestart();
+            if (ok != E_OK)
+                return ok;
+            }
+        _toRestart --;
+        }
+
+    /*************************************************************************\
+    |* Where does this one go, and do we need to reconstruct it ?
+    \*************************************************************************/
+    Rect r;
+    r.x = (_mcu % _mcusX) * _mcuWidth;
+    r.y = (_mcu / _mcusX) * _mcuHeight;
+    r.w = (r.x + _mcuWidth  > _width)  ? _width  - r.x : _mcuWidth;
+    r.h = (r.y + _mcuHeight > _height) ? _height - r.y : _mcuHeight;
+    _mcu ++;
+
+    bool wanted = (visible == nullptr)
+               || ((r.x < visible->x + visible->w)
+                   && (visible->x < r.x + r.w)
+                   && (r.y < visible->y + visible->h)
+                   && (visible->y < r.y + r.h));
+
+    int bs = 8 >> _scale;
+    for (int i=0; i<_numComps; i++)
+        {
+        Component *c    = &_comps[i];
+        int stride      = bs * c->h;
+        for (int by=0; by<c->v; by++)
+            for (int bx=0; bx<c->h; bx++)
+                {
+                int ok = _decodeBlock(c, wanted);
+                if (ok != E_OK)
+                    return ok;
+                if (wanted)
+                    _idct(_planes[i] + by*bs*stride + bx*bs, stride);
+                }
+        }
+
+    if (wanted)
+        _colourConvert(r.w, r.h);
+    else
+        r.w = r.h = 0;
+
+    *pixels = _out;
+    *where  = r;
+    return 1;
+    }
+
+#pragma mark - Private methods
+
+/*****************************************************************************\
+|* Private Method : Quantisation tables, kept in zig-zag order
+\*****************************************************************************/
+int JpegDecoder::_parseDQT(const uint8_t *p, int len)
+    {
+    while (len > 0)
+        {
+        int pq  = p[0] >> 4;
+        int tq  = p[0] & 15;
+        int n   = 1 + 64 * (pq + 1);
+        if ((tq > 3) || (pq > 1) || (len < n))
+            {
+            printf(T_ERR "Bad JPEG quantisation table\n");
+            return E_INVALID;
+            }
+
+        for (int i=0; i<64; i++)
+            _quant[tq][i] = pq ? _read16(p + 1 + i*2) : p[1 + i];
+        p   += n;
+        len -= n;
+        }
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Huffman tables, expanded into the lookup form
+\*****************************************************************************/
+int JpegDecoder::_parseDHT(const uint8_t *p, int len)
+    {
+    while (len > 17)
+        {
+        int tc  = p[0] >> 4;
+        int th  = p[0] & 15;
+        if ((tc > 1) || (th > 1))
+            {
+            printf(T_ERR "Bad JPEG huffman table\n");
+            return E_INVALID;
+            }
+
+        const uint8_t *counts   = p + 1;
+        int total               = 0;
+        for (int i=0; i<16; i++)
+            total += counts[i];
+        if ((total > 256) || (len < 17 + total))
+            {
+            printf(T_ERR "Bad JPEG huffman table\n");
+            return E_INVALID;
+            }
+
+        Huffman *h = &_huff[tc*2 + th];
+        memcpy(h->values, p + 17, total);
+        memset(h->fastLen, 0, sizeof(h->fastLen));
+
+        /*********************************************************************\
+        |* Canonical codes: each length follows on from the last, shifted
+        |* up a bit. Short codes also fill every matching 8-bit prefix
+        \*********************************************************************/
+        int code    = 0;
+        int k       = 0;
+        for (int l=1; l<=16; l++)
+            {
+            h->valptr[l]    = k;
+            h->mincode[l]   = code;
+            for (int i=0; i<counts[l-1]; i++, k++, code++)
+                if (l <= FAST_BITS)
+                    {
+                    int shift = FAST_BITS - l;
+                    for (int j=0; j<(1 << shift); j++)
+                        {
+                        h->fastSym[(code << shift) | j] = h->values[k];
+                        h->fastLen[(code << shift) | j] = l;
+                        }
+                    }
+            h->maxcode[l]   = counts[l-1] ? code - 1 : -1;
+            code          <<= 1;
+            }
+        h->maxcode[17] = 0x7FFFFFFF;
+
+        p   += 17 + total;
+        len -= 17 + total;
+        }
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Frame header
+\*****************************************************************************/
+int JpegDecoder::_parseSOF(const uint8_t *p, int len)
+    {
+    if ((len < 6) || (p[0] != 8))
+        {
+        printf(T_ERR "Only 8-bit JPEG is supported\n");
+        return E_INVALID;
+        }
+
+    _fullH      = _read16(p + 1);
+    _fullW      = _read16(p + 3);
+    _numComps   = p[5];
+    if ((_fullW == 0) || (_fullH == 0)
+        || ((_numComps != 1) && (_numComps != 3))
+        || (len < 6 + 3 * _numComps))
+        {
+        printf(T_ERR "Unsupported JPEG frame\n");
+        return E_INVALID;
+        }
+
+    _hMax = _vMax = 1;
+    for (int i=0; i<_numComps; i++)
+        {
+        const uint8_t *c    = p + 6 + 3*i;
+        _comps[i].id        = c[0];
+        _comps[i].h         = c[1] >> 4;
+        _comps[i].v         = c[1] & 15;
+        _comps[i].tq        = c[2] & 3;
+        if ((_comps[i].h < 1) || (_comps[i].h > 2)
+            || (_comps[i].v < 1) || (_comps[i].v > 2))
+            {
+            printf(T_ERR "Unsupported JPEG sampling\n");
+            return E_INVALID;
+            }
+        _hMax = (_comps[i].h > _hMax) ? _comps[i].h : _hMax;
+        _vMax = (_comps[i].v > _vMax) ? _comps[i].v : _vMax;
+        }
+
+    /*************************************************************************\
+    |* A single-component scan isn't interleaved, so its MCU is one block
+    \*************************************************************************/
+    if (_numComps == 1)
+        {
+        _comps[0].h = _comps[0].v = 1;
+        _hMax       = _vMax       = 1;
+        }
+
+    _mcusX = (_fullW + 8*_hMax - 1) / (8*_hMax);
+    _mcusY = (_fullH + 8*_vMax - 1) / (8*_vMax);
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Scan header. Only a single scan of every component
+\*****************************************************************************/
+int JpegDecoder::_parseSOS(const uint8_t *p, int len)
+    {
+    if ((len < 1) || (p[0] != _numComps) || (len < 1 + 2*_numComps))
+        {
+        printf(T_ERR "Unsupported JPEG scan\n");
+        return E_INVALID;
+        }
+
+    for (int i=0; i<_numComps; i++)
+        {
+        const uint8_t *s = p + 1 + 2*i;
+        if (s[0] != _comps[i].id)
+            {
+            printf(T_ERR "JPEG scan out of order\n");
+            return E_INVALID;
+            }
+        _comps[i].td = (s[1] >> 4) & 1;
+        _comps[i].ta = s[1] & 1;
+        }
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Top up the bit buffer, unstuffing 0xFF 0x00. At a marker
+|* we stop reading and feed zeros instead
+\*****************************************************************************/
+void JpegDecoder::_fill(void)
+    {
+    while (_numBits <= 24)
+        {
+        int byte = 0;
+        if (!_hitMarker && (_pos < _end))
+            {
+            if (*_pos != 0xFF)
+                byte = *_pos ++;
+            else if ((_pos + 1 < _end) && (_pos[1] == 0x00))
+                {
+                byte  = 0xFF;
+                _pos += 2;
+                }
+            else
+                _hitMarker = true;
+            }
+        _bits      |= (uint32_t)byte << (24 - _numBits);
+        _numBits   += 8;
+        }
+    }
+
+/*****************************************************************************\
+|* Private Method : Take 'n' bits off the front of the buffer
+\*****************************************************************************/
+int JpegDecoder::_getBits(int n)
+    {
+    if (n == 0)
+        return 0;
+    if (_numBits < n)
+        _fill();
+
+    int v       = _bits >> (32 - n);
+    _bits     <<= n;
+    _numBits   -= n;
+    return v;
+    }
+
+/*****************************************************************************\
+|* Private Method : Decode one huffman symbol, or -1 for a bad code
+\*****************************************************************************/
+int JpegDecoder::_decode(const Huffman *h)
+    {
+    if (_numBits < 16)
+        _fill();
+
+    int peek    = _bits >> (32 - FAST_BITS);
+    int len     = h->fastLen[peek];
+    if (len > 0)
+        {
+        _bits     <<= len;
+        _numBits   -= len;
+        return h->fastSym[peek];
+        }
+
+    for (int l=FAST_BITS+1; l<=16; l++)
+        {
+        int code = _bits >> (32 - l);
+        if (code <= h->maxcode[l])
+            {
+            _bits     <<= l;
+            _numBits   -= l;
+            return h->values[(h->valptr[l] + code - h->mincode[l]) & 0xFF];
+            }
+        }
+    return -1;
+    }
+
+/*****************************************************************************\
+|* Private Method : Decode and dequantise one block into _coef. If it isn't
+|* wanted the coefficients are still read, but not stored
+\*****************************************************************************/
+int JpegDecoder::_decodeBlock(Component *c, bool wanted)
+    {
+    const Huffman *dc       = &_huff[c->td];
+    const Huffman *ac       = &_huff[2 + c->ta];
+    const uint16_t *q       = _quant[c->tq];
+
+    int t = _decode(dc);
+    if ((t < 0) || (t > 11))
+        return E_INVALID;
+    c->pred += t ? _extend(_getBits(t), t) : 0;
+
+    if (wanted)
+        {
+        memset(_coef, 0, sizeof(_coef));
+        _coef[0] = c->pred * q[0];
+        }
+
+    for (int k=1; k<64; k++)
+        {
+        int rs = _decode(ac);
+        if (rs < 0)
+            return E_INVALID;
+
+        int s = rs & 15;
+        if (s == 0)
+            {
+            if (rs != 0xF0)
+                break;              // End of block
+            k += 15;                // Sixteen zeros
+            continue;
+            }
+
+        k += rs >> 4;
+        if (k > 63)
+            return E_INVALID;
+
+        int v = _extend(_getBits(s), s);
+        if (wanted)
+            _coef[_zigzag[k]] = v * q[k];
+        }
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Skip to the next RSTn marker and reset the predictors
+\*****************************************************************************/
+int JpegDecoder::_processRestart(void)
+    {
+    while ((_pos + 1 < _end)
+           && !((_pos[0] == 0xFF) && (_pos[1] >= M_RST0)
+                && (_pos[1] <= M_RST7)))
+        _pos ++;
+    if (_pos + 1 >= _end)
+        return E_INVALID;
+
+    _pos       += 2;
+    _bits       = 0;
+    _numBits    = 0;
+    _hitMarker  = false;
+    _toRestart  = _restart;
+    for (int i=0; i<_numComps; i++)
+        _comps[i].pred = 0;
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Inverse DCT of _coef into an NxN block of samples, where
+|* N is 8 >> scale. Full size is the usual accurate integer IDCT, done in
+|* place; 4x4 and 2x2 use the low coefficients only, and 1x1 is just DC
+\*****************************************************************************/
+void JpegDecoder::_idct(uint8_t *dst, int stride)
+    {
+    int32_t *ws = _coef;
+
+    if (_scale == 3)
+        {
+        dst[0] = _clamp(DESCALE(ws[0], 3) + 128);
+        return;
+        }
+
+    if (_scale > 0)
+        {
+        int n                   = 8 >> _scale;
+        const int16_t *base     = (n == 4) ? &_idct4[0][0] : &_idct2[0][0];
+        int32_t tmp[4][4];
+
+        for (int v=0; v<n; v++)
+            for (int x=0; x<n; x++)
+                {
+                int32_t sum = 0;
+                for (int u=0; u<n; u++)
+                    sum += base[u*n + x] * ws[v*8 + u];
+                tmp[v][x] = DESCALE(sum, 10);
+                }
+
+        for (int y=0; y<n; y++)
+            for (int x=0; x<n; x++)
+                {
+                int32_t sum = 0;
+                for (int v=0; v<n; v++)
+                    sum += base[v*n + y] * tmp[v][x];
+                dst[y*stride + x] = _clamp(DESCALE(sum, 14) + 128);
+                }
+        return;
+        }
+
+    /*************************************************************************\
+    |* Pass 1: columns, leaving PASS1_BITS of extra precision
+    \*************************************************************************/
+    for (int col=0; col<8; col++)
+        {
+        int32_t *in = ws + col;
+        if ((in[8] | in[16] | in[24] | in[32] | in[40] | in[48] | in[56]) == 0)
+            {
+            int32_t dc = in[0] << PASS1_BITS;
+            for (int i=0; i<8; i++)
+                in[i*8] = dc;
+            continue;
+            }
+
+        int32_t z2      = in[16];
+        int32_t z3      = in[48];
+        int32_t z1      = (z2 + z3) * FIX_0_541196100;
+        int32_t tmp2    = z1 - z3 * FIX_1_847759065;
+        int32_t tmp3    = z1 + z2 * FIX_0_765366865;
+
+        z2              = in[0];
+        z3              = in[32];
+        int32_t tmp0    = (z2 + z3) << CONST_BITS;
+        int32_t tmp1    = (z2 - z3) << CONST_BITS;
+
+        int32_t tmp10   = tmp0 + tmp3;
+        int32_t tmp13   = tmp0 - tmp3;
+        int32_t tmp11   = tmp1 + tmp2;
+        int32_t tmp12   = tmp1 - tmp2;
+
+        tmp0            = in[56];
+        tmp1            = in[40];
+        tmp2            = in[24];
+        tmp3            = in[8];
+
+        z1              = tmp0 + tmp3;
+        z2              = tmp1 + tmp2;
+        z3              = tmp0 + tmp2;
+        int32_t z4      = tmp1 + tmp3;
+        int32_t z5      = (z3 + z4) * FIX_1_175875602;
+
+        tmp0           *= FIX_0_298631336;
+        tmp1           *= FIX_2_053119869;
+        tmp2           *= FIX_3_072711026;
+        tmp3           *= FIX_1_501321110;
+        z1             *= -FIX_0_899976223;
+        z2             *= -FIX_2_562915447;
+        z3              = z3 * -FIX_1_961570560 + z5;
+        z4              = z4 * -FIX_0_390180644 + z5;
+
+        tmp0           += z1 + z3;
+        tmp1           += z2 + z4;
+        tmp2           += z2 + z3;
+        tmp3           += z1 + z4;
+
+        in[0]  = DESCALE(tmp10 + tmp3, CONST_BITS - PASS1_BITS);
+        in[56] = DESCALE(tmp10 - tmp3, CONST_BITS - PASS1_BITS);
+        in[8]  = DESCALE(tmp11 + tmp2, CONST_BITS - PASS1_BITS);
+        in[48] = DESCALE(tmp11 - tmp2, CONST_BITS - PASS1_BITS);
+        in[16] = DESCALE(tmp12 + tmp1, CONST_BITS - PASS1_BITS);
+        in[40] = DESCALE(tmp12 - tmp1, CONST_BITS - PASS1_BITS);
+        in[24] = DESCALE(tmp13 + tmp0, CONST_BITS - PASS1_BITS);
+        in[32] = DESCALE(tmp13 - tmp0, CONST_BITS - PASS1_BITS);
+        }
+
+    /*************************************************************************\
+    |* Pass 2: rows, removing the scaling and level-shifting back to 0..255
+    \*************************************************************************/
+    const int shift = CONST_BITS + PASS1_BITS + 3;
+    for (int row=0; row<8; row++)
+        {
+        int32_t *in     = ws + row*8;
+        uint8_t *out    = dst + row*stride;
+
+        int32_t z2      = in[2];
+        int32_t z3      = in[6];
+        int32_t z1      = (z2 + z3) * FIX_0_541196100;
+        int32_t tmp2    = z1 - z3 * FIX_1_847759065;
+        int32_t tmp3    = z1 + z2 * FIX_0_765366865;
+
+        int32_t tmp0    = (in[0] + in[4]) << CONST_BITS;
+        int32_t tmp1    = (in[0] - in[4]) << CONST_BITS;
+
+        int32_t tmp10   = tmp0 + tmp3;
+        int32_t tmp13   = tmp0 - tmp3;
+        int32_t tmp11   = tmp1 + tmp2;
+        int32_t tmp12   = tmp1 - tmp2;
+
+        tmp0            = in[7];
+        tmp1            = in[5];
+        tmp2            = in[3];
+        tmp3            = in[1];
+
+        z1              = tmp0 + tmp3;
+        z2              = tmp1 + tmp2;
+        z3              = tmp0 + tmp2;
+        int32_t z4      = tmp1 + tmp3;
+        int32_t z5      = (z3 + z4) * FIX_1_175875602;
+
+        tmp0           *= FIX_0_298631336;
+        tmp1           *= FIX_2_053119869;
+        tmp2           *= FIX_3_072711026;
+        tmp3           *= FIX_1_501321110;
+        z1             *= -FIX_0_899976223;
+        z2             *= -FIX_2_562915447;
+        z3              = z3 * -FIX_1_961570560 + z5;
+        z4              = z4 * -FIX_0_390180644 + z5;
+
+        tmp0           += z1 + z3;
+        tmp1           += z2 + z4;
+        tmp2           += z2 + z3;
+        tmp3           += z1 + z4;
+
+        out[0] = _clamp(DESCALE(tmp10 + tmp3, shift) + 128);
+        out[7] = _clamp(DESCALE(tmp10 - tmp3, shift) + 128);
+        out[1] = _clamp(DESCALE(tmp11 + tmp2, shift) + 128);
+        out[6] = _clamp(DESCALE(tmp11 - tmp2, shift) + 128);
+        out[2] = _clamp(DESCALE(tmp12 + tmp1, shift) + 128);
+        out[5] = _clamp(DESCALE(tmp12 - tmp1, shift) + 128);
+        out[3] = _clamp(DESCALE(tmp13 + tmp0, shift) + 128);
+        out[4] = _clamp(DESCALE(tmp13 - tmp0, shift) + 128);
+        }
+    }
+
+/*****************************************************************************\
+|* Private Method : Upsample the chroma and convert the visible part of the
+|* MCU to packed wire-format RGB666
+\*****************************************************************************/
+void JpegDecoder::_colourConvert(int w, int h)
+    {
+    uint8_t *out    = _out;
+    int bs          = 8 >> _scale;
+
+    if (_numComps == 1)
+        {
+        for (int y=0; y<h; y++)
+            for (int x=0; x<w; x++)
+                {
+                uint8_t v = _planes[0][y*bs + x] & 0xFC;
+                *out ++ = v;
+                *out ++ = v;
+                *out ++ = v;
+                }
+        return;
+        }
+
+    const Component *cb = &_comps[1];
+    const Component *cr = &_comps[2];
+    int yStride         = bs * _comps[0].h;
+    int bStride         = bs * cb->h;
+    int rStride         = bs * cr->h;
+
+    for (int y=0; y<h; y++)
+        {
+        const uint8_t *ys = _planes[0] + y * _comps[0].v / _vMax * yStride;
+        const uint8_t *bp = _planes[1] + y * cb->v / _vMax * bStride;
+        const uint8_t *rp = _planes[2] + y * cr->v / _vMax * rStride;
+
+        for (int x=0; x<w; x++)
+            {
+            int Y   = ys[x * _comps[0].h / _hMax];
+            int Cb  = bp[x * cb->h / _hMax] - 128;
+            int Cr  = rp[x * cr->h / _hMax] - 128;
+
+            *out ++ = _clamp(Y + ((RED_CR * Cr + 32768) >> 16)) & 0xFC;
+            *out ++ = _clamp(Y - ((GREEN_CB * Cb + GREEN_CR * Cr
+                                   - 32768) >> 16)) & 0xFC;
+            *out ++ = _clamp(Y + ((BLUE_CB * Cb + 32768) >> 16)) & 0xFC;
+            }
+        }
+    }
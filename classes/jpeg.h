@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../include/properties.h"
+#include "../include/structures.h"
+
+/*****************************************************************************\
+|* Streaming baseline JPEG decoder. It reads straight from memory or XIP
+|* flash and produces one MCU at a time in wire format, so Ili9481::drawJpeg()
+|* can push each MCU through its own window with no framebuffer.
+|*
+|* Supports baseline huffman (SOF0/SOF1), greyscale or YCbCr with up to 2x2
+|* luma sampling, and restart intervals. Decoding can be scaled by 1/2, 1/4
+|* or 1/8, which also makes it proportionally cheaper. Everything lives in
+|* the object (about 6.5KB), with no heap use, and nothing depends on the
+|* Pico SDK so it can be built and checked on a host
+\*****************************************************************************/
+class JpegDecoder
+    {
+    NON_COPYABLE_NOR_MOVEABLE(JpegDecoder)
+
+    private:
+        /*********************************************************************\
+        |* A huffman table, with an 8-bit lookahead for the common short codes
+        \*********************************************************************/
+        struct Huffman
+            {
+            uint8_t  fastSym[256];          // Symbol for an 8-bit prefix
+            uint8_t  fastLen[256];          // Its code length, 0 = slow path
+            uint8_t  values[256];           // Symbols, in code order
+            int32_t  maxcode[18];           // Largest code of each length
+            int32_t  valptr[17];            // First symbol of each length
+            int32_t  mincode[17];           // Smallest code of each length
+            };
+
+        /*********************************************************************\
+        |* Per-component state
+        \*********************************************************************/
+        struct Component
+            {
+            int id;                         // Component id from the frame
+            int h;                          // Horizontal sampling factor
+            int v;                          // Vertical sampling factor
+            int tq;                         // Quantisation table
+            int td;                         // DC huffman table
+            int ta;                         // AC huffman table
+            int pred;                       // Previous DC value
+            };
+
+    /*************************************************************************\
+    |* Properties
+    \*************************************************************************/
+    GET(int, width);                        // Scaled width of the image
+    GET(int, height);                       // Scaled height of the image
+    GET(int, mcuWidth);                     // Scaled width of an MCU
+    GET(int, mcuHeight);                    // Scaled height of an MCU
+    GET(int, scale);                        // log2 of the reduction, 0..3
+
+    private:
+        const uint8_t * _data;              // Start of the file
+        const uint8_t * _scan;              // Start of the entropy data
+        const uint8_t * _pos;               // Next byte of entropy data
+        const uint8_t * _end;               // End of the file
+
+        int             _fullW;             // Unscaled width
+        int             _fullH;             // Unscaled height
+        int             _numComps;          // 1 (grey) or 3 (YCbCr)
+        int             _hMax;              // Largest horizontal sampling
+        int             _vMax;              // Largest vertical sampling
+        int             _mcusX;             // MCUs across the image
+        int             _mcusY;             // MCUs down the image
+        int             _mcu;               // Next MCU to decode
+        int             _restart;           // MCUs per restart interval
+        int             _toRestart;         // MCUs left in this interval
+
+        uint32_t        _bits;              // Bit buffer, MSB first
+        int             _numBits;           // Valid bits in _bits
+        bool            _hitMarker;         // Stopped filling at a marker
+
+        Component       _comps[3];          // The components
+        uint16_t        _quant[4][64];      // Quantisation, zig-zag order
+        Huffman         _huff[4];           // DC0, DC1, AC0, AC1
+        int32_t         _coef[64];          // Dequantised block
+        uint8_t         _planes[3][256];    // Component samples for an MCU
+        uint8_t         _out[16*16*3];      // Wire-format MCU
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit JpegDecoder(void);
+
+        /*********************************************************************\
+        |* Parse the headers, up to the start of the scan
+        \*********************************************************************/
+        int open(const uint8_t *data, int len);
+
+        /*********************************************************************\
+        |* Reduce the output by 2^shift (0..3). Resets to the first MCU
+        \*********************************************************************/
+        int setScale(int shift);
+
+        /*********************************************************************\
+        |* Start again from the first MCU
+        \*********************************************************************/
+        void rewind(void);
+
+        /*********************************************************************\
+        |* Decode the next MCU. 'where' is set to the part of the (scaled)
+        |* image it covers, and 'pixels' to that many wire-format pixels,
+        |* packed. If 'visible' is given and the MCU misses it, the entropy
+        |* data is skipped over without an IDCT, and 'where' is empty.
+        |* Returns 1 for an MCU, 0 at the end, or <0 on error
+        \*********************************************************************/
+        int decodeMcu(const uint8_t **pixels, Rect *where,
+                      const Rect *visible = nullptr);
+
+    private:
+        /*********************************************************************\
+        |* Header segments
+        \*********************************************************************/
+        int _parseDQT(const uint8_t *p, int len);
+        int _parseDHT(const uint8_t *p, int len);
+        int _parseSOF(const uint8_t *p, int len);
+        int _parseSOS(const uint8_t *p, int len);
+
+        /*********************************************************************\
+        |* Entropy decoding
+        \*********************************************************************/
+        void _fill(void);
+        int  _getBits(int n);
+        int  _decode(const Huffman *h);
+        int  _decodeBlock(Component *c, bool wanted);
+        int  _processRestart(void);
+
+        /*********************************************************************\
+        |* Sample reconstruction
+        \*********************************************************************/
+        void _idct(uint8_t *dst, int stride);
+        void _colourConvert(int w, int h);
+    };
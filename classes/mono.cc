@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mono.h"
+#include "../include/errors.h"
+#include "../include/macros.h"
+
+/*****************************************************************************\
+|* Statics
+\*****************************************************************************/
+
+/*****************************************************************************\
+|* Set or clear bits [from, to) of a bit row, a word at a time
+\*****************************************************************************/
+static void _span(uint32_t *row, int from, int to, bool set)
+    {
+    int first       = from >> 5;
+    int last        = (to - 1) >> 5;
+    uint32_t head   = ~0u << (from & 31);
+    uint32_t tail   = ~0u >> (31 - ((to - 1) & 31));
+
+    if (first == last)
+        head &= tail;
+
+    row[first] = set ? (row[first] | head) : (row[first] & ~head);
+    if (first == last)
+        return;
+
+    for (int i=first+1; i<last; i++)
+        row[i] = set ? ~0u : 0;
+    row[last] = set ? (row[last] | tail) : (row[last] & ~tail);
+    }
+
+/*****************************************************************************\
+|* How far apart two colours are
+\*****************************************************************************/
+static inline int _distance(RGB a, RGB b)
+    {
+    int dr = a.r - b.r;
+    int dg = a.g - b.g;
+    int db = a.b - b.b;
+    return dr * dr + dg * dg + db * db;
+    }
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+MonoBuffer::MonoBuffer(void)
+        :_width(0)
+        ,_height(0)
+        ,_ink(RGB(0x3F,0x3F,0x3F))
+        ,_paper(RGB(0,0,0))
+        ,_bits(nullptr)
+        ,_words(0)
+        ,_dirty(nullptr)
+        ,_lut(nullptr)
+    {}
+
+/*****************************************************************************\
+|* Destructor
+\*****************************************************************************/
+MonoBuffer::~MonoBuffer(void)
+    {
+    FREE(_bits);
+    FREE(_dirty);
+    FREE(_lut);
+    }
+
+/*****************************************************************************\
+|* Method : Make the buffer
+\*****************************************************************************/
+int MonoBuffer::init(int width, int height, RGB ink, RGB paper)
+    {
+    FREE(_bits);
+    FREE(_dirty);
+    FREE(_lut);
+    _width  = 0;
+    _height = 0;
+
+    if ((width <= 0) || (height <= 0))
+        return E_INVALID;
+
+    _words  = (width + 31) >> 5;
+    _bits   = (uint32_t *) calloc(_words * height, sizeof(uint32_t));
+    _dirty  = (uint32_t *) calloc((height + 31) >> 5, sizeof(uint32_t));
+    _lut    = (uint8_t *) malloc(256 * MONO_LUT_STRIDE);
+    if ((_bits == nullptr) || (_dirty == nullptr) || (_lut == nullptr))
+        {
+        printf(T_ERR "No memory for a %dx%d mono buffer\n", width, height);
+        FREE(_bits);
+        FREE(_dirty);
+        FREE(_lut);
+        return E_NO_RESOURCE;
+        }
+
+    _width  = width;
+    _height = height;
+    setColours(ink, paper);
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Change the colours, and with them the table
+\*****************************************************************************/
+void MonoBuffer::setColours(RGB ink, RGB paper)
+    {
+    _ink    = ink;
+    _paper  = paper;
+    if (_lut == nullptr)
+        return;
+
+    for (int b=0; b<256; b++)
+        {
+        uint8_t *px = _lut + b * MONO_LUT_STRIDE;
+        for (int i=0; i<8; i++, px += 3)
+            {
+            RGB c = (b & (1 << i)) ? ink : paper;
+            px[0] = c.r;
+            px[1] = c.g;
+            px[2] = c.b;
+            }
+        }
+
+    _span(_dirty, 0, _height, true);
+    }
+
+/*****************************************************************************\
+|* Method : Whether a colour comes out as ink
+\*****************************************************************************/
+bool MonoBuffer::isInk(RGB colour) const
+    {
+    return _distance(colour, _ink) < _distance(colour, _paper);
+    }
+
+/*****************************************************************************\
+|* Method : Fill the part of a rectangle inside the buffer
+\*****************************************************************************/
+void MonoBuffer::fill(Rect r, bool ink)
+    {
+    int x0 = MAX(r.x, 0);
+    int y0 = MAX(r.y, 0);
+    int x1 = MIN(r.x + r.w, _width);
+    int y1 = MIN(r.y + r.h, _height);
+    if ((x1 <= x0) || (y1 <= y0))
+        return;
+
+    for (int y=y0; y<y1; y++)
+        _span(_bits + y * _words, x0, x1, ink);
+    _span(_dirty, y0, y1, true);
+    }
+
+/*****************************************************************************\
+|* Method : Read a pixel back
+\*****************************************************************************/
+bool MonoBuffer::pixel(int x, int y) const
+    {
+    if ((x < 0) || (x >= _width) || (y < 0) || (y >= _height))
+        return false;
+    return (_bits[y * _words + (x >> 5)] >> (x & 31)) & 1;
+    }
+
+/*****************************************************************************\
+|* Method : Find the next run of dirty rows, stepping over clean ones 32 at
+|* a time
+\*****************************************************************************/
+int MonoBuffer::nextDirty(int from, int *num) const
+    {
+    *num = 0;
+    if ((_dirty == nullptr) || (from < 0) || (from >= _height))
+        return -1;
+
+    int words   = (_height + 31) >> 5;
+    int w       = from >> 5;
+    uint32_t m  = _dirty[w] & (~0u << (from & 31));
+
+    while (m == 0)
+        {
+        if (++w >= words)
+            return -1;
+        m = _dirty[w];
+        }
+
+    int first   = (w << 5) + __builtin_ctz(m);
+    int y       = first;
+    while ((y < _height) && ((_dirty[y >> 5] >> (y & 31)) & 1))
+        {
+        if (((y & 31) == 0) && (_dirty[y >> 5] == ~0u))
+            y += 32;
+        else
+            y ++;
+        }
+
+    *num = MIN(y, _height) - first;
+    return first;
+    }
+
+/*****************************************************************************\
+|* Method : Mark rows as sent
+\*****************************************************************************/
+void MonoBuffer::clean(int y, int num)
+    {
+    int y1 = MIN(y + num, _height);
+    y = MAX(y, 0);
+    if (y1 > y)
+        _span(_dirty, y, y1, false);
+    }
+
+/*****************************************************************************\
+|* Method : Turn a row into wire pixels, 8 at a time through the table
+\*****************************************************************************/
+void MonoBuffer::expand(int y, int w, uint8_t *dst) const
+    {
+    const uint8_t *src  = (const uint8_t *)(_bits + y * _words);
+    int whole           = MIN(w, _width) >> 3;
+
+    for (int i=0; i<whole; i++, dst += MONO_LUT_STRIDE)
+        memcpy(dst, _lut + src[i] * MONO_LUT_STRIDE, MONO_LUT_STRIDE);
+
+    int rest = MIN(w, _width) & 7;
+    if (rest > 0)
+        memcpy(dst, _lut + src[whole] * MONO_LUT_STRIDE, rest * 3);
+    }
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../include/properties.h"
+#include "../include/structures.h"
+
+/*****************************************************************************\
+|* Bytes a buffer byte turns into on the wire: 8 pixels of 3 bytes
+\*****************************************************************************/
+#define MONO_LUT_STRIDE     24
+
+/*****************************************************************************\
+|* A 1bpp copy of the screen (320x480 is 19.2KB), with a bit per row saying
+|* whether it has changed since it was last sent.
+|*
+|* A row is a run of 32-bit words, pixel x being bit (x & 31) of word
+|* (x >> 5), so a span is a mask at each end and whole words between, and
+|* the dirty rows are kept the same way. Read a byte at a time (the RP2040
+|* is little-endian) that's 8 pixels, lowest bit first, and a 256 entry
+|* table of what each byte looks like on the wire, in the two colours,
+|* turns a row into wire pixels with a copy per byte
+\*****************************************************************************/
+class MonoBuffer
+    {
+    NON_COPYABLE_NOR_MOVEABLE(MonoBuffer)
+
+    /*************************************************************************\
+    |* Properties
+    \*************************************************************************/
+    GET(int, width);                        // In pixels
+    GET(int, height);
+    GET(RGB, ink);                          // What a set bit looks like
+    GET(RGB, paper);                        // And a clear one
+
+    private:
+        uint32_t *  _bits;                  // The pixels, row by row
+        int         _words;                 // Words per row
+        uint32_t *  _dirty;                 // A bit per row
+        uint8_t *   _lut;                   // Wire pixels for each byte
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit MonoBuffer(void);
+        ~MonoBuffer(void);
+
+        /*********************************************************************\
+        |* Make the buffer, all paper and all dirty. Returns E_NO_RESOURCE
+        |* if there isn't the memory
+        \*********************************************************************/
+        int init(int width, int height, RGB ink, RGB paper);
+
+        /*********************************************************************\
+        |* Change the two colours, which makes every row dirty
+        \*********************************************************************/
+        void setColours(RGB ink, RGB paper);
+
+        /*********************************************************************\
+        |* Whether a colour is drawn as ink: it's nearer ink than paper
+        \*********************************************************************/
+        bool isInk(RGB colour) const;
+
+        /*********************************************************************\
+        |* Set (ink) or clear (paper) the part of 'r' inside the buffer, and
+        |* read a pixel back
+        \*********************************************************************/
+        void fill(Rect r, bool ink);
+        bool pixel(int x, int y) const;
+
+        /*********************************************************************\
+        |* The first row at or after 'from' that's dirty, or -1, and how
+        |* many dirty rows follow on from it; and mark rows clean again
+        \*********************************************************************/
+        int nextDirty(int from, int *num) const;
+        void clean(int y, int num);
+
+        /*********************************************************************\
+        |* The first 'w' pixels of row 'y', as wire pixels
+        \*********************************************************************/
+        void expand(int y, int w, uint8_t *dst) const;
+    };
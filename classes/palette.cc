@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "palette.h"
+#include "../include/errors.h"
+#include "../include/macros.h"
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Palette::Palette(void)
+        :_area({0, 0, 0, 0})
+        ,_shadow(nullptr)
+        ,_stride(0)
+        ,_rows(nullptr)
+    {
+    for (int i=0; i<PALETTE_SIZE; i++)
+        _colours[i] = RGB(0, 0, 0);
+    }
+
+/*****************************************************************************\
+|* Destructor
+\*****************************************************************************/
+Palette::~Palette(void)
+    {
+    FREE(_shadow);
+    FREE(_rows);
+    }
+
+/*****************************************************************************\
+|* Method : Make the shadow for an area
+\*****************************************************************************/
+int Palette::init(Rect area, int index)
+    {
+    FREE(_shadow);
+    FREE(_rows);
+    _area = {0, 0, 0, 0};
+
+    if ((area.w <= 0) || (area.h <= 0))
+        return E_INVALID;
+
+    _stride = (area.w + 1) / 2;
+    _shadow = (uint8_t *) malloc(_stride * area.h);
+    _rows   = (uint16_t *) malloc(area.h * sizeof(uint16_t));
+    if ((_shadow == nullptr) || (_rows == nullptr))
+        {
+        printf(T_ERR "No memory for a %dx%d palette shadow\n",
+               area.w, area.h);
+        FREE(_shadow);
+        FREE(_rows);
+        return E_NO_RESOURCE;
+        }
+
+    index &= 0xF;
+    memset(_shadow, index * 0x11, _stride * area.h);
+    for (int y=0; y<area.h; y++)
+        _rows[y] = (uint16_t)(1 << index);
+
+    _area = area;
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : The colour of an entry
+\*****************************************************************************/
+RGB Palette::colour(int index) const
+    {
+    if ((index < 0) || (index >= PALETTE_SIZE))
+        return RGB(0, 0, 0);
+    return _colours[index];
+    }
+
+/*****************************************************************************\
+|* Method : Change an entry
+\*****************************************************************************/
+void Palette::setColour(int index, RGB colour)
+    {
+    if ((index >= 0) && (index < PALETTE_SIZE))
+        _colours[index] = colour;
+    }
+
+/*****************************************************************************\
+|* Method : The entry a pixel was last drawn with
+\*****************************************************************************/
+int Palette::index(int x, int y) const
+    {
+    x -= _area.x;
+    y -= _area.y;
+    if ((_shadow == nullptr) || (x < 0) || (x >= _area.w)
+        || (y < 0) || (y >= _area.h))
+        return -1;
+
+    uint8_t pair = _shadow[y * _stride + (x >> 1)];
+    return (x & 1) ? (pair & 0xF) : (pair >> 4);
+    }
+
+/*****************************************************************************\
+|* Method : Note the part of 'r' inside the area as an entry. A half-byte
+|* at either end, and whole bytes between
+\*****************************************************************************/
+void Palette::mark(Rect r, int index)
+    {
+    if (_shadow == nullptr)
+        return;
+
+    int x0 = MAX(r.x, _area.x) - _area.x;
+    int y0 = MAX(r.y, _area.y) - _area.y;
+    int x1 = MIN(r.x + r.w, _area.x + _area.w) - _area.x;
+    int y1 = MIN(r.y + r.h, _area.y + _area.h) - _area.y;
+    if ((x1 <= x0) || (y1 <= y0))
+        return;
+
+    index          &= 0xF;
+    uint8_t both    = (uint8_t)(index * 0x11);
+    uint16_t bit    = (uint16_t)(1 << index);
+    bool whole      = (x0 == 0) && (x1 == _area.w);
+
+    for (int y=y0; y<y1; y++)
+        {
+        uint8_t *row    = _shadow + y * _stride;
+        int x           = x0;
+
+        if (x & 1)
+            {
+            row[x >> 1] = (uint8_t)((row[x >> 1] & 0xF0) | index);
+            x ++;
+            }
+
+        int pairs = (x1 - x) >> 1;
+        memset(row + (x >> 1), both, pairs);
+        x += pairs * 2;
+
+        if (x < x1)
+            row[x >> 1] = (uint8_t)((row[x >> 1] & 0x0F) | (index << 4));
+
+        _rows[y] = whole ? bit : (uint16_t)(_rows[y] | bit);
+        }
+    }
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../include/properties.h"
+#include "../include/structures.h"
+
+/*****************************************************************************\
+|* Entries in a palette; an index fits in half a byte, and the one value
+|* left over marks a pixel drawn with no entry
+\*****************************************************************************/
+#define PALETTE_SIZE        15
+#define PALETTE_NONE        15
+
+/*****************************************************************************\
+|* A palette of PALETTE_SIZE colours, and a record of which entry each
+|* pixel of an area of the screen was last drawn with: a 4bpp shadow, two
+|* pixels a byte (the left one in the high half), and for each row a mask
+|* of the entries that might be in it. A pixel last drawn with something
+|* other than an entry is PALETTE_NONE, which runs() never looks for.
+|*
+|* The masks only ever gain bits, other than when a whole row is drawn in
+|* one go, so they may say an entry is in a row when it no longer is, but
+|* never the other way round. They let runs() skip the rows an entry isn't
+|* in without looking at their pixels
+\*****************************************************************************/
+class Palette
+    {
+    NON_COPYABLE_NOR_MOVEABLE(Palette)
+
+    /*************************************************************************\
+    |* Properties
+    \*************************************************************************/
+    GET(Rect, area);                        // Part of the screen recorded
+
+    private:
+        RGB         _colours[PALETTE_SIZE]; // The entries
+        uint8_t *   _shadow;                // 4bpp, a row at a time
+        int         _stride;                // Bytes per row of _shadow
+        uint16_t *  _rows;                  // Entries in each row
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit Palette(void);
+        ~Palette(void);
+
+        /*********************************************************************\
+        |* Make the shadow for 'area', every pixel of it starting out as
+        |* entry 'index' (or PALETTE_NONE). Returns E_NO_RESOURCE if there
+        |* isn't the memory
+        \*********************************************************************/
+        int init(Rect area, int index=0);
+
+        /*********************************************************************\
+        |* The colour of an entry, and changing it. Changing it here doesn't
+        |* touch the screen; Ili9481::setPaletteEntry() does that. An index
+        |* that isn't an entry reads as black, and is ignored when set
+        \*********************************************************************/
+        RGB colour(int index) const;
+        void setColour(int index, RGB colour);
+
+        /*********************************************************************\
+        |* The entry a pixel was last drawn with, PALETTE_NONE if it wasn't
+        |* drawn with one, or -1 outside the area
+        \*********************************************************************/
+        int index(int x, int y) const;
+
+        /*********************************************************************\
+        |* Note that the part of 'r' inside the area is now entry 'index',
+        |* or PALETTE_NONE
+        \*********************************************************************/
+        void mark(Rect r, int index);
+
+        /*********************************************************************\
+        |* Call fn(x, y, w) for each run of pixels that are entry 'index',
+        |* top to bottom and left to right
+        \*********************************************************************/
+        template <class Fn> void runs(int index, Fn fn) const;
+    };
+
+/*****************************************************************************\
+|* Method : Find the runs of an entry. A byte that doesn't end or start a
+|* run is stepped over in one go
+\*****************************************************************************/
+template <class Fn>
+void Palette::runs(int index, Fn fn) const
+    {
+    if ((_shadow == nullptr) || (index < 0) || (index >= PALETTE_SIZE))
+        return;
+
+    uint16_t bit    = (uint16_t)(1 << index);
+    uint8_t both    = (uint8_t)(index * 0x11);
+
+    for (int y=0; y<_area.h; y++)
+        {
+        if ((_rows[y] & bit) == 0)
+            continue;
+
+        const uint8_t *row  = _shadow + y * _stride;
+        int start           = -1;
+        for (int x=0; x<_area.w; )
+            {
+            if (((x & 1) == 0) && (x + 1 < _area.w))
+                {
+                uint8_t pair = row[x >> 1];
+                bool same    = (start >= 0)
+                             ? (pair == both)
+                             : (((pair >> 4) != index)
+                                && ((pair & 0xF) != index));
+                if (same)
+                    {
+                    x += 2;
+                    continue;
+                    }
+                }
+
+            int nibble  = (x & 1) ? (row[x >> 1] & 0xF) : (row[x >> 1] >> 4);
+            bool in     = (nibble == index);
+            if (in && (start < 0))
+                start = x;
+            else if (!in && (start >= 0))
+                {
+                fn(_area.x + start, _area.y + y, x - start);
+                start = -1;
+                }
+            x ++;
+            }
+
+        if (start >= 0)
+            fn(_area.x + start, _area.y + y, _area.w - start);
+        }
+    }
@@ -0,0 +1,556 @@
+#include "path.h"
+#include "../include/errors.h"
+#include "../include/macros.h"
+
+/*****************************************************************************\
+|* Defines
+\*****************************************************************************/
+
+// Extra fraction bits a curve is split with, so halving doesn't lose much
+#define FLAT_SHIFT          8
+
+/*****************************************************************************\
+|* Statics
+\*****************************************************************************/
+
+/*****************************************************************************\
+|* A pixel co-ordinate as path units, at the centre of the pixel
+\*****************************************************************************/
+static inline int _unit(int v)
+    {
+    v = (v < -2047) ? -2047 : (v > 2046) ? 2046 : v;
+    return v * PATH_ONE + PATH_HALF;
+    }
+
+/*****************************************************************************\
+|* The first pixel whose centre is at or right of 'v', in path units
+\*****************************************************************************/
+static inline int _firstPixel(int v)
+    {
+    return (v - PATH_HALF + PATH_ONE - 1) >> PATH_SHIFT;
+    }
+
+#pragma mark - PathTracer
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+PathTracer::PathTracer(PathSpanFn fn, void *ctx, Run *runs, int max)
+        :_fn(fn)
+        ,_ctx(ctx)
+        ,_runs(runs)
+        ,_max(max)
+        ,_num(0)
+        ,_run({0, 0, 0})
+        ,_at({INT16_MIN, INT16_MIN})
+        ,_top(0)
+        ,_bottom(0)
+        ,_full(false)
+    {}
+
+/*****************************************************************************\
+|* Method : Draw a line, all its rows in one go if the runs fit, and if not
+|* in bands of half as many rows until they do. A band of one row sends
+|* what it has when it fills up, rather than go round for ever
+\*****************************************************************************/
+void PathTracer::stroke(int top, int bottom, PathDrawFn draw, void *ctx)
+    {
+    int rows = bottom - top;
+    for (int y=top; y<bottom; )
+        {
+        _num    = 0;
+        _run    = {0, 0, 0};
+        _at     = {INT16_MIN, INT16_MIN};
+        _top    = y;
+        _bottom = MIN(y + rows, bottom);
+        _full   = false;
+
+        draw(ctx, this);
+        _keep();
+
+        if (_full)
+            {
+            rows /= 2;
+            continue;
+            }
+
+        _merge();
+        _send();
+        y = _bottom;
+        }
+    }
+
+/*****************************************************************************\
+|* Method : Start a new line
+\*****************************************************************************/
+void PathTracer::moveTo(int x, int y)
+    {
+    _pixel(x >> PATH_SHIFT, y >> PATH_SHIFT);
+    }
+
+/*****************************************************************************\
+|* Method : Step from the last pixel to the one holding (x,y). The first
+|* pixel is the last one of the line before, so isn't looked at again
+\*****************************************************************************/
+void PathTracer::lineTo(int x, int y)
+    {
+    int x0  = _at.x;
+    int y0  = _at.y;
+    int x1  = x >> PATH_SHIFT;
+    int y1  = y >> PATH_SHIFT;
+    int dx  = ABS(x1 - x0);
+    int dy  = -ABS(y1 - y0);
+    int sx  = (x0 < x1) ? 1 : -1;
+    int sy  = (y0 < y1) ? 1 : -1;
+    int err = dx + dy;
+
+    while ((x0 != x1) || (y0 != y1))
+        {
+        int e2 = 2 * err;
+        if (e2 >= dy)
+            {
+            err += dy;
+            x0  += sx;
+            }
+        if (e2 <= dx)
+            {
+            err += dx;
+            y0  += sy;
+            }
+        _pixel(x0, y0);
+        }
+    }
+
+/*****************************************************************************\
+|* Private Method : Add a pixel in the rows being kept, growing the run if
+|* it's in the same row and touches it, or keeping the run and starting
+|* another if not
+\*****************************************************************************/
+void PathTracer::_pixel(int x, int y)
+    {
+    if ((x == _at.x) && (y == _at.y))
+        return;
+    _at = {x, y};
+
+    if ((y < _top) || (y >= _bottom) || _full)
+        return;
+
+    if ((_run.x1 > _run.x0) && (y == _run.y)
+        && (x >= _run.x0 - 1) && (x <= _run.x1))
+        {
+        _run.x0 = (int16_t)MIN(_run.x0, x);
+        _run.x1 = (int16_t)MAX(_run.x1, x + 1);
+        return;
+        }
+
+    _keep();
+    _run = {(int16_t)y, (int16_t)x, (int16_t)(x + 1)};
+    }
+
+/*****************************************************************************\
+|* Private Method : Put the run being built on the list, making room first
+|* if it's full. If there isn't any to be had, the band has to be drawn
+|* again in smaller pieces, unless it's only one row
+\*****************************************************************************/
+void PathTracer::_keep(void)
+    {
+    if ((_run.x1 <= _run.x0) || _full)
+        return;
+
+    if ((_num == _max) && (_merge() == _max))
+        {
+        if (_bottom - _top > 1)
+            {
+            _full = true;
+            return;
+            }
+        _send();
+        }
+
+    _runs[_num++]   = _run;
+    _run            = {0, 0, 0};
+    }
+
+/*****************************************************************************\
+|* Private Method : Insertion sort on row and first column, which is quick
+|* as a line tends to make its runs in order, then join each run onto the
+|* one before if they meet
+\*****************************************************************************/
+int PathTracer::_merge(void)
+    {
+    for (int i=1; i<_num; i++)
+        {
+        Run run = _runs[i];
+        int j   = i;
+        while ((j > 0) && ((_runs[j - 1].y > run.y)
+                           || ((_runs[j - 1].y == run.y)
+                               && (_runs[j - 1].x0 > run.x0))))
+            {
+            _runs[j] = _runs[j - 1];
+            j --;
+            }
+        _runs[j] = run;
+        }
+
+    int num = 0;
+    for (int i=0; i<_num; i++)
+        {
+        Run *last = (num > 0) ? &_runs[num - 1] : nullptr;
+        if ((last != nullptr) && (last->y == _runs[i].y)
+            && (_runs[i].x0 <= last->x1))
+            last->x1 = (int16_t)MAX(last->x1, _runs[i].x1);
+        else
+            _runs[num++] = _runs[i];
+        }
+
+    _num = num;
+    return num;
+    }
+
+/*****************************************************************************\
+|* Private Method : Send the runs, in the order they're in
+\*****************************************************************************/
+void PathTracer::_send(void)
+    {
+    for (int i=0; i<_num; i++)
+        _fn(_ctx, _runs[i].x0, _runs[i].y, _runs[i].x1 - _runs[i].x0);
+    _num = 0;
+    }
+
+#pragma mark - Path
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Path::Path(void)
+        :_tolerance(PATH_TOLERANCE)
+    {
+    clear();
+    }
+
+/*****************************************************************************\
+|* Method : Empty the path
+\*****************************************************************************/
+void Path::clear(void)
+    {
+    _numPts         = 0;
+    _numContours    = 0;
+    _min            = {INT16_MAX, INT16_MAX};
+    _max            = {INT16_MIN, INT16_MIN};
+    }
+
+/*****************************************************************************\
+|* Method : Start a new contour. One that only has its first point is
+|* reused rather than left lying around
+\*****************************************************************************/
+int Path::moveTo(Point p)
+    {
+    Contour *last = (_numContours > 0) ? &_contours[_numContours - 1]
+                                       : nullptr;
+
+    if ((last != nullptr) && (last->num <= 1))
+        {
+        _numPts     -= last->num;
+        last->num    = 0;
+        last->closed = false;
+        }
+    else if (_numContours >= PATH_MAX_CONTOURS)
+        return E_NO_RESOURCE;
+    else
+        _contours[_numContours++] = {(int16_t)_numPts, 0, false};
+
+    return _add(_unit(p.x), _unit(p.y));
+    }
+
+/*****************************************************************************\
+|* Method : Add a straight line
+\*****************************************************************************/
+int Path::lineTo(Point p)
+    {
+    int rc = _carryOn();
+    return (rc == E_OK) ? _add(_unit(p.x), _unit(p.y)) : rc;
+    }
+
+/*****************************************************************************\
+|* Method : Add a quadratic Bézier curve, with control point 'c'
+\*****************************************************************************/
+int Path::quadTo(Point c, Point p)
+    {
+    Point ctl[3] = {{0, 0}, {_unit(c.x), _unit(c.y)}, {_unit(p.x), _unit(p.y)}};
+    return _curveTo(ctl, 2);
+    }
+
+/*****************************************************************************\
+|* Method : Add a cubic Bézier curve, with control points 'c1' and 'c2'
+\*****************************************************************************/
+int Path::cubicTo(Point c1, Point c2, Point p)
+    {
+    Point ctl[4] = {{0, 0}, {_unit(c1.x), _unit(c1.y)},
+                    {_unit(c2.x), _unit(c2.y)}, {_unit(p.x), _unit(p.y)}};
+    return _curveTo(ctl, 3);
+    }
+
+/*****************************************************************************\
+|* Method : Join the contour back up to its start
+\*****************************************************************************/
+int Path::close(void)
+    {
+    if (_numContours == 0)
+        return E_INVALID;
+
+    _contours[_numContours - 1].closed = true;
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : The pixels the points of the path are in
+\*****************************************************************************/
+Rect Path::bounds(void) const
+    {
+    if (_numPts == 0)
+        return {0, 0, 0, 0};
+
+    int x0 = _min.x >> PATH_SHIFT;
+    int y0 = _min.y >> PATH_SHIFT;
+    return {x0, y0, (_max.x >> PATH_SHIFT) + 1 - x0,
+                    (_max.y >> PATH_SHIFT) + 1 - y0};
+    }
+
+/*****************************************************************************\
+|* Method : Trace along each contour, as one line so that where contours
+|* meet or cross isn't sent twice either
+\*****************************************************************************/
+void Path::trace(PathSpanFn fn, void *ctx)
+    {
+    if (_numPts == 0)
+        return;
+
+    PathTracer tracer(fn, ctx, _runs, PATH_TRACE_RUNS);
+    tracer.stroke(_min.y >> PATH_SHIFT, (_max.y >> PATH_SHIFT) + 1,
+                  [](void *ctx, PathTracer *tracer)
+        {
+        const Path *path = (const Path *)ctx;
+        for (int i=0; i<path->_numContours; i++)
+            {
+            const Contour &c    = path->_contours[i];
+            const Vertex *v     = path->_pts + c.first;
+            if (c.num == 0)
+                continue;
+
+            tracer->moveTo(v[0].x, v[0].y);
+            for (int j=1; j<c.num; j++)
+                tracer->lineTo(v[j].x, v[j].y);
+            if (c.closed && (c.num > 1))
+                tracer->lineTo(v[0].x, v[0].y);
+            }
+        }, this);
+    }
+
+/*****************************************************************************\
+|* Method : Scanline fill. Each edge that crosses a row's pixel centres
+|* (counting its top end but not its bottom) adds a crossing, kept in
+|* order as it's found, with its direction in the bottom bit. Walking them
+|* left to right with the winding count gives the spans
+\*****************************************************************************/
+void Path::scan(Rect clip, FillRule rule, PathSpanFn fn, void *ctx)
+    {
+    if (_numPts == 0)
+        return;
+
+    int top     = MAX(clip.y, _min.y >> PATH_SHIFT);
+    int bottom  = MIN(clip.y + clip.h, (_max.y >> PATH_SHIFT) + 1);
+    int left    = clip.x;
+    int right   = clip.x + clip.w;
+
+    for (int row=top; row<bottom; row++)
+        {
+        int ys  = row * PATH_ONE + PATH_HALF;
+        int n   = 0;
+
+        for (int i=0; i<_numContours; i++)
+            {
+            const Contour &c    = _contours[i];
+            const Vertex *v     = _pts + c.first;
+
+            for (int j=0; j<c.num; j++)
+                {
+                const Vertex &a = v[j];
+                const Vertex &b = v[(j + 1 < c.num) ? j + 1 : 0];
+                if ((a.y <= ys) == (b.y <= ys))
+                    continue;
+
+                int x       = a.x + (ys - a.y) * (b.x - a.x) / (b.y - a.y);
+                int32_t key = x * 2 + ((b.y > a.y) ? 1 : 0);
+
+                int at = n++;
+                for (; (at > 0) && (_cross[at - 1] > key); at--)
+                    _cross[at] = _cross[at - 1];
+                _cross[at] = key;
+                }
+            }
+
+        int winding = 0;
+        int start   = 0;
+        for (int i=0; i<n; i++)
+            {
+            bool was = (rule == FILL_EVENODD) ? (winding & 1) : (winding != 0);
+            winding += (_cross[i] & 1) ? 1 : -1;
+            bool now = (rule == FILL_EVENODD) ? (winding & 1) : (winding != 0);
+
+            int x = _cross[i] >> 1;
+            if (!was && now)
+                start = x;
+            else if (was && !now)
+                {
+                int x0 = MAX(_firstPixel(start), left);
+                int x1 = MIN(_firstPixel(x), right);
+                if (x1 > x0)
+                    fn(ctx, x0, row, x1 - x0);
+                }
+            }
+        }
+    }
+
+/*****************************************************************************\
+|* Method : Adaptive flattening. Pieces of the curve are kept on a stack,
+|* the first half on top; a piece whose control points are close enough to
+|* its chord is done, and the rest are split in two with de Casteljau.
+|*
+|* The second differences of the control points bound how far the curve
+|* can get from its chord: a quarter of the one for a quadratic, three
+|* quarters of the larger one for a cubic
+\*****************************************************************************/
+void Path::flatten(const Point *ctl, int order, int tolerance,
+                   PathPointFn fn, void *ctx)
+    {
+    struct Piece
+        {
+        int32_t x[4];
+        int32_t y[4];
+        int     depth;
+        };
+
+    Piece stack[PATH_MAX_DEPTH + 1];
+    int num     = 1;
+    int32_t lim = (int32_t)MAX(tolerance, 1) << (FLAT_SHIFT + 2);
+    int32_t rnd = 1 << (FLAT_SHIFT - 1);
+
+    for (int i=0; i<=order; i++)
+        {
+        stack[0].x[i] = ctl[i].x * (1 << FLAT_SHIFT);
+        stack[0].y[i] = ctl[i].y * (1 << FLAT_SHIFT);
+        }
+    stack[0].depth = 0;
+
+    while (num > 0)
+        {
+        Piece p = stack[--num];
+
+        int32_t dev = 0;
+        for (int i=0; i+2<=order; i++)
+            {
+            dev = MAX(dev, ABS(p.x[i] - 2 * p.x[i + 1] + p.x[i + 2]));
+            dev = MAX(dev, ABS(p.y[i] - 2 * p.y[i + 1] + p.y[i + 2]));
+            }
+        if (order == 3)
+            dev *= 3;
+
+        if ((dev <= lim) || (p.depth >= PATH_MAX_DEPTH))
+            {
+            fn(ctx, (p.x[order] + rnd) >> FLAT_SHIFT,
+                    (p.y[order] + rnd) >> FLAT_SHIFT);
+            continue;
+            }
+
+        Piece &second   = stack[num++];
+        Piece &first    = stack[num++];
+        for (int k=0; k<=order; k++)
+            {
+            first.x[k]          = p.x[0];
+            first.y[k]          = p.y[0];
+            second.x[order - k] = p.x[order - k];
+            second.y[order - k] = p.y[order - k];
+            for (int i=0; i<order-k; i++)
+                {
+                p.x[i] = (p.x[i] + p.x[i + 1]) >> 1;
+                p.y[i] = (p.y[i] + p.y[i + 1]) >> 1;
+                }
+            }
+        first.depth     = p.depth + 1;
+        second.depth    = p.depth + 1;
+        }
+    }
+
+#pragma mark - Private Methods
+
+/*****************************************************************************\
+|* Private Method : Add a point to the last contour, unless it's where the
+|* contour already is
+\*****************************************************************************/
+int Path::_add(int x, int y)
+    {
+    Contour &c = _contours[_numContours - 1];
+
+    if ((c.num > 0) && (_pts[_numPts - 1].x == x) && (_pts[_numPts - 1].y == y))
+        return E_OK;
+    if (_numPts >= PATH_MAX_POINTS)
+        return E_NO_RESOURCE;
+
+    _pts[_numPts++] = {(int16_t)x, (int16_t)y};
+    c.num ++;
+
+    _min = {(int16_t)MIN(_min.x, x), (int16_t)MIN(_min.y, y)};
+    _max = {(int16_t)MAX(_max.x, x), (int16_t)MAX(_max.y, y)};
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Private Method : Make sure there's a contour to add to. After close(), a
+|* new one starts where the closed one did
+\*****************************************************************************/
+int Path::_carryOn(void)
+    {
+    if (_numContours == 0)
+        return E_INVALID;
+
+    const Contour &c = _contours[_numContours - 1];
+    if (c.num == 0)
+        return E_NO_RESOURCE;
+    if (!c.closed)
+        return E_OK;
+
+    if (_numContours >= PATH_MAX_CONTOURS)
+        return E_NO_RESOURCE;
+
+    Vertex start = _pts[c.first];
+    _contours[_numContours++] = {(int16_t)_numPts, 0, false};
+    return _add(start.x, start.y);
+    }
+
+/*****************************************************************************\
+|* Private Method : Flatten a curve from the last point onto the path
+\*****************************************************************************/
+int Path::_curveTo(Point *ctl, int order)
+    {
+    struct Adder
+        {
+        Path *  path;
+        int     rc;
+        };
+
+    int rc = _carryOn();
+    if (rc != E_OK)
+        return rc;
+
+    ctl[0] = {_pts[_numPts - 1].x, _pts[_numPts - 1].y};
+
+    Adder add = {this, E_OK};
+    flatten(ctl, order, _tolerance, [](void *ctx, int x, int y)
+        {
+        Adder *a = (Adder *)ctx;
+        if (a->rc == E_OK)
+            a->rc = a->path->_add(x, y);
+        }, &add);
+
+    return add.rc;
+    }
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../include/properties.h"
+#include "../include/structures.h"
+
+/*****************************************************************************\
+|* Paths are held in fixed point, PATH_ONE units to the pixel, with a pixel's
+|* centre at PATH_HALF. That keeps co-ordinates to +/-2047 pixels
+\*****************************************************************************/
+#define PATH_SHIFT          4
+#define PATH_ONE            (1 << PATH_SHIFT)
+#define PATH_HALF           (PATH_ONE / 2)
+
+/*****************************************************************************\
+|* Capacity of a path: points once curves are flattened, and the separate
+|* pieces (contours) they're in
+\*****************************************************************************/
+#define PATH_MAX_POINTS     256
+#define PATH_MAX_CONTOURS   16
+
+/*****************************************************************************\
+|* How far a flattened curve may stray from the true one, in path units
+|* (a quarter of a pixel), and how many times a curve may be split in two
+\*****************************************************************************/
+#define PATH_TOLERANCE      4
+#define PATH_MAX_DEPTH      10
+
+/*****************************************************************************\
+|* Runs a tracer holds at once. A line with more is drawn a band of rows
+|* at a time
+\*****************************************************************************/
+#ifndef PATH_TRACE_RUNS
+#  define PATH_TRACE_RUNS   128
+#endif
+
+/*****************************************************************************\
+|* Which parts of a path that crosses itself count as inside it
+\*****************************************************************************/
+enum FillRule
+    {
+    FILL_NONZERO                    = 0,
+    FILL_EVENODD
+    };
+
+/*****************************************************************************\
+|* Called with each run of 'w' pixels in row 'y' from 'x', and with each
+|* point of a flattened curve, in path units
+\*****************************************************************************/
+typedef void (*PathSpanFn)(void *ctx, int x, int y, int w);
+typedef void (*PathPointFn)(void *ctx, int x, int y);
+
+/*****************************************************************************\
+|* Called to draw a whole line through a tracer, with moveTo() and lineTo()
+\*****************************************************************************/
+class PathTracer;
+typedef void (*PathDrawFn)(void *ctx, PathTracer *tracer);
+
+/*****************************************************************************\
+|* Turns a polyline, in path units, into the pixels a one pixel wide line
+|* along it covers, as horizontal runs, each pixel once however often the
+|* line comes back to it: at the joins, where a contour closes, and where
+|* it crosses itself.
+|*
+|* Each segment is stepped with Bresenham, and the runs it makes are kept
+|* in a list the caller provides. At the end they're sorted by row, the
+|* ones that overlap or touch are joined up, and what's left is sent. If
+|* the list fills up, it's sorted and joined in place to make room. If
+|* that doesn't free anything, the line is drawn again for half the rows at
+|* a time, and so on, which only stops at a single row
+\*****************************************************************************/
+class PathTracer
+    {
+    public:
+        struct Run
+            {
+            int16_t y;                      // Row
+            int16_t x0;                     // First column
+            int16_t x1;                     // Column after the last
+            };
+
+    private:
+        PathSpanFn  _fn;                    // Where runs go
+        void *      _ctx;                   // Passed to _fn
+        Run *       _runs;                  // Runs not yet sent
+        int         _max;                   // Room in _runs
+        int         _num;                   // Runs in _runs
+        Run         _run;                   // Being built
+        Point       _at;                    // Last pixel, in pixels
+        int         _top;                   // Rows being kept
+        int         _bottom;
+        bool        _full;                  // Ran out of room
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor. 'runs' has room for 'max' of them
+        \*********************************************************************/
+        explicit PathTracer(PathSpanFn fn, void *ctx, Run *runs, int max);
+
+        /*********************************************************************\
+        |* Draw a line through rows [top, bottom): 'draw' is called to step
+        |* along it, as many times as it takes
+        \*********************************************************************/
+        void stroke(int top, int bottom, PathDrawFn draw, void *ctx);
+
+        /*********************************************************************\
+        |* Start a new line at a point (which is drawn), or carry it on to
+        |* another. Only for 'draw' to call
+        \*********************************************************************/
+        void moveTo(int x, int y);
+        void lineTo(int x, int y);
+
+    private:
+        /*********************************************************************\
+        |* Add a pixel to the run being built, and keep a run that's done
+        \*********************************************************************/
+        void _pixel(int x, int y);
+        void _keep(void);
+
+        /*********************************************************************\
+        |* Sort the runs and join the ones that meet. Returns how many are
+        |* left
+        \*********************************************************************/
+        int _merge(void);
+
+        /*********************************************************************\
+        |* Send the runs, and empty the list
+        \*********************************************************************/
+        void _send(void);
+    };
+
+/*****************************************************************************\
+|* A shape made of straight lines and quadratic and cubic Bézier curves, in
+|* one or more contours. Curves are flattened to lines as they're added, by
+|* splitting them in half until the control points are within the
+|* tolerance of the chord, so a curve gets as many lines as it needs and
+|* no more.
+|*
+|* A path can be traced, as one pixel wide lines through the points, or
+|* filled by scanline: each row's crossings are found at the pixel
+|* centres, sorted, and the pixels between them sent as spans, so a pixel
+|* goes out once however the path crosses itself. Filling treats every
+|* contour as closed; tracing only joins up the ones that close() was
+|* called for
+\*****************************************************************************/
+class Path
+    {
+    public:
+        struct Vertex
+            {
+            int16_t x;                      // Path units
+            int16_t y;
+            };
+
+        struct Contour
+            {
+            int16_t first;                  // Index of its first point
+            int16_t num;                    // Number of points
+            bool    closed;                 // close() was called
+            };
+
+    /*************************************************************************\
+    |* Properties
+    \*************************************************************************/
+    GETSET(int, tolerance, Tolerance);      // Flattening error, path units
+
+    private:
+        Vertex      _pts[PATH_MAX_POINTS];          // Points, by contour
+        int         _numPts;                        // Points in use
+        Contour     _contours[PATH_MAX_CONTOURS];   // The contours
+        int         _numContours;                   // Contours in use
+        Vertex      _min;                           // Bounding box
+        Vertex      _max;
+        int32_t     _cross[PATH_MAX_POINTS];        // A row's crossings
+        PathTracer::Run _runs[PATH_TRACE_RUNS];     // For trace()
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit Path(void);
+
+        /*********************************************************************\
+        |* Empty the path
+        \*********************************************************************/
+        void clear(void);
+
+        /*********************************************************************\
+        |* Build the path, in pixels. moveTo() starts a new contour, and the
+        |* others carry on from the last point (or, after close(), from the
+        |* start of the contour that was closed). These return E_INVALID
+        |* without a moveTo() first, and E_NO_RESOURCE when the path is full,
+        |* in which case the points that fitted are kept
+        \*********************************************************************/
+        int moveTo(Point p);
+        int lineTo(Point p);
+        int quadTo(Point c, Point p);
+        int cubicTo(Point c1, Point c2, Point p);
+        int close(void);
+
+        /*********************************************************************\
+        |* Queries
+        \*********************************************************************/
+        bool empty(void) const              { return _numPts == 0; }
+        int points(void) const              { return _numPts; }
+        int contours(void) const            { return _numContours; }
+        Rect bounds(void) const;
+
+        /*********************************************************************\
+        |* Send the pixels along the path, as runs, each pixel once
+        \*********************************************************************/
+        void trace(PathSpanFn fn, void *ctx);
+
+        /*********************************************************************\
+        |* Send the spans inside the path, within 'clip', row by row
+        \*********************************************************************/
+        void scan(Rect clip, FillRule rule, PathSpanFn fn, void *ctx);
+
+        /*********************************************************************\
+        |* Flatten a quadratic (order 2) or cubic (order 3) curve through
+        |* 'ctl', in path units, to within 'tolerance'. 'fn' gets every
+        |* point but the first
+        \*********************************************************************/
+        static void flatten(const Point *ctl, int order, int tolerance,
+                            PathPointFn fn, void *ctx);
+
+    private:
+        /*********************************************************************\
+        |* Add a point, in path units, to the last contour, and start a new
+        |* contour if that one's been closed
+        \*********************************************************************/
+        int _add(int x, int y);
+        int _carryOn(void);
+
+        /*********************************************************************\
+        |* Flatten a curve from the last point onto the path
+        \*********************************************************************/
+        int _curveTo(Point *ctl, int order);
+    };
@@ -0,0 +1,195 @@
+#include <string.h>
+
+#include "qoi.h"
+#include "../include/errors.h"
+
+/*****************************************************************************\
+|* Defines
+\*****************************************************************************/
+
+#define QOI_HEADER_SIZE     14
+#define QOI_END_SIZE        8
+#define QOI_MAX_DIMENSION   8192
+
+#define QOI_HASH(p)         (((p).r*3 + (p).g*5 + (p).b*7 + (p).a*11) & 63)
+
+/*****************************************************************************\
+|* Enums
+\*****************************************************************************/
+
+enum
+    {
+    QOI_OP_INDEX                        = 0x00,
+    QOI_OP_DIFF                         = 0x40,
+    QOI_OP_LUMA                         = 0x80,
+    QOI_OP_RUN                          = 0xC0,
+    QOI_OP_RGB                          = 0xFE,
+    QOI_OP_RGBA                         = 0xFF,
+    QOI_MASK_2                          = 0xC0,
+    };
+
+/*****************************************************************************\
+|* Statics
+\*****************************************************************************/
+
+static inline uint32_t _read32(const uint8_t *p)
+    {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) 
+         | ((uint32_t)p[2] << 8)  |  (uint32_t)p[3];
+    }
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+QoiSource::QoiSource(void)
+        :_data(nullptr)
+        ,_pos(nullptr)
+        ,_end(nullptr)
+        ,_w(0)
+        ,_h(0)
+        ,_line(0)
+        ,_run(0)
+    {}
+
+/*****************************************************************************\
+|* Method : Check the header and get ready to decode
+\*****************************************************************************/
+int QoiSource::open(const uint8_t *data, int len)
+    {
+    _data = nullptr;
+    _w    = 0;
+    _h    = 0;
+
+    if ((data == nullptr) || (len < QOI_HEADER_SIZE + QOI_END_SIZE))
+        return E_INVALID;
+
+    if (memcmp(data, "qoif", 4) != 0)
+        {
+        printf(T_ERR "Not a QOI image\n");
+        return E_INVALID;
+        }
+
+    uint32_t w = _read32(data + 4);
+    uint32_t h = _read32(data + 8);
+    if ((w == 0) || (h == 0) || (w > QOI_MAX_DIMENSION) || (h > QOI_MAX_DIMENSION))
+        {
+        printf(T_ERR "Unsupported QOI size %ux%u\n", (unsigned)w, (unsigned)h);
+        return E_INVALID;
+        }
+
+    _data   = data;
+    _end    = data + len - QOI_END_SIZE;
+    _w      = (int) w;
+    _h      = (int) h;
+    rewind();
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Restart from the first pixel
+\*****************************************************************************/
+void QoiSource::rewind(void)
+    {
+    _pos    = (_data != nullptr) ? _data + QOI_HEADER_SIZE : nullptr;
+    _line   = 0;
+    _run    = 0;
+    _px     = {0, 0, 0, 255};
+    memset(_index, 0, sizeof(_index));
+    }
+
+/*****************************************************************************\
+|* Method : Decode the next few lines straight into wire format. A truncated
+|* file just repeats the last pixel rather than reading past the end
+\*****************************************************************************/
+int QoiSource::readLines(uint8_t *buf, int n)
+    {
+    if (_data == nullptr)
+        return E_INVALID;
+
+    if (n > _h - _line)
+        n = _h - _line;
+
+    const uint8_t *pos  = _pos;
+    const uint8_t *end  = _end;
+    Pixel px            = _px;
+    int run             = _run;
+    int num             = n * _w;
+
+    for (int i=0; i<num; i++)
+        {
+        if (run > 0)
+            run --;
+        else if (pos < end)
+            {
+            uint8_t b1 = *pos++;
+
+            if (b1 == QOI_OP_RGB)
+                {
+                if (pos + 3 > end)
+                    pos = end;
+                else
+                    {
+                    px.r = pos[0];
+                    px.g = pos[1];
+                    px.b = pos[2];
+                    pos += 3;
+                    }
+                }
+            else if (b1 == QOI_OP_RGBA)
+                {
+                if (pos + 4 > end)
+                    pos = end;
+                else
+                    {
+                    px.r = pos[0];
+                    px.g = pos[1];
+                    px.b = pos[2];
+                    px.a = pos[3];
+                    pos += 4;
+                    }
+                }
+            else switch (b1 & QOI_MASK_2)
+                {
+                case QOI_OP_INDEX:
+                    px = _index[b1];
+                    break;
+
+                case QOI_OP_DIFF:
+                    px.r += ((b1 >> 4) & 0x03) - 2;
+                    px.g += ((b1 >> 2) & 0x03) - 2;
+                    px.b += ( b1       & 0x03) - 2;
+                    break;
+
+                case QOI_OP_LUMA:
+                    {
+                    uint8_t b2  = (pos < end) ? *pos++ : 0x88;
+                    int vg      = (b1 & 0x3F) - 32;
+                    px.r += vg - 8 + ((b2 >> 4) & 0x0F);
+                    px.g += vg;
+                    px.b += vg - 8 +  (b2       & 0x0F);
+                    break;
+                    }
+
+                case QOI_OP_RUN:
+                    run = (b1 & 0x3F);
+                    break;
+                }
+
+            _index[QOI_HASH(px)] = px;
+            }
+
+        /*********************************************************************\
+        |* RGB888 to wire RGB666: just drop the bottom two bits
+        \*********************************************************************/
+        *buf ++ = px.r & 0xFC;
+        *buf ++ = px.g & 0xFC;
+        *buf ++ = px.b & 0xFC;
+        }
+
+    _pos    = pos;
+    _px     = px;
+    _run    = run;
+    _line  += n;
+    return n;
+    }
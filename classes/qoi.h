@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "imagesource.h"
+
+/*****************************************************************************\
+|* Streaming QOI ("Quite OK Image") decoder. It reads straight from memory or
+|* XIP flash and writes wire-format lines, so Ili9481::drawImage() can push a
+|* compressed image with no framebuffer. The working set is the 64-entry
+|* colour index and the previous pixel - there's no heap use at all.
+|*
+|* Alpha is decoded (the index hash needs it) but otherwise ignored
+\*****************************************************************************/
+class QoiSource : public ImageSource
+    {
+    private:
+        struct Pixel
+            {
+            uint8_t r;
+            uint8_t g;
+            uint8_t b;
+            uint8_t a;
+            };
+
+        const uint8_t *     _data;          // Start of the QOI file
+        const uint8_t *     _pos;           // Next byte to decode
+        const uint8_t *     _end;           // Start of the end-marker
+        int                 _w;             // Width in pixels
+        int                 _h;             // Height in pixels
+        int                 _line;          // Next line to decode
+        int                 _run;           // Repeats left of 'px'
+        Pixel               _px;            // Previous pixel
+        Pixel               _index[64];     // Recently-seen pixels
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit QoiSource(void);
+
+        /*********************************************************************\
+        |* Check the header, and get ready to decode from the first line
+        \*********************************************************************/
+        int open(const uint8_t *data, int len);
+
+        /*********************************************************************\
+        |* Go back to the first line
+        \*********************************************************************/
+        void rewind(void);
+
+        /*********************************************************************\
+        |* ImageSource
+        \*********************************************************************/
+        int width(void)     { return _w; }
+        int height(void)    { return _h; }
+        int readLines(uint8_t *buf, int n);
+    };
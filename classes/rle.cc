@@ -0,0 +1,182 @@
+#include <string.h>
+
+#include "rle.h"
+#include "../include/errors.h"
+
+/*****************************************************************************\
+|* Statics
+\*****************************************************************************/
+
+static inline int _read16(const uint8_t *p)
+    {
+    return p[0] | (p[1] << 8);
+    }
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+RleSource::RleSource(void)
+        :_data(nullptr)
+        ,_ops(nullptr)
+        ,_pos(nullptr)
+        ,_end(nullptr)
+        ,_palette(nullptr)
+        ,_colours(0)
+        ,_w(0)
+        ,_h(0)
+        ,_left(0)
+        ,_line(0)
+        ,_span({false, 0, nullptr})
+    {}
+
+/*****************************************************************************\
+|* Method : Check the header and get ready to decode
+\*****************************************************************************/
+int RleSource::open(const uint8_t *data, int len)
+    {
+    _data       = nullptr;
+    _palette    = nullptr;
+    _colours    = 0;
+    _w          = 0;
+    _h          = 0;
+
+    if ((data == nullptr) || (len < RLE_HEADER_SIZE))
+        return E_INVALID;
+
+    if (memcmp(data, RLE_MAGIC, 4) != 0)
+        {
+        printf(T_ERR "Not an RLE asset\n");
+        return E_INVALID;
+        }
+
+    int w       = _read16(data + 4);
+    int h       = _read16(data + 6);
+    int colours = _read16(data + 8);
+    if ((w == 0) || (h == 0) || (colours > RLE_MAX_PALETTE)
+        || (len < RLE_HEADER_SIZE + colours * 3))
+        {
+        printf(T_ERR "Bad RLE asset header\n");
+        return E_INVALID;
+        }
+
+    _data       = data;
+    _end        = data + len;
+    _palette    = (colours > 0) ? data + RLE_HEADER_SIZE : nullptr;
+    _colours    = colours;
+    _ops        = data + RLE_HEADER_SIZE + colours * 3;
+    _w          = w;
+    _h          = h;
+    rewind();
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Restart from the first pixel
+\*****************************************************************************/
+void RleSource::rewind(void)
+    {
+    _pos        = _ops;
+    _left       = _w * _h;
+    _line       = 0;
+    _span       = {false, 0, nullptr};
+    }
+
+/*****************************************************************************\
+|* Method : Look up a palette entry. Out-of-range indices get entry 0
+\*****************************************************************************/
+const uint8_t * RleSource::colour(int index)
+    {
+    return _palette + ((index < _colours) ? index : 0) * 3;
+    }
+
+/*****************************************************************************\
+|* Method : Decode the next op. Spans are clipped to the pixels the image
+|* has left, so a bad asset can't overrun the window it's drawn into
+\*****************************************************************************/
+int RleSource::nextSpan(Span *span)
+    {
+    if ((_data == nullptr) || (_left <= 0))
+        return 0;
+    if (_pos >= _end)
+        return E_INVALID;
+
+    int bpp = paletted() ? 1 : 3;
+    int tag = *_pos ++;
+
+    if (tag < RLE_OP_RUN)
+        {
+        span->run   = false;
+        span->count = tag + 1;
+        span->data  = _pos;
+        _pos       += span->count * bpp;
+        }
+    else
+        {
+        span->run   = true;
+        span->count = tag - RLE_OP_RUN + RLE_MIN_RUN;
+        if (tag == RLE_OP_LONG_RUN)
+            {
+            span->count = (_pos + 2 <= _end) ? _read16(_pos) : 0;
+            _pos       += 2;
+            }
+        span->data  = paletted() ? ((_pos < _end) ? colour(*_pos) : nullptr)
+                                 : _pos;
+        _pos       += bpp;
+        }
+
+    if ((_pos > _end) || (span->count == 0))
+        {
+        _pos = _end;
+        return E_INVALID;
+        }
+
+    if (span->count > _left)
+        span->count = _left;
+    _left -= span->count;
+    return 1;
+    }
+
+/*****************************************************************************\
+|* Method : Expand the next few lines into wire format. A truncated asset
+|* is padded with black rather than reading past the end
+\*****************************************************************************/
+int RleSource::readLines(uint8_t *buf, int n)
+    {
+    if (_data == nullptr)
+        return E_INVALID;
+
+    if (n > _h - _line)
+        n = _h - _line;
+
+    int num = n * _w;
+    while (num > 0)
+        {
+        if ((_span.count == 0) && (nextSpan(&_span) <= 0))
+            {
+            memset(buf, 0, num * 3);
+            _left = 0;
+            break;
+            }
+
+        int k = (_span.count < num) ? _span.count : num;
+        if (_span.run)
+            for (int i=0; i<k; i++, buf += 3)
+                memcpy(buf, _span.data, 3);
+        else if (paletted())
+            for (int i=0; i<k; i++, buf += 3)
+                memcpy(buf, colour(*_span.data ++), 3);
+        else
+            {
+            memcpy(buf, _span.data, k * 3);
+            _span.data += k * 3;
+            buf        += k * 3;
+            }
+
+        _span.count -= k;
+        num         -= k;
+        }
+
+    _line += n;
+    return n;
+    }
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "imagesource.h"
+#include "rleformat.h"
+
+/*****************************************************************************\
+|* An RLE asset (see rleformat.h) read in place from memory or XIP flash.
+|*
+|* Ili9481::drawRle() walks it a span at a time, so that literals go out
+|* straight from flash and long runs go through the solid-fill path. It's
+|* also an ImageSource, so drawImage() can handle the clipped case
+\*****************************************************************************/
+class RleSource : public ImageSource
+    {
+    public:
+        /*********************************************************************\
+        |* A run of one colour, or a literal span of pixels
+        \*********************************************************************/
+        struct Span
+            {
+            bool run;               // A run of one colour, or a literal
+            int count;              // Number of pixels
+            const uint8_t *data;    // Run: 3 wire bytes. Literal: wire
+                                    // pixels, or palette indices
+            };
+
+    private:
+        const uint8_t *     _data;          // Start of the asset
+        const uint8_t *     _ops;           // First op
+        const uint8_t *     _pos;           // Next op
+        const uint8_t *     _end;           // End of the asset
+        const uint8_t *     _palette;       // Palette, or nullptr
+        int                 _colours;       // Entries in the palette
+        int                 _w;             // Width in pixels
+        int                 _h;             // Height in pixels
+        int                 _left;          // Pixels not yet returned
+        int                 _line;          // Next line for readLines()
+        Span                _span;          // Rest of a part-read span
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit RleSource(void);
+
+        /*********************************************************************\
+        |* Check the header, and get ready to decode from the first pixel
+        \*********************************************************************/
+        int open(const uint8_t *data, int len);
+
+        /*********************************************************************\
+        |* Go back to the first pixel
+        \*********************************************************************/
+        void rewind(void);
+
+        /*********************************************************************\
+        |* Palette access, for expanding indexed literals
+        \*********************************************************************/
+        bool paletted(void)                 { return _palette != nullptr; }
+        const uint8_t * colour(int index);
+
+        /*********************************************************************\
+        |* Get the next span. Returns 1 for a span, 0 at the end, or <0 if
+        |* the data is bad
+        \*********************************************************************/
+        int nextSpan(Span *span);
+
+        /*********************************************************************\
+        |* ImageSource
+        \*********************************************************************/
+        int width(void)     { return _w; }
+        int height(void)    { return _h; }
+        int readLines(uint8_t *buf, int n);
+    };
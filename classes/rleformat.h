@@ -0,0 +1,37 @@
+#pragma once
+
+/*****************************************************************************\
+|* Layout of an RLE asset, shared by RleSource and the host-side converter
+|* in tools/rleconv. All multi-byte fields are little-endian.
+|*
+|*   0   'R' 'L' 'E' '6'
+|*   4   width                      u16
+|*   6   height                     u16
+|*   8   palette entries, 0 = none  u16
+|*  10   reserved, 0                u16
+|*  12   palette, 3 wire bytes per entry
+|*  ..   ops, covering width x height pixels in raster order. Runs and
+|*       literals carry on from one row to the next
+|*
+|* Each op starts with a tag byte:
+|*
+|*  0x00-0x7F   literal of (tag+1) pixels: 3 wire bytes each, or 1 palette
+|*              index each if there is a palette
+|*  0x80-0xFE   run of (tag-0x80+2) pixels, then one pixel
+|*  0xFF        long run: a u16 count, then one pixel
+|*
+|* Pixels are in the wire format the display takes - RGB666 in the top 6
+|* bits of each byte - so literals can go straight from flash to the SPI
+\*****************************************************************************/
+
+#define RLE_MAGIC               "RLE6"
+#define RLE_HEADER_SIZE         12
+#define RLE_MAX_PALETTE         256
+
+#define RLE_OP_RUN              0x80
+#define RLE_OP_LONG_RUN         0xFF
+
+#define RLE_MAX_LITERAL         128
+#define RLE_MIN_RUN             2
+#define RLE_MAX_SHORT_RUN       (RLE_OP_LONG_RUN - RLE_OP_RUN + RLE_MIN_RUN - 1)
+#define RLE_MAX_LONG_RUN        65535
@@ -0,0 +1,446 @@
+#include "scene.h"
+#include "../include/macros.h"
+
+/*****************************************************************************\
+|* Statics
+\*****************************************************************************/
+
+/*****************************************************************************\
+|* Overlap of two rectangles, false if there isn't any
+\*****************************************************************************/
+static inline bool _intersect(const Rect &a, const Rect &b, Rect *out)
+    {
+    int x0 = MAX(a.x, b.x);
+    int y0 = MAX(a.y, b.y);
+    int x1 = MIN(a.x + a.w, b.x + b.w);
+    int y1 = MIN(a.y + a.h, b.y + b.h);
+    if ((x1 <= x0) || (y1 <= y0))
+        return false;
+
+    *out = {x0, y0, x1 - x0, y1 - y0};
+    return true;
+    }
+
+#pragma mark - Widget
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Widget::Widget(Rect bounds, bool opaque, int z)
+        :_bounds(bounds)
+        ,_z(z)
+        ,_opaque(opaque)
+        ,_visible(true)
+        ,_dirty(true)
+        ,_scene(nullptr)
+    {}
+
+/*****************************************************************************\
+|* Destructor
+\*****************************************************************************/
+Widget::~Widget(void)
+    {
+    if (_scene != nullptr)
+        _scene->remove(this);
+    }
+
+/*****************************************************************************\
+|* Method : Mark the widget for redrawing
+\*****************************************************************************/
+void Widget::invalidate(void)
+    {
+    _dirty = true;
+    }
+
+/*****************************************************************************\
+|* Method : Mark just part of the widget for redrawing
+\*****************************************************************************/
+void Widget::invalidate(Rect part)
+    {
+    Rect r;
+    if ((_scene != nullptr) && _visible && _intersect(part, _bounds, &r))
+        _scene->invalidate(r);
+    }
+
+/*****************************************************************************\
+|* Method : Move or resize
+\*****************************************************************************/
+void Widget::setBounds(Rect bounds)
+    {
+    if ((_scene != nullptr) && _visible)
+        _scene->invalidate(_bounds);
+
+    _bounds = bounds;
+    _dirty  = true;
+    }
+
+/*****************************************************************************\
+|* Method : Change the stacking order
+\*****************************************************************************/
+void Widget::setZ(int z)
+    {
+    _z      = z;
+    _dirty  = true;
+    if (_scene != nullptr)
+        _scene->_sort();
+    }
+
+/*****************************************************************************\
+|* Method : Show or hide
+\*****************************************************************************/
+void Widget::setVisible(bool visible)
+    {
+    if (visible == _visible)
+        return;
+
+    if ((_scene != nullptr) && _visible)
+        _scene->invalidate(_bounds);
+
+    _visible    = visible;
+    _dirty      = true;
+    }
+
+/*****************************************************************************\
+|* Method : Change whether the widget hides what's behind it
+\*****************************************************************************/
+void Widget::setOpaque(bool opaque)
+    {
+    _opaque = opaque;
+    _dirty  = true;
+    }
+
+#pragma mark - Scene
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Scene::Scene(Ili9481 *dpy, RGB background)
+        :_background(background)
+        ,_dpy(dpy)
+        ,_num(0)
+        ,_numDamage(0)
+    {}
+
+/*****************************************************************************\
+|* Destructor
+\*****************************************************************************/
+Scene::~Scene(void)
+    {
+    for (int i=0; i<_num; i++)
+        _widgets[i]->_scene = nullptr;
+    }
+
+/*****************************************************************************\
+|* Method : Add a widget, in z order. Among equals, later ones go in front
+\*****************************************************************************/
+int Scene::add(Widget *widget)
+    {
+    if ((widget == nullptr) || (widget->_scene != nullptr))
+        return E_INVALID;
+    if (_num >= SCENE_MAX_WIDGETS)
+        return E_NO_RESOURCE;
+
+    _widgets[_num++]    = widget;
+    widget->_scene      = this;
+    widget->_dirty      = true;
+    _sort();
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Remove a widget, damaging where it was
+\*****************************************************************************/
+int Scene::remove(Widget *widget)
+    {
+    for (int i=0; i<_num; i++)
+        if (_widgets[i] == widget)
+            {
+            if (widget->_visible)
+                invalidate(widget->_bounds);
+
+            for (int j=i+1; j<_num; j++)
+                _widgets[j - 1] = _widgets[j];
+            _num --;
+
+            widget->_scene = nullptr;
+            return E_OK;
+            }
+
+    return E_INVALID;
+    }
+
+/*****************************************************************************\
+|* Method : Record a damaged region. It's merged with another one whenever
+|* their bounding box has no more pixels than the two; if the list is full,
+|* it goes in with whichever one grows least
+\*****************************************************************************/
+void Scene::invalidate(Rect r)
+    {
+    if (!_intersect(r, _dpy->bounds(), &r))
+        return;
+
+    for (int i=0; i<_numDamage; i++)
+        {
+        Rect u = rectUnion(_damage[i], r);
+        if (rectArea(u) <= rectArea(_damage[i]) + rectArea(r))
+            {
+            /*****************************************************************\
+            |* The merged region may now swallow others, so take it out and
+            |* put it back in again
+            \*****************************************************************/
+            _damage[i] = _damage[--_numDamage];
+            invalidate(u);
+            return;
+            }
+        }
+
+    if (_numDamage < SCENE_MAX_DAMAGE)
+        {
+        _damage[_numDamage++] = r;
+        return;
+        }
+
+    int best        = 0;
+    int bestGrowth  = INT32_MAX;
+    for (int i=0; i<_numDamage; i++)
+        {
+        int growth = rectArea(rectUnion(_damage[i], r)) - rectArea(_damage[i]);
+        if (growth < bestGrowth)
+            {
+            best        = i;
+            bestGrowth  = growth;
+            }
+        }
+
+    Rect u          = rectUnion(_damage[best], r);
+    _damage[best]   = _damage[--_numDamage];
+    invalidate(u);
+    }
+
+/*****************************************************************************\
+|* Method : Damage everything
+\*****************************************************************************/
+void Scene::invalidate(void)
+    {
+    _numDamage = 0;
+    invalidate(_dpy->bounds());
+    }
+
+/*****************************************************************************\
+|* Method : Change the background colour
+\*****************************************************************************/
+void Scene::setBackground(RGB background)
+    {
+    _background = background;
+    invalidate();
+    }
+
+/*****************************************************************************\
+|* Method : Redraw the damage, then put the clip back
+\*****************************************************************************/
+int Scene::render(void)
+    {
+    for (int i=0; i<_num; i++)
+        {
+        Widget *w = _widgets[i];
+        if (w->_dirty && w->_visible)
+            invalidate(w->_bounds);
+        w->_dirty = false;
+        }
+
+    if (_numDamage == 0)
+        return E_OK;
+
+    _saved = _dpy->clipRegion();
+    for (int i=0; i<_numDamage; i++)
+        _renderRegion(_damage[i]);
+    _dpy->setClipRegion(_saved);
+
+    _numDamage = 0;
+    return E_OK;
+    }
+
+#pragma mark - Private Methods
+
+/*****************************************************************************\
+|* Private Method : Insertion sort on z, which keeps equal widgets in the
+|* order they were added
+\*****************************************************************************/
+void Scene::_sort(void)
+    {
+    for (int i=1; i<_num; i++)
+        {
+        Widget *w   = _widgets[i];
+        int j       = i - 1;
+        while ((j >= 0) && (_widgets[j]->_z > w->_z))
+            {
+            _widgets[j + 1] = _widgets[j];
+            j --;
+            }
+        _widgets[j + 1] = w;
+        }
+    }
+
+/*****************************************************************************\
+|* Private Method : Redraw one region: the background where no opaque
+|* widget covers it, then each widget where nothing opaque is in front
+\*****************************************************************************/
+void Scene::_renderRegion(Rect r)
+    {
+    Rect pieces[SCENE_MAX_PIECES];
+
+    pieces[0]   = r;
+    int num     = _trim(pieces, 1, 0);
+    _drawPieces(nullptr, pieces, num);
+
+    for (int i=0; i<_num; i++)
+        {
+        Widget *w = _widgets[i];
+        if (!w->_visible || !_intersect(w->_bounds, r, &pieces[0]))
+            continue;
+
+        num = _trim(pieces, 1, i + 1);
+        _drawPieces(w, pieces, num);
+        }
+    }
+
+/*****************************************************************************\
+|* Private Method : Cut each opaque widget out of the pieces, leaving the
+|* bands above and below it and the parts either side. A piece that would
+|* split past the limit is just left whole, which only draws a bit more
+\*****************************************************************************/
+int Scene::_trim(Rect *pieces, int num, int first)
+    {
+    for (int k=first; (k<_num) && (num>0); k++)
+        {
+        Widget *w = _widgets[k];
+        if (!w->_visible || !w->_opaque)
+            continue;
+
+        for (int i=0; i<num; )
+            {
+            Rect p = pieces[i];
+            Rect c;
+            if (!_intersect(p, w->_bounds, &c))
+                {
+                i ++;
+                continue;
+                }
+
+            Rect parts[4];
+            int n = 0;
+            if (c.y > p.y)
+                parts[n++] = {p.x, p.y, p.w, c.y - p.y};
+            if (c.y + c.h < p.y + p.h)
+                parts[n++] = {p.x, c.y + c.h, p.w, p.y + p.h - c.y - c.h};
+            if (c.x > p.x)
+                parts[n++] = {p.x, c.y, c.x - p.x, c.h};
+            if (c.x + c.w < p.x + p.w)
+                parts[n++] = {c.x + c.w, c.y, p.x + p.w - c.x - c.w, c.h};
+
+            if (num - 1 + n > SCENE_MAX_PIECES)
+                {
+                i ++;
+                continue;
+                }
+
+            /*****************************************************************\
+            |* Swap the last piece in for this one, and add the remainders
+            |* at the end, past 'i' so they are checked against this widget
+            |* again (harmlessly, since they can't overlap it)
+            \*****************************************************************/
+            pieces[i] = pieces[--num];
+            for (int j=0; j<n; j++)
+                pieces[num++] = parts[j];
+            }
+        }
+
+    return num;
+    }
+
+/*****************************************************************************\
+|* Private Method : Draw a widget (or the background, if it's null) clipped
+|* to each piece in turn
+\*****************************************************************************/
+void Scene::_drawPieces(Widget *widget, const Rect *pieces, int num)
+    {
+    for (int i=0; i<num; i++)
+        {
+        _dpy->setClip(pieces[i]);
+        if (widget == nullptr)
+            _dpy->box(pieces[i], _background, true);
+        else
+            widget->draw(_dpy);
+        }
+    }
+
+#pragma mark - Panel
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Panel::Panel(Rect bounds, RGB colour, int z)
+        :Widget(bounds, true, z)
+        ,_colour(colour)
+    {}
+
+/*****************************************************************************\
+|* Method : Change colour
+\*****************************************************************************/
+void Panel::setColour(RGB colour)
+    {
+    _colour = colour;
+    invalidate();
+    }
+
+/*****************************************************************************\
+|* Method : Draw
+\*****************************************************************************/
+void Panel::draw(Ili9481 *dpy)
+    {
+    dpy->box(bounds(), _colour, true);
+    }
+
+#pragma mark - Bar
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Bar::Bar(Rect bounds, int range, RGB colour, RGB empty, int z)
+        :Widget(bounds, true, z)
+        ,_value(0)
+        ,_range((range > 0) ? range : 1)
+        ,_colour(colour)
+        ,_empty(empty)
+    {}
+
+/*****************************************************************************\
+|* Method : Set the value. Only the columns between the old and new ends of
+|* the filled part are damaged
+\*****************************************************************************/
+void Bar::setValue(int value)
+    {
+    value   = MAX(0, MIN(value, _range));
+    Rect b  = bounds();
+    int was = b.w * _value / _range;
+    int now = b.w * value / _range;
+
+    _value = value;
+    if (was != now)
+        invalidate({b.x + MIN(was, now), b.y, ABS(now - was), b.h});
+    }
+
+/*****************************************************************************\
+|* Method : Draw
+\*****************************************************************************/
+void Bar::draw(Ili9481 *dpy)
+    {
+    Rect b      = bounds();
+    int filled  = b.w * _value / _range;
+
+    if (filled > 0)
+        dpy->box({b.x, b.y, filled, b.h}, _colour, true);
+    if (filled < b.w)
+        dpy->box({b.x + filled, b.y, b.w - filled, b.h}, _empty, true);
+    }
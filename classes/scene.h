@@ -0,0 +1,182 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Ili9481.h"
+
+/*****************************************************************************\
+|* Limits for a scene: widgets, damaged regions waiting for render(), and
+|* the pieces a region may be cut into when trimming it
+\*****************************************************************************/
+#define SCENE_MAX_WIDGETS   32
+#define SCENE_MAX_DAMAGE    16
+#define SCENE_MAX_PIECES    16
+
+class Scene;
+
+/*****************************************************************************\
+|* Something on the screen that can redraw itself. draw() is called with the
+|* display's clip already set to the part that needs it, so it can simply
+|* draw all of its bounds. An opaque widget covers every pixel of its
+|* bounds, which lets the scene skip whatever is underneath
+\*****************************************************************************/
+class Widget
+    {
+    NON_COPYABLE_NOR_MOVEABLE(Widget)
+
+    friend class Scene;
+
+    /*************************************************************************\
+    |* Properties
+    \*************************************************************************/
+    GET(Rect, bounds);                      // Where it is on the screen
+    GET(int, z);                            // Higher is nearer the front
+    GET(bool, opaque);                      // Covers all of its bounds
+    GET(bool, visible);                     // Drawn at all
+    GET(bool, dirty);                       // Needs redrawing
+
+    private:
+        Scene *     _scene;                 // Scene it's in, or nullptr
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit Widget(Rect bounds, bool opaque=false, int z=0);
+        virtual ~Widget(void);
+
+        /*********************************************************************\
+        |* Redraw this widget on the next render()
+        \*********************************************************************/
+        void invalidate(void);
+
+        /*********************************************************************\
+        |* Changing these damages where the widget was as well as where it is
+        \*********************************************************************/
+        void setBounds(Rect bounds);
+        void setZ(int z);
+        void setVisible(bool visible);
+        void setOpaque(bool opaque);
+
+        /*********************************************************************\
+        |* Draw the widget
+        \*********************************************************************/
+        virtual void draw(Ili9481 *dpy) = 0;
+
+    protected:
+        /*********************************************************************\
+        |* Redraw just part of the widget, for small changes
+        \*********************************************************************/
+        void invalidate(Rect part);
+    };
+
+/*****************************************************************************\
+|* A set of widgets drawn over a background colour.
+|*
+|* Changes are only recorded until render(), which merges the damage into
+|* a few regions, and for each one redraws the background and the widgets
+|* that touch it, back to front. Each is clipped to what isn't covered by
+|* an opaque widget in front of it, so hidden parts aren't sent at all. If
+|* nothing has changed, render() doesn't touch the bus
+\*****************************************************************************/
+class Scene
+    {
+    NON_COPYABLE_NOR_MOVEABLE(Scene)
+
+    friend class Widget;
+
+    /*************************************************************************\
+    |* Properties
+    \*************************************************************************/
+    GET(RGB, background);                   // Where no widget is opaque
+
+    private:
+        Ili9481 *   _dpy;                               // Where to draw
+        Widget *    _widgets[SCENE_MAX_WIDGETS];        // Back to front
+        int         _num;                               // Widgets in use
+        Rect        _damage[SCENE_MAX_DAMAGE];          // Regions to redraw
+        int         _numDamage;                         // Regions in use
+        ClipRegion  _saved;                             // Caller's clip
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit Scene(Ili9481 *dpy, RGB background=RGB(0,0,0));
+        ~Scene(void);
+
+        /*********************************************************************\
+        |* Add or remove a widget. The scene doesn't own it
+        \*********************************************************************/
+        int add(Widget *widget);
+        int remove(Widget *widget);
+
+        /*********************************************************************\
+        |* Redraw a region, or everything, on the next render()
+        \*********************************************************************/
+        void invalidate(Rect r);
+        void invalidate(void);
+
+        /*********************************************************************\
+        |* Change the background, which damages everything
+        \*********************************************************************/
+        void setBackground(RGB background);
+
+        /*********************************************************************\
+        |* Redraw whatever has been damaged
+        \*********************************************************************/
+        int render(void);
+
+    private:
+        /*********************************************************************\
+        |* Keep the widgets in z order after one has moved
+        \*********************************************************************/
+        void _sort(void);
+
+        /*********************************************************************\
+        |* Redraw one damaged region
+        \*********************************************************************/
+        void _renderRegion(Rect r);
+
+        /*********************************************************************\
+        |* Cut the opaque widgets from 'first' onwards out of 'pieces'
+        \*********************************************************************/
+        int _trim(Rect *pieces, int num, int first);
+
+        /*********************************************************************\
+        |* Draw one widget, or the background, into each piece
+        \*********************************************************************/
+        void _drawPieces(Widget *widget, const Rect *pieces, int num);
+    };
+
+/*****************************************************************************\
+|* A solid, opaque rectangle
+\*****************************************************************************/
+class Panel : public Widget
+    {
+    GET(RGB, colour);                       // Fill colour
+
+    public:
+        explicit Panel(Rect bounds, RGB colour, int z=0);
+
+        void setColour(RGB colour);
+        void draw(Ili9481 *dpy);
+    };
+
+/*****************************************************************************\
+|* A horizontal bar, filled from the left in proportion to value/range
+\*****************************************************************************/
+class Bar : public Widget
+    {
+    GET(int, value);                        // Current value
+    GET(int, range);                        // Value that fills the bar
+    GET(RGB, colour);                       // Filled part
+    GET(RGB, empty);                        // Unfilled part
+
+    public:
+        explicit Bar(Rect bounds, int range, RGB colour, RGB empty, int z=0);
+
+        void setValue(int value);
+        void draw(Ili9481 *dpy);
+    };
@@ -0,0 +1,85 @@
+#include "shader.h"
+
+/*****************************************************************************\
+|* Constructor : work out how far along the gradient each pixel step moves,
+|* as the projection onto (p1 - p0) divided by its squared length
+\*****************************************************************************/
+LinearGradient::LinearGradient(Point p0, RGB c0, Point p1, RGB c1)
+        :_p0(p0)
+        ,_dr(c1.r - c0.r)
+        ,_dg(c1.g - c0.g)
+        ,_db(c1.b - c0.b)
+        ,_c0(c0)
+        ,_c1(c1)
+        ,_tx(0)
+        ,_ty(0)
+    {
+    int dx      = p1.x - p0.x;
+    int dy      = p1.y - p0.y;
+    int32_t len = dx * dx + dy * dy;
+    if (len > 0)
+        {
+        _tx = (int32_t)(((int64_t)dx << 16) / len);
+        _ty = (int32_t)(((int64_t)dy << 16) / len);
+        }
+    }
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+RadialGradient::RadialGradient(Point centre, int radius, RGB inner, RGB outer)
+        :_c(centre)
+        ,_radius((radius > 0) ? radius : 1)
+        ,_dr(outer.r - inner.r)
+        ,_dg(outer.g - inner.g)
+        ,_db(outer.b - inner.b)
+        ,_inner(inner)
+        ,_outer(outer)
+        ,_invR(0x10000 / _radius)
+    {}
+
+/*****************************************************************************\
+|* Private Method : Integer square root, rounded down. Only used once per
+|* row, so the simple bit-at-a-time version is fine
+\*****************************************************************************/
+int32_t RadialGradient::_isqrt(int32_t v)
+    {
+    int32_t root = 0;
+    int32_t bit  = 1 << 30;
+
+    while (bit > v)
+        bit >>= 2;
+
+    while (bit != 0)
+        {
+        if (v >= root + bit)
+            {
+            v    -= root + bit;
+            root  = (root >> 1) + bit;
+            }
+        else
+            root >>= 1;
+        bit >>= 2;
+        }
+    return root;
+    }
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Stripes::Stripes(RGB a, RGB b, int width, int dx, int dy)
+        :_a(a)
+        ,_b(b)
+        ,_width((width > 0) ? width : 1)
+        ,_dx(dx)
+        ,_dy(dy)
+    {}
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+Checkerboard::Checkerboard(RGB a, RGB b, int size)
+        :_a(a)
+        ,_b(b)
+        ,_size((size > 0) ? size : 1)
+    {}
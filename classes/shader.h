@@ -0,0 +1,247 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../include/structures.h"
+
+/*****************************************************************************\
+|* Shaders generate pixels procedurally for Ili9481::fillRect(). A shader is
+|* anything callable as
+|*
+|*      shader(int x, int y, int n, uint8_t *dst)
+|*
+|* which writes 'n' wire-format pixels (3 bytes each) for screen row 'y',
+|* starting at column 'x'. Functors passed to the fillRect() template get
+|* inlined; a plain function can be used through ShaderFn.
+|*
+|* The built-in shaders work out where a row starts once, then step along
+|* it with fixed-point increments, so there's no division per pixel
+\*****************************************************************************/
+typedef void (*ShaderFn)(void *ctx, int x, int y, int n, uint8_t *dst);
+
+/*****************************************************************************\
+|* What anti-aliased drawing blends against, in place of reading the screen
+|* back: a solid colour, or a shader that reproduces whatever is underneath.
+|* Either converts implicitly, so an RGB can be passed where one is wanted
+\*****************************************************************************/
+struct Backdrop
+    {
+    RGB         colour;             // Used when there's no shader
+    ShaderFn    fn;                 // Shader, or nullptr
+    void *      ctx;                // Passed to the shader
+
+    Backdrop(RGB c)
+        : colour(c), fn(nullptr), ctx(nullptr)
+        {}
+
+    Backdrop(ShaderFn f, void *c=nullptr)
+        : colour(), fn(f), ctx(c)
+        {}
+
+    inline void operator()(int x, int y, int n, uint8_t *dst) const
+        {
+        if (fn != nullptr)
+            {
+            fn(ctx, x, y, n, dst);
+            return;
+            }
+        for (int i=0; i<n; i++, dst += 3)
+            {
+            dst[0] = colour.r; dst[1] = colour.g; dst[2] = colour.b;
+            }
+        }
+    };
+
+/*****************************************************************************\
+|* Blend 'fg' over the wire-format pixel at 'dst', 'cov' out of 255. The
+|* divide by 255 is the usual shift-and-add, rounded
+\*****************************************************************************/
+static inline int _blendChannel(int bg, int fg, int cov)
+    {
+    int t = (fg - bg) * cov + 128;
+    return (bg + ((t + (t >> 8)) >> 8)) & 0xFC;
+    }
+
+static inline void blendWire(uint8_t *dst, RGB fg, int cov)
+    {
+    dst[0] = _blendChannel(dst[0], fg.r, cov);
+    dst[1] = _blendChannel(dst[1], fg.g, cov);
+    dst[2] = _blendChannel(dst[2], fg.b, cov);
+    }
+
+/*****************************************************************************\
+|* Linear gradient from c0 at p0 to c1 at p1, flat beyond either end
+\*****************************************************************************/
+class LinearGradient
+    {
+    private:
+        Point   _p0;                // Start of the gradient
+        int     _dr, _dg, _db;      // Colour change from c0 to c1
+        RGB     _c0;                // Colour at and before p0
+        RGB     _c1;                // Colour at and after p1
+        int32_t _tx;                // Change in t per pixel across, 16.16
+        int32_t _ty;                // Change in t per pixel down, 16.16
+
+    public:
+        explicit LinearGradient(Point p0, RGB c0, Point p1, RGB c1);
+
+        inline void operator()(int x, int y, int n, uint8_t *dst)
+            {
+            int32_t t = (x - _p0.x) * _tx + (y - _p0.y) * _ty;
+            for (int i=0; i<n; i++, t += _tx, dst += 3)
+                if (t <= 0)
+                    {
+                    dst[0] = _c0.r; dst[1] = _c0.g; dst[2] = _c0.b;
+                    }
+                else if (t >= 0x10000)
+                    {
+                    dst[0] = _c1.r; dst[1] = _c1.g; dst[2] = _c1.b;
+                    }
+                else
+                    {
+                    dst[0] = (_c0.r + ((_dr * t) >> 16)) & 0xFC;
+                    dst[1] = (_c0.g + ((_dg * t) >> 16)) & 0xFC;
+                    dst[2] = (_c0.b + ((_db * t) >> 16)) & 0xFC;
+                    }
+            }
+    };
+
+/*****************************************************************************\
+|* Radial gradient from 'inner' at the centre to 'outer' at 'radius' and
+|* beyond. The distance is tracked with an incremental integer square root,
+|* which moves by at most one per pixel
+\*****************************************************************************/
+class RadialGradient
+    {
+    private:
+        Point   _c;                 // Centre
+        int     _radius;            // Radius of the 'outer' colour
+        int     _dr, _dg, _db;      // Colour change from inner to outer
+        RGB     _inner;             // Colour at the centre
+        RGB     _outer;             // Colour at and beyond the radius
+        int32_t _invR;              // 1/radius, 16.16
+
+    public:
+        explicit RadialGradient(Point centre, int radius, RGB inner, RGB outer);
+
+        inline void operator()(int x, int y, int n, uint8_t *dst)
+            {
+            int dx      = x - _c.x;
+            int dy      = y - _c.y;
+            int32_t d2  = dx * dx + dy * dy;
+            int32_t d   = _isqrt(d2);
+
+            for (int i=0; i<n; i++, dst += 3)
+                {
+                if (d >= _radius)
+                    {
+                    dst[0] = _outer.r; dst[1] = _outer.g; dst[2] = _outer.b;
+                    }
+                else
+                    {
+                    int32_t t = d * _invR;
+                    dst[0] = (_inner.r + ((_dr * t) >> 16)) & 0xFC;
+                    dst[1] = (_inner.g + ((_dg * t) >> 16)) & 0xFC;
+                    dst[2] = (_inner.b + ((_db * t) >> 16)) & 0xFC;
+                    }
+
+                /*************************************************************\
+                |* (dx+1)^2 = dx^2 + 2dx + 1, then nudge the root to match
+                \*************************************************************/
+                d2 += 2 * dx + 1;
+                dx ++;
+                while ((d + 1) * (d + 1) <= d2)
+                    d ++;
+                while (d * d > d2)
+                    d --;
+                }
+            }
+
+    private:
+        static int32_t _isqrt(int32_t v);
+    };
+
+/*****************************************************************************\
+|* Alternating bands of two colours, 'width' pixels wide. The bands run
+|* across the direction (dx, dy): (1,0) gives vertical stripes, (0,1)
+|* horizontal ones, and (1,1) diagonals
+\*****************************************************************************/
+class Stripes
+    {
+    private:
+        RGB     _a;                 // Colour of even bands
+        RGB     _b;                 // Colour of odd bands
+        int     _width;             // Band width in pixels
+        int     _dx;                // Phase change per pixel across
+        int     _dy;                // Phase change per pixel down
+
+    public:
+        explicit Stripes(RGB a, RGB b, int width, int dx=1, int dy=0);
+
+        inline void operator()(int x, int y, int n, uint8_t *dst)
+            {
+            int phase   = x * _dx + y * _dy;
+            int band    = _floorDiv(phase, _width);
+            int rem     = phase - band * _width;
+            bool odd    = band & 1;
+
+            for (int i=0; i<n; i++, dst += 3)
+                {
+                const RGB &c = odd ? _b : _a;
+                dst[0] = c.r; dst[1] = c.g; dst[2] = c.b;
+
+                rem += _dx;
+                while (rem >= _width)
+                    {
+                    rem -= _width;
+                    odd  = !odd;
+                    }
+                while (rem < 0)
+                    {
+                    rem += _width;
+                    odd  = !odd;
+                    }
+                }
+            }
+
+    private:
+        static inline int _floorDiv(int a, int b)
+            {
+            return (a >= 0) ? a / b : -((-a + b - 1) / b);
+            }
+    };
+
+/*****************************************************************************\
+|* A checkerboard of two colours, with square cells of 'size' pixels
+\*****************************************************************************/
+class Checkerboard
+    {
+    private:
+        RGB     _a;                 // Colour of the cell at the origin
+        RGB     _b;                 // The other colour
+        int     _size;              // Cell size in pixels
+
+    public:
+        explicit Checkerboard(RGB a, RGB b, int size);
+
+        inline void operator()(int x, int y, int n, uint8_t *dst)
+            {
+            int cx      = (x >= 0) ? x / _size : -((-x + _size - 1) / _size);
+            int cy      = (y >= 0) ? y / _size : -((-y + _size - 1) / _size);
+            int left    = (cx + 1) * _size - x;
+            bool odd    = (cx + cy) & 1;
+
+            for (int i=0; i<n; i++, dst += 3)
+                {
+                const RGB &c = odd ? _b : _a;
+                dst[0] = c.r; dst[1] = c.g; dst[2] = c.b;
+
+                if (--left == 0)
+                    {
+                    left = _size;
+                    odd  = !odd;
+                    }
+                }
+            }
+    };
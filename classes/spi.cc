@@ -3,6 +3,7 @@
 
 #include "../include/errors.h"
 #include "spi.h"
+#include "spibus.h"
 
 #define SPI0_SCK    0x40044
 #define SPI0_CS     (SPI0_SCK >> 1)
@@ -40,8 +41,16 @@ static SpiPinMap _map[2] =
 |* Constructor - set up a SPI bus
 \*****************************************************************************/
 Spi::Spi(void)
-    :_ctx((SpiContext){Spi::SPI0,0,0,0,0,0})
+    :_ctx((SpiContext){Spi::SPI0,0,0,0,0,0,Spi::BLOCKING,nullptr})
     ,_device(nullptr)
+    ,_pinCD(-1)
+    ,_bus(nullptr)
+    ,_baudHz(0)
+    ,_cpol(SPI_CPOL_0)
+    ,_cpha(SPI_CPHA_0)
+    ,_dmaChannel(-1)
+    ,_depth(0)
+    ,_dcState(-1)
     {}
 
 
@@ -85,9 +94,24 @@ int Spi::init(SpiContext c)
 
 
      /*************************************************************************\
-    |* Configure the spi interface
+    |* Configure the spi interface. On a shared bus, only the first device 
+    |* resets the hardware, the rest just record their settings
     \*************************************************************************/
-   _ctx.speedInMhz  = spi_init(_device, c.speedInMhz * 1000000) / 1000000;
+    _bus = c.bus;
+    if (_bus != nullptr)
+        _bus->acquire(this);
+
+    if ((_bus == nullptr) || !_bus->hardwareUp())
+        _baudHz = spi_init(_device, c.speedInMhz * 1000000);
+    else
+        _baudHz = spi_set_baudrate(_device, c.speedInMhz * 1000000);
+    _ctx.speedInMhz  = _baudHz / 1000000;
+
+    if (_bus != nullptr)
+        {
+        _bus->setHardwareUp(true);
+        _bus->release(this);
+        }
 
     if ((c.pinSCK >= 0) && (c.pinSCK <= SPI_MAX_PIN))
         {
@@ -116,9 +140,231 @@ int Spi::init(SpiContext c)
         gpio_pull_up(c.pinRX);
        }
 
+    return setTransferMode(c.mode);
+    }
+
+/*****************************************************************************\
+|* Method : Change the clock rate. The shifter has to be idle first
+\*****************************************************************************/
+int Spi::setSpeed(int mhz)
+    {
+    if (_device == nullptr)
+        return E_NO_DEVICE;
+
+    if (mhz != _ctx.speedInMhz)
+        {
+        if (_bus != nullptr)
+            _bus->acquire(this);
+
+        _drain();
+        _baudHz         = spi_set_baudrate(_device, mhz * 1000000);
+        _ctx.speedInMhz = _baudHz / 1000000;
+
+        if (_bus != nullptr)
+            _bus->release(this);
+        }
+    return _ctx.speedInMhz;
+    }
+
+/*****************************************************************************\
+|* Method : Change the clock polarity and phase
+\*****************************************************************************/
+void Spi::setFormat(spi_cpol_t cpol, spi_cpha_t cpha)
+    {
+    if (_device == nullptr)
+        return;
+
+    if (_bus != nullptr)
+        _bus->acquire(this);
+
+    _cpol = cpol;
+    _cpha = cpha;
+    _drain();
+    spi_set_format(_device, 8, _cpol, _cpha, SPI_MSB_FIRST);
+
+    if (_bus != nullptr)
+        _bus->release(this);
+    }
+
+/*****************************************************************************\
+|* Method : Set the D/C pin. Its level is no longer known
+\*****************************************************************************/
+void Spi::setPinCD(int pin)
+    {
+    _pinCD      = pin;
+    _dcState    = -1;
+    }
+
+/*****************************************************************************\
+|* Method : Choose whether the CPU or a DMA channel feeds the FIFO
+\*****************************************************************************/
+int Spi::setTransferMode(TransferMode mode)
+    {
+    if ((mode == DMA) && (_dmaChannel < 0))
+        {
+        _dmaChannel = dma_claim_unused_channel(false);
+        if (_dmaChannel < 0)
+            {
+            printf(T_ERR "No DMA channel free for SPI%d\n", _ctx.device);
+            _ctx.mode = BLOCKING;
+            return E_NO_RESOURCE;
+            }
+
+        dma_channel_config cfg = dma_channel_get_default_config(_dmaChannel);
+        channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
+        channel_config_set_dreq(&cfg, spi_get_dreq(_device, true));
+        channel_config_set_read_increment(&cfg, true);
+        channel_config_set_write_increment(&cfg, false);
+        dma_channel_configure(_dmaChannel, &cfg, 
+                              &spi_get_hw(_device)->dr, nullptr, 0, false);
+        }
+    else if ((mode == BLOCKING) && (_dmaChannel >= 0))
+        {
+        dma_channel_unclaim(_dmaChannel);
+        _dmaChannel = -1;
+        }
+
+    _ctx.mode = mode;
     return E_OK;
     }
 
+/*****************************************************************************\
+|* Method : Take CS low, unless it already is
+\*****************************************************************************/
+void Spi::begin(void)
+    {
+    if (_depth++ == 0)
+        {
+        if (_bus != nullptr)
+            _bus->acquire(this);
+        if (_ctx.pinCS >= 0)
+            gpio_put(_ctx.pinCS, Gpio::LO);
+        }
+    }
+
+/*****************************************************************************\
+|* Method : Take CS high once the outermost begin() is matched
+\*****************************************************************************/
+void Spi::end(void)
+    {
+    if (_depth <= 0)
+        return;
+
+    if (--_depth == 0)
+        {
+        _drain();
+        if (_ctx.pinCS >= 0)
+            gpio_put(_ctx.pinCS, Gpio::HI);
+        if (_bus != nullptr)
+            _bus->release(this);
+        }
+    }
+
+/*****************************************************************************\
+|* Method : Step aside for another core waiting on the bus, if there is one
+\*****************************************************************************/
+bool Spi::yield(void)
+    {
+    if ((_bus == nullptr) || (_depth == 0) || !_bus->contended())
+        return false;
+
+    _drain();
+    if (_ctx.pinCS >= 0)
+        gpio_put(_ctx.pinCS, Gpio::HI);
+    _bus->release(this);
+
+    _bus->acquire(this);
+    if (_ctx.pinCS >= 0)
+        gpio_put(_ctx.pinCS, Gpio::LO);
+
+    return true;
+    }
+
+/*****************************************************************************\
+|* Method : Send a list of segments with a single CS assertion
+\*****************************************************************************/
+int Spi::transaction(const Segment *segments, int num)
+    {
+    if (_device == nullptr)
+        return E_NO_DEVICE;
+    if ((segments == nullptr) || (num < 0))
+        return E_INVALID;
+
+    begin();
+    for (int i=0; i<num; i++)
+        {
+        const Segment &s = segments[i];
+        if ((s.length <= 0) || (s.repeat <= 0))
+            continue;
+
+        _setDC((s.type == DATA) ? Gpio::HI : Gpio::LO);
+        _waitDma();
+
+        /*********************************************************************\
+        |* DMA set-up costs more than a few bytes take to send, so only hand
+        |* over larger blocks. A repeated block would need a transfer (and a
+        |* wait) per repeat, so the CPU feeds those without the gaps
+        \*********************************************************************/
+        if ((_ctx.mode == DMA) && (s.length >= 16) && (s.repeat == 1))
+            _writeDma(s.data, s.length);
+        else
+            _writeBlocking(s.data, s.length, s.repeat);
+        }
+    end();
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Start a data transfer, and (with DMA) return before it finishes
+\*****************************************************************************/
+int Spi::writeAsync(const uint8_t *data, int len)
+    {
+    if (_device == nullptr)
+        return E_NO_DEVICE;
+    if ((data == nullptr) || (len < 0))
+        return E_INVALID;
+
+    begin();
+    _setDC(Gpio::HI);
+    _waitDma();
+
+    if ((_ctx.mode == DMA) && (len >= 16))
+        dma_channel_transfer_from_buffer_now(_dmaChannel, data, len);
+    else
+        _writeBlocking(data, len, 1);
+    end();
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Wait for everything sent so far to be on the wire
+\*****************************************************************************/
+void Spi::wait(void)
+    {
+    _drain();
+    }
+
+/*****************************************************************************\
+|* Method : Read bytes back from the device in data mode
+\*****************************************************************************/
+int Spi::read(uint8_t *dst, int len)
+    {
+    if (_device == nullptr)
+        return E_NO_DEVICE;
+    if ((dst == nullptr) || (len < 0))
+        return E_INVALID;
+
+    begin();
+    _setDC(Gpio::HI);
+    _drain();
+    int got = spi_read_blocking(_device, 0x00, dst, len);
+    end();
+
+    return got;
+    }
+
 /*****************************************************************************\
 |* Private method : Get the corresponding device for an enum
 \*****************************************************************************/
@@ -127,4 +373,87 @@ spi_inst_t * Spi::_spiDevice(Spi::DeviceId device)
     return (device == SPI0)  ? spi0 
          : (device == SPI1)  ? spi1
          : nullptr;
-    }
\ No newline at end of file
+    }
+
+/*****************************************************************************\
+|* Private method : Set the D/C line. The FIFO must be empty before it moves
+|* or the tail of the previous segment would be mis-interpreted
+\*****************************************************************************/
+void Spi::_setDC(int level)
+    {
+    if ((_pinCD < 0) || (level == _dcState))
+        return;
+
+    _drain();
+    gpio_put(_pinCD, level);
+    _dcState = level;
+    }
+
+/*****************************************************************************\
+|* Private method : Feed the FIFO from the CPU, polling the not-full flag
+\*****************************************************************************/
+void Spi::_writeBlocking(const uint8_t *data, int len, int repeat)
+    {
+    spi_hw_t *hw = spi_get_hw(_device);
+
+    for (int r=0; r<repeat; r++)
+        for (int i=0; i<len; i++)
+            {
+            while (!(hw->sr & SPI_SSPSR_TNF_BITS))
+                tight_loop_contents();
+            hw->dr = data[i];
+            }
+    }
+
+/*****************************************************************************\
+|* Private method : Feed the FIFO from the DMA channel. The segment's data
+|* belongs to the caller, so it's waited for before returning
+\*****************************************************************************/
+void Spi::_writeDma(const uint8_t *data, int len)
+    {
+    dma_channel_transfer_from_buffer_now(_dmaChannel, data, len);
+    dma_channel_wait_for_finish_blocking(_dmaChannel);
+    }
+
+/*****************************************************************************\
+|* Private method : Wait for any DMA transfer in flight to finish feeding
+|* the FIFO
+\*****************************************************************************/
+void Spi::_waitDma(void)
+    {
+    if (_dmaChannel >= 0)
+        dma_channel_wait_for_finish_blocking(_dmaChannel);
+    }
+
+/*****************************************************************************\
+|* Private method : Wait until the shifter is idle, then empty the RX FIFO
+|* and clear the overrun flag that writing without reading will have set
+\*****************************************************************************/
+void Spi::_drain(void)
+    {
+    if (_device == nullptr)
+        return;
+
+    _waitDma();
+    spi_hw_t *hw = spi_get_hw(_device);
+
+    while (hw->sr & SPI_SSPSR_BSY_BITS)
+        tight_loop_contents();
+    while (hw->sr & SPI_SSPSR_RNE_BITS)
+        (void) hw->dr;
+
+    hw->icr = SPI_SSPICR_RORIC_BITS;
+    }
+
+/*****************************************************************************\
+|* Private method : Put this device's settings onto the (shared) hardware
+\*****************************************************************************/
+void Spi::_applySettings(void)
+    {
+    if ((_device == nullptr) || (_baudHz == 0))
+        return;
+
+    _drain();
+    spi_set_baudrate(_device, _baudHz);
+    spi_set_format(_device, 8, _cpol, _cpha, SPI_MSB_FIRST);
+    }
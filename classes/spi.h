@@ -4,9 +4,12 @@
 #include "pico/stdlib.h"
 #include "pico/time.h"
 #include "hardware/spi.h"
+#include "hardware/dma.h"
 
 #include "gpio.h"
 
+class SpiBus;
+
 /*****************************************************************************\
 |* Context for initialising a SPI driver
 \*****************************************************************************/
@@ -24,6 +27,18 @@ class Spi
             SPI_MAX
             } DeviceId;
 
+        typedef enum
+            {
+            BLOCKING = 0,       // CPU feeds the FIFO directly
+            DMA                 // A DMA channel feeds the FIFO
+            } TransferMode;
+
+        typedef enum
+            {
+            COMMAND = 0,        // D/C low while this segment is sent
+            DATA                // D/C high while this segment is sent
+            } SegmentType;
+
         struct SpiContext
             {
             DeviceId device;    // SPI device index to use Spi::SPI{0|1}
@@ -32,16 +47,40 @@ class Spi
             int pinTX;          // SPI TX pin
             int pinRX;          // SPI RX pin
             int speedInMhz;     // SPI clock rate
+            TransferMode mode;  // How to feed the FIFO, defaults to BLOCKING
+            SpiBus *bus;        // Bus shared with other devices, or nullptr
             };
- 
-  
+
+        /*********************************************************************\
+        |* One part of a transaction: 'data' is sent 'repeat' times, with the
+        |* D/C line set according to 'type'
+        \*********************************************************************/
+        struct Segment
+            {
+            SegmentType type;       // Command or data
+            const uint8_t *data;    // Bytes to send
+            int length;             // Number of bytes in 'data'
+            int repeat;             // Number of times to send 'data'
+            };
+
 	/*************************************************************************\
     |* Properties
     \*************************************************************************/
     GET(spi_inst_t*, device);
     GET(SpiContext, ctx);
+    GET(int, pinCD);                        // D/C pin, or -1 if none
+    GET(SpiBus*, bus);                      // Shared bus, or nullptr
+
+    friend class SpiBus;
+
+    private:
+        uint        _baudHz;                // Clock actually achieved
+        spi_cpol_t  _cpol;                  // Clock polarity
+        spi_cpha_t  _cpha;                  // Clock phase
+        int _dmaChannel;                    // Claimed DMA channel, or -1
+        int _depth;                         // Nesting count of begin()
+        int _dcState;                       // Current D/C level, -1=unknown
 
-       
     public:
         /*********************************************************************\
         |* Constructors and Destructor
@@ -54,11 +93,95 @@ class Spi
         \*********************************************************************/
         int init(SpiContext ctx);
 
-	
+        /*********************************************************************\
+        |* Change the clock rate, returns the rate actually achieved in MHz
+        \*********************************************************************/
+        int setSpeed(int mhz);
+
+        /*********************************************************************\
+        |* Change the clock polarity and phase (8-bit, MSB first)
+        \*********************************************************************/
+        void setFormat(spi_cpol_t cpol, spi_cpha_t cpha);
+
+        /*********************************************************************\
+        |* Set the D/C pin, or -1 for a device without one
+        \*********************************************************************/
+        void setPinCD(int pin);
+
+        /*********************************************************************\
+        |* Choose how the FIFO is fed. Claims (or releases) a DMA channel.
+        |* DMA only offloads writeAsync() blocks and transaction segments
+        |* of 16 bytes or more that aren't repeated; short or repeated
+        |* segments (solid fills, say) are still fed by the CPU
+        \*********************************************************************/
+        int setTransferMode(TransferMode mode);
+
+        /*********************************************************************\
+        |* Assert / release CS. These nest, so several transactions can share
+        |* one CS assertion
+        \*********************************************************************/
+        void begin(void);
+        void end(void);
+
+        /*********************************************************************\
+        |* Send a list of segments under one CS assertion, only changing D/C
+        |* between segments of different types
+        \*********************************************************************/
+        int transaction(const Segment *segments, int num);
+
+        /*********************************************************************\
+        |* Read bytes back from the device, in data mode
+        \*********************************************************************/
+        int read(uint8_t *dst, int len);
+
+        /*********************************************************************\
+        |* If another core is waiting for a shared bus, release CS and the bus
+        |* to let it in, then take them back. Returns true if that happened,
+        |* in which case the device has seen CS go high
+        \*********************************************************************/
+        bool yield(void);
+
+        /*********************************************************************\
+        |* Start sending a block of data. In DMA mode, and inside begin() /
+        |* end(), this returns as soon as the transfer has started, and the
+        |* data must stay put until the next call, wait() or end(). Otherwise
+        |* it's the same as a single-segment transaction
+        \*********************************************************************/
+        int writeAsync(const uint8_t *data, int len);
+
+        /*********************************************************************\
+        |* Wait for any transfer in flight to leave the shifter
+        \*********************************************************************/
+        void wait(void);
+
+
     private:
         /*********************************************************************\
         |* Get the corresponding device for an enum
         \*********************************************************************/
         spi_inst_t * _spiDevice(DeviceId device);
+
+        /*********************************************************************\
+        |* Set the D/C line, waiting for the FIFO to drain if it changes
+        \*********************************************************************/
+        void _setDC(int level);
+
+        /*********************************************************************\
+        |* Feed the FIFO, either directly or via DMA
+        \*********************************************************************/
+        void _writeBlocking(const uint8_t *data, int len, int repeat);
+        void _writeDma(const uint8_t *data, int len);
+        void _waitDma(void);
+
+        /*********************************************************************\
+        |* Wait for the last bit to leave, and discard anything received
+        \*********************************************************************/
+        void _drain(void);
+
+        /*********************************************************************\
+        |* Put this device's clock and format onto the hardware, called by
+        |* the bus when switching devices
+        \*********************************************************************/
+        void _applySettings(void);
     };
 
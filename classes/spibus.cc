@@ -0,0 +1,56 @@
+#include "spibus.h"
+#include "spi.h"
+
+/*****************************************************************************\
+|* Defines
+\*****************************************************************************/
+
+#define BUS_CHUNK_BYTES     3072    // ~0.6ms at 40MHz
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+SpiBus::SpiBus(void)
+        :_hardwareUp(false)
+        ,_chunkBytes(BUS_CHUNK_BYTES)
+        ,_current(nullptr)
+        ,_waiting{0, 0}
+    {
+    recursive_mutex_init(&_lock);
+    }
+
+/*****************************************************************************\
+|* Method : Take the bus. If a different device had it last, its settings
+|* are replaced by this one's
+\*****************************************************************************/
+void SpiBus::acquire(Spi *spi)
+    {
+    uint core = get_core_num();
+
+    _waiting[core] = _waiting[core] + 1;
+    recursive_mutex_enter_blocking(&_lock);
+    _waiting[core] = _waiting[core] - 1;
+
+    if (_current != spi)
+        {
+        spi->_applySettings();
+        _current = spi;
+        }
+    }
+
+/*****************************************************************************\
+|* Method : Give the bus back
+\*****************************************************************************/
+void SpiBus::release(Spi *spi)
+    {
+    (void) spi;
+    recursive_mutex_exit(&_lock);
+    }
+
+/*****************************************************************************\
+|* Method : Check whether the other core is blocked waiting for the bus
+\*****************************************************************************/
+bool SpiBus::contended(void)
+    {
+    return _waiting[get_core_num() ^ 1] > 0;
+    }
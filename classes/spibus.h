@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/mutex.h"
+
+#include "../include/properties.h"
+
+class Spi;
+
+/*****************************************************************************\
+|* Arbitration for a SPI block shared between several devices (display,
+|* storage, ADC...). Each device has its own Spi, with its own CS pin, clock
+|* and format; Spi::begin()/end() take and release the bus, and a device's
+|* settings are only put onto the hardware when the bus changes hands.
+|*
+|* The lock is recursive and safe across both cores. Long transfers call
+|* Spi::yield() between chunks, so a device on the other core never has to
+|* wait for more than one chunk
+\*****************************************************************************/
+class SpiBus
+    {
+    NON_COPYABLE_NOR_MOVEABLE(SpiBus)
+
+ 	/*************************************************************************\
+    |* Properties
+    \*************************************************************************/
+    GETSET(bool, hardwareUp, HardwareUp);   // First device has reset the block
+    GETSET(int, chunkBytes, ChunkBytes);    // Longest stretch without yielding
+
+    private:
+        recursive_mutex_t   _lock;          // Who currently owns the bus
+        Spi *               _current;       // Whose settings are on the h/w
+        volatile int        _waiting[2];    // Per-core count of waiters
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit SpiBus(void);
+
+        /*********************************************************************\
+        |* Take the bus for a device, switching settings if needed. Nests
+        \*********************************************************************/
+        void acquire(Spi *spi);
+
+        /*********************************************************************\
+        |* Give the bus back
+        \*********************************************************************/
+        void release(Spi *spi);
+
+        /*********************************************************************\
+        |* Is the other core waiting for the bus ?
+        \*********************************************************************/
+        bool contended(void);
+    };
@@ -0,0 +1,283 @@
+#include <string.h>
+
+#include "sprites.h"
+#include "../include/errors.h"
+#include "../include/macros.h"
+
+/*****************************************************************************\
+|* Constructor
+\*****************************************************************************/
+SpriteLayer::SpriteLayer(Ili9481 *dpy)
+        :_dpy(dpy)
+        ,_num(0)
+        ,_bgColour(RGB(0,0,0))
+        ,_bgImage({nullptr, 0, 0})
+        ,_bgFmt(PF_WIRE)
+        ,_bgOrigin({0, 0})
+    {}
+
+/*****************************************************************************\
+|* Method : Set a solid background
+\*****************************************************************************/
+void SpriteLayer::setBackground(RGB colour)
+    {
+    _bgColour   = colour;
+    _bgImage    = {nullptr, 0, 0};
+    }
+
+/*****************************************************************************\
+|* Method : Set an image background
+\*****************************************************************************/
+void SpriteLayer::setBackground(const Bitmap &image, PixelFormat fmt,
+                                Point origin, RGB colour)
+    {
+    _bgColour   = colour;
+    _bgImage    = image;
+    _bgFmt      = fmt;
+    _bgOrigin   = origin;
+    }
+
+/*****************************************************************************\
+|* Method : Add a sprite
+\*****************************************************************************/
+int SpriteLayer::add(const Bitmap &image, PixelFormat fmt, Point pos)
+    {
+    if ((image.pixels == nullptr) || (image.w <= 0) || (image.h <= 0))
+        return E_INVALID;
+    if (_num >= SPRITE_MAX)
+        return E_NO_RESOURCE;
+
+    Sprite &s   = _sprites[_num];
+    s.image     = image;
+    s.fmt       = fmt;
+    s.mask      = nullptr;
+    s.keyed     = false;
+    s.pos       = pos;
+    s.visible   = false;
+    s.dirty     = false;
+    s.drawn     = {0, 0, 0, 0};
+    memset(s.key, 0, sizeof(s.key));
+
+    return _num ++;
+    }
+
+/*****************************************************************************\
+|* Method : Make one colour of a sprite transparent
+\*****************************************************************************/
+int SpriteLayer::setColourKey(int id, RGB key)
+    {
+    if ((id < 0) || (id >= _num))
+        return E_INVALID;
+
+    Sprite &s   = _sprites[id];
+    s.key[0]    = key.r;
+    s.key[1]    = key.g;
+    s.key[2]    = key.b;
+    s.keyed     = true;
+    s.dirty     = true;
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Give a sprite an opacity mask
+\*****************************************************************************/
+int SpriteLayer::setMask(int id, const uint8_t *mask)
+    {
+    if ((id < 0) || (id >= _num))
+        return E_INVALID;
+
+    _sprites[id].mask   = mask;
+    _sprites[id].dirty  = true;
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Move a sprite
+\*****************************************************************************/
+int SpriteLayer::moveTo(int id, Point pos)
+    {
+    if ((id < 0) || (id >= _num))
+        return E_INVALID;
+
+    Sprite &s = _sprites[id];
+    if ((s.pos.x != pos.x) || (s.pos.y != pos.y))
+        {
+        s.pos   = pos;
+        s.dirty = true;
+        }
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Show or hide a sprite
+\*****************************************************************************/
+int SpriteLayer::show(int id, bool visible)
+    {
+    if ((id < 0) || (id >= _num))
+        return E_INVALID;
+
+    Sprite &s = _sprites[id];
+    if (s.visible != visible)
+        {
+        s.visible   = visible;
+        s.dirty     = true;
+        }
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Send the changes. Each changed sprite dirties where it was and
+|* where it is; two regions are merged whenever their bounding box has no
+|* more pixels than the pair, which also joins the old and new positions of
+|* a sprite that has only moved a little
+\*****************************************************************************/
+int SpriteLayer::update(void)
+    {
+    Rect dirty[SPRITE_MAX * 2];
+    int num = 0;
+
+    for (int i=0; i<_num; i++)
+        {
+        Sprite &s = _sprites[i];
+        if (!s.dirty)
+            continue;
+
+        Rect now = _placed(s);
+        if (s.drawn.w > 0)
+            dirty[num++] = s.drawn;
+        if (now.w > 0)
+            dirty[num++] = now;
+
+        s.drawn = now;
+        s.dirty = false;
+        }
+
+    bool merged = true;
+    while (merged)
+        {
+        merged = false;
+        for (int i=0; (i<num) && !merged; i++)
+            for (int j=i+1; (j<num) && !merged; j++)
+                {
+                Rect u = rectUnion(dirty[i], dirty[j]);
+                if (rectArea(u) <= rectArea(dirty[i]) + rectArea(dirty[j]))
+                    {
+                    dirty[i]    = u;
+                    dirty[j]    = dirty[--num];
+                    merged      = true;
+                    }
+                }
+        }
+
+    for (int i=0; i<num; i++)
+        {
+        int ok = _dpy->fillRect(dirty[i], Compositor{this});
+        if (ok != E_OK)
+            return ok;
+        }
+
+    return E_OK;
+    }
+
+/*****************************************************************************\
+|* Method : Draw everything within the clip
+\*****************************************************************************/
+int SpriteLayer::redraw(void)
+    {
+    for (int i=0; i<_num; i++)
+        {
+        _sprites[i].drawn = _placed(_sprites[i]);
+        _sprites[i].dirty = false;
+        }
+
+    return _dpy->fillRect(_dpy->clip(), Compositor{this});
+    }
+
+#pragma mark - Private Methods
+
+/*****************************************************************************\
+|* Private Method : Build part of a row: the background, then each sprite
+|* over it, bottom first
+\*****************************************************************************/
+void SpriteLayer::_compose(int x, int y, int n, uint8_t *dst)
+    {
+    int x1 = x + n;
+
+    /*************************************************************************\
+    |* Background
+    \*************************************************************************/
+    int bx0 = x1;
+    int bx1 = x1;
+    int by  = y - _bgOrigin.y;
+    if ((_bgImage.pixels != nullptr) && (by >= 0) && (by < _bgImage.h))
+        {
+        bx0 = MAX(x, _bgOrigin.x);
+        bx1 = MIN(x1, _bgOrigin.x + _bgImage.w);
+        }
+
+    uint8_t *p = dst;
+    for (int i=x; i<x1; i++, p += 3)
+        if ((i >= bx0) && (i < bx1))
+            bitmapFetch(_bgImage, _bgFmt, i - _bgOrigin.x, by, p);
+        else
+            {
+            p[0] = _bgColour.r;
+            p[1] = _bgColour.g;
+            p[2] = _bgColour.b;
+            }
+
+    /*************************************************************************\
+    |* Sprites
+    \*************************************************************************/
+    for (int k=0; k<_num; k++)
+        {
+        const Sprite &s = _sprites[k];
+        int j           = y - s.pos.y;
+        if (!s.visible || (j < 0) || (j >= s.image.h))
+            continue;
+
+        int sx0 = MAX(x, s.pos.x);
+        int sx1 = MIN(x1, s.pos.x + s.image.w);
+        p       = dst + (sx0 - x) * 3;
+
+        for (int i=sx0; i<sx1; i++, p += 3)
+            {
+            uint8_t pix[3];
+            bitmapFetch(s.image, s.fmt, i - s.pos.x, j, pix);
+            if (_opaque(s, i - s.pos.x, j, pix))
+                {
+                p[0] = pix[0];
+                p[1] = pix[1];
+                p[2] = pix[2];
+                }
+            }
+        }
+    }
+
+/*****************************************************************************\
+|* Private Method : Is a sprite pixel drawn
+\*****************************************************************************/
+bool SpriteLayer::_opaque(const Sprite &s, int i, int j, const uint8_t *pix)
+    {
+    if (s.mask != nullptr)
+        {
+        int stride = (s.image.w + 7) >> 3;
+        return (s.mask[j * stride + (i >> 3)] & (0x80 >> (i & 7))) != 0;
+        }
+
+    if (s.keyed)
+        return (pix[0] != s.key[0]) || (pix[1] != s.key[1])
+            || (pix[2] != s.key[2]);
+
+    return true;
+    }
+
+/*****************************************************************************\
+|* Private Method : Where a sprite is now
+\*****************************************************************************/
+Rect SpriteLayer::_placed(const Sprite &s)
+    {
+    if (!s.visible)
+        return {0, 0, 0, 0};
+    return {s.pos.x, s.pos.y, s.image.w, s.image.h};
+    }
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Ili9481.h"
+#include "bitmap.h"
+
+/*****************************************************************************\
+|* Most sprites a layer will manage
+\*****************************************************************************/
+#define SPRITE_MAX      8
+
+/*****************************************************************************\
+|* A set of sprites over a static background (a solid colour, or a bitmap in
+|* memory or flash).
+|*
+|* Moving, showing or hiding sprites only marks them; update() then works
+|* out which parts of the screen changed - the old and new rectangles of
+|* each sprite, merged where that sends fewer pixels - and re-composes just
+|* those. Each region is built a few rows at a time in the display's line
+|* buffers (background, then the sprites in the order they were added) and
+|* goes out through one window, so nothing else is redrawn
+\*****************************************************************************/
+class SpriteLayer
+    {
+    NON_COPYABLE_NOR_MOVEABLE(SpriteLayer)
+
+    private:
+        struct Sprite
+            {
+            Bitmap          image;      // Pixels
+            PixelFormat     fmt;        // Format of the pixels
+            const uint8_t * mask;       // 1bpp opacity mask, or nullptr
+            uint8_t         key[3];     // Transparent colour, wire format
+            bool            keyed;      // Whether 'key' is in use
+            Point           pos;        // Where the top-left will go
+            bool            visible;    // Whether it'll be drawn
+            bool            dirty;      // Changed since the last update()
+            Rect            drawn;      // What's on screen, w=0 if nothing
+            };
+
+        /*********************************************************************\
+        |* fillRect() takes its shader by value, so pass it this rather than
+        |* the layer itself
+        \*********************************************************************/
+        struct Compositor
+            {
+            SpriteLayer *layer;
+
+            inline void operator()(int x, int y, int n, uint8_t *dst)
+                { layer->_compose(x, y, n, dst); }
+            };
+
+        Ili9481 *       _dpy;                   // Display to draw on
+        Sprite          _sprites[SPRITE_MAX];   // Sprites, bottom first
+        int             _num;                   // Sprites in use
+        RGB             _bgColour;              // Background colour
+        Bitmap          _bgImage;               // Background image, or none
+        PixelFormat     _bgFmt;                 // Its pixel format
+        Point           _bgOrigin;              // Where its top-left is
+
+    public:
+        /*********************************************************************\
+        |* Constructors and Destructor
+        \*********************************************************************/
+        explicit SpriteLayer(Ili9481 *dpy);
+
+        /*********************************************************************\
+        |* Set the background. Where an image doesn't cover the screen, the
+        |* colour shows through. Call redraw() after changing it
+        \*********************************************************************/
+        void setBackground(RGB colour);
+        void setBackground(const Bitmap &image, PixelFormat fmt,
+                           Point origin={0, 0}, RGB colour=RGB(0,0,0));
+
+        /*********************************************************************\
+        |* Add a sprite, hidden, returning its id or <0 on error
+        \*********************************************************************/
+        int add(const Bitmap &image, PixelFormat fmt, Point pos={0, 0});
+
+        /*********************************************************************\
+        |* Make pixels of one colour transparent. The colour is compared after
+        |* conversion to wire format, so for RGB565 images it's the RGB666
+        |* colour the pixel turns into
+        \*********************************************************************/
+        int setColourKey(int id, RGB key);
+
+        /*********************************************************************\
+        |* Use a 1bpp mask instead: rows padded to whole bytes, leftmost pixel
+        |* in the top bit, set bits opaque. nullptr goes back to the key (if
+        |* any) or to a plain rectangle
+        \*********************************************************************/
+        int setMask(int id, const uint8_t *mask);
+
+        /*********************************************************************\
+        |* Move, show or hide a sprite. Nothing is drawn until update()
+        \*********************************************************************/
+        int moveTo(int id, Point pos);
+        int show(int id, bool visible=true);
+
+        /*********************************************************************\
+        |* Send whatever changed since the last update()
+        \*********************************************************************/
+        int update(void);
+
+        /*********************************************************************\
+        |* Draw the background and every visible sprite over the whole clip
+        \*********************************************************************/
+        int redraw(void);
+
+    private:
+        /*********************************************************************\
+        |* Build 'n' pixels of row 'y' from column 'x'
+        \*********************************************************************/
+        void _compose(int x, int y, int n, uint8_t *dst);
+
+        /*********************************************************************\
+        |* Whether pixel (i,j) of a sprite is drawn, given its wire bytes
+        \*********************************************************************/
+        static bool _opaque(const Sprite &s, int i, int j, const uint8_t *pix);
+
+        /*********************************************************************\
+        |* Where a sprite would be drawn now, w=0 if it's hidden
+        \*********************************************************************/
+        static Rect _placed(const Sprite &s);
+    };
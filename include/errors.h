@@ -7,6 +7,7 @@ enum
     E_NO_DEVICE         = -1,
     E_NO_RESOURCE       = -2,
     E_INVALID           = -3,
+    E_PENDING           = -4,
     };
 
 #define T_ERR "Error : "
@@ -45,6 +45,10 @@
 #	define MIN(x,y)  (((x) < (y)) ? (x) : (y))
 #endif
 
+#ifndef MAX
+#	define MAX(x,y)  (((x) > (y)) ? (x) : (y))
+#endif
+
 #ifndef ABS
 #	define ABS(x)    (((x) < 0) ? -(x) : (x))
 #endif
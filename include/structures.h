@@ -35,6 +35,23 @@ struct Rect
         }
     };
 
+/*****************************************************************************\
+|* Pixels a rectangle covers, and the smallest rectangle around two others
+\*****************************************************************************/
+static inline int rectArea(const Rect &r)
+    {
+    return r.w * r.h;
+    }
+
+static inline Rect rectUnion(const Rect &a, const Rect &b)
+    {
+    int x0 = (a.x < b.x) ? a.x : b.x;
+    int y0 = (a.y < b.y) ? a.y : b.y;
+    int x1 = (a.x + a.w > b.x + b.w) ? a.x + a.w : b.x + b.w;
+    int y1 = (a.y + a.h > b.y + b.h) ? a.y + a.h : b.y + b.h;
+    return {x0, y0, x1 - x0, y1 - y0};
+    }
+
 /*****************************************************************************\
 |* Genereric colour structure
 \*****************************************************************************/
@@ -44,6 +61,10 @@ struct RGB
     uint8_t g;          // Green component
     uint8_t b;          // Blue component
 
+    RGB(void)
+        : r(0), g(0), b(0)
+        {}
+
     RGB(uint8_t rv, uint8_t gv, uint8_t bv)
         {
         r = (rv & 0x3F) << 2;
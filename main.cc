@@ -6,7 +6,7 @@
 int main (int argc, char **argv)
     {
     stdio_init_all();
-    sleep_ms(2000);
+    absolute_time_t usbReady = make_timeout_time_ms(2000);
 
     /*************************************************************************\
     |* Initialise GPIO. 
@@ -26,14 +26,24 @@ int main (int argc, char **argv)
             Gpio::PIN17,    // SPI CS
             Gpio::PIN19,    // SPI TX
             Gpio::PIN16,    // SPI RX
-            fspi            // SPI clock in MHz
+            fspi,           // SPI clock in MHz
+            Spi::BLOCKING,  // CPU feeds the FIFO
+            nullptr         // Bus isn't shared
             },
         Gpio::PIN27,        // LCD /RST
         Gpio::PIN26,        // LCD D/C
+        false               // Don't search for faster clocks
         };    
 
     Ili9481 dpy;
-    int ok      = dpy.init(&ctx);
+    int ok      = dpy.initAsync(&ctx, true);
+
+    /*************************************************************************\
+    |* Anything else can be set up here, while the display comes out of reset
+    \*************************************************************************/
+    while ((ok == E_PENDING) || !time_reached(usbReady))
+        ok = dpy.poll();
+
     dpy.setRotation(Ili9481::INVERTED_PORTRAIT);
 
     dpy.clear(RGB(50,200,200));
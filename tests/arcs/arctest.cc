@@ -0,0 +1,152 @@
+/*****************************************************************************\
+|* arctest : check the arc tables against the midpoint loops they replace.
+|*
+|* Each of the driver's old loops is run here as it was, with the lines it
+|* would have drawn written down instead, and what they come to is compared
+|* with the table ArcCache hands back: built by the compiler up to
+|* ARC_TABLE_MAX, and at run time from there up to ARC_CACHE_MAX
+\*****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../../classes/arcs.h"
+
+/*****************************************************************************\
+|* Step by step, how far along the octant the outline gets, from the do /
+|* while in Ili9481::_circle() before it had tables
+\*****************************************************************************/
+static void _outline(int r, int16_t *out)
+    {
+    int R       = r;
+    int f       =  1 - r;
+    int ddfY    = -2 * r;
+    int ddfX    =  1;
+    int xe      =  0;
+
+    for (int i=0; i<=R; i++)
+        out[i] = -1;
+
+    do
+        {
+        while (f < 0)
+            {
+            xe ++;
+            f  += (ddfX += 2);
+            }
+        f += (ddfY += 2);
+
+        out[R - r] = (int16_t)xe;
+        }
+    while (xe < --r);
+    }
+
+/*****************************************************************************\
+|* The widest half-width drawn on each row out from the centre, by a rounded
+|* corner in Ili9481::_filledCircleHelper(), and a filled circle in
+|* Ili9481::_circleFill()
+\*****************************************************************************/
+static void _hline(int16_t *out, int row, int half)
+    {
+    if (half > out[row])
+        out[row] = (int16_t)half;
+    }
+
+static void _corner(int r, int16_t *out)
+    {
+    int f     = 1 - r;
+    int ddF_x = 1;
+    int ddF_y = -r - r;
+    int y     = 0;
+
+    for (int i=0; i<=r; i++)
+        out[i] = -1;
+
+    while (y < r)
+        {
+        if (f >= 0)
+            {
+            _hline(out, r, y);
+            r--;
+            ddF_y += 2;
+            f += ddF_y;
+            }
+
+        y++;
+        ddF_x += 2;
+        f += ddF_x;
+
+        _hline(out, y, r);
+        }
+    }
+
+static void _disc(int r, int16_t *out)
+    {
+    int  xx = 0;
+    int  dx = 1;
+    int  dy = r+r;
+    int  p  = -(r>>1);
+
+    for (int i=0; i<=r; i++)
+        out[i] = -1;
+
+    _hline(out, 0, r);
+    while (xx < r)
+        {
+        if (p>=0)
+            {
+            _hline(out, r, xx);
+            dy-=2;
+            p-=dy;
+            r--;
+            }
+
+        dx+=2;
+        p+=dx;
+        xx++;
+
+        _hline(out, xx, r);
+        }
+    }
+
+/*****************************************************************************\
+|* Compare every radius and kind
+\*****************************************************************************/
+int main(void)
+    {
+    static const char *names[ARC_KINDS] = {"outline", "corner", "disc"};
+    ArcCache cache;
+    int bad = 0;
+
+    for (int kind=0; kind<ARC_KINDS; kind++)
+        for (int r=0; r<=ARC_CACHE_MAX; r++)
+            {
+            int16_t want[ARC_CACHE_MAX + 1];
+            if (kind == ARC_OUTLINE)
+                _outline(r, want);
+            else if (kind == ARC_CORNER)
+                _corner(r, want);
+            else
+                _disc(r, want);
+
+            const int16_t *got = cache.table(r, (ArcKind)kind);
+            if (got == nullptr)
+                {
+                printf("%s r=%d: no table\n", names[kind], r);
+                bad ++;
+                continue;
+                }
+
+            for (int i=0; i<=r; i++)
+                if (got[i] != want[i])
+                    {
+                    printf("%s r=%d: entry %d is %d, expected %d\n",
+                           names[kind], r, i, got[i], want[i]);
+                    bad ++;
+                    break;
+                    }
+            }
+
+    printf("%d radii checked for each kind, %d wrong\n", ARC_CACHE_MAX + 1,
+           bad);
+    return (bad == 0) ? 0 : 1;
+    }
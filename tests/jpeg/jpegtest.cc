@@ -0,0 +1,202 @@
+/*****************************************************************************\
+|* jpegtest : decode one of the images in data/ with JpegDecoder at each
+|* scale, and check it against libjpeg's decode of the same file (made by
+|* mkdata.py).
+|*
+|* Usage: jpegtest data-dir name
+|*
+|* The decoder produces wire pixels, which only keep the top 6 bits of each
+|* channel, so the reference is cut down the same way before comparing.
+|* The two don't round the same way, so a channel may be out by up to
+|* MAX_ERROR, and the average over the image by up to MEAN_ERROR.
+|*
+|* When chroma is subsampled, libjpeg interpolates it (or when scaling,
+|* decodes it at twice the size) where JpegDecoder repeats each sample over
+|* 2x2 pixels. Each of those pixels then stands for 2^shift more of the
+|* image, so for those both limits are multiplied by 2^shift
+\*****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <string>
+#include <vector>
+
+#include "../../classes/jpeg.h"
+#include "../../include/errors.h"
+
+#define MAX_ERROR           8
+#define MEAN_ERROR          1.5
+
+typedef std::vector<uint8_t> Bytes;
+
+/*****************************************************************************\
+|* Read a whole file
+\*****************************************************************************/
+static bool _readFile(const std::string& path, Bytes *data)
+    {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr)
+        return false;
+
+    fseek(fp, 0, SEEK_END);
+    data->resize((size_t) ftell(fp));
+    fseek(fp, 0, SEEK_SET);
+    bool ok = (fread(data->data(), 1, data->size(), fp) == data->size());
+    fclose(fp);
+    return ok;
+    }
+
+/*****************************************************************************\
+|* Read a binary PPM (P6, maxval 255), as written by Pillow
+\*****************************************************************************/
+static int _readToken(FILE *fp)
+    {
+    int c = fgetc(fp);
+    while ((c == '#') || isspace(c))
+        {
+        if (c == '#')
+            while ((c != '\n') && (c != EOF))
+                c = fgetc(fp);
+        c = fgetc(fp);
+        }
+
+    int v = 0;
+    while (isdigit(c))
+        {
+        v = v * 10 + (c - '0');
+        c = fgetc(fp);
+        }
+    return v;
+    }
+
+static bool _readPPM(const std::string& path, int *w, int *h, Bytes *rgb)
+    {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr)
+        return false;
+
+    char magic[2];
+    if ((fread(magic, 1, 2, fp) != 2) || (magic[0] != 'P') || (magic[1] != '6'))
+        {
+        fclose(fp);
+        return false;
+        }
+
+    *w          = _readToken(fp);
+    *h          = _readToken(fp);
+    int maxval  = _readToken(fp);
+    if ((*w <= 0) || (*h <= 0) || (maxval != 255))
+        {
+        fclose(fp);
+        return false;
+        }
+
+    rgb->resize((size_t)*w * *h * 3);
+    bool ok = (fread(rgb->data(), 1, rgb->size(), fp) == rgb->size());
+    fclose(fp);
+    return ok;
+    }
+
+/*****************************************************************************\
+|* Decode at one scale into a packed image, MCU by MCU
+\*****************************************************************************/
+static bool _decode(JpegDecoder *jpeg, int shift, Bytes *rgb)
+    {
+    if (jpeg->setScale(shift) != E_OK)
+        return false;
+
+    int w = jpeg->width();
+    rgb->assign((size_t) w * jpeg->height() * 3, 0);
+
+    const uint8_t *pixels;
+    Rect where;
+    int ok;
+    while ((ok = jpeg->decodeMcu(&pixels, &where)) > 0)
+        for (int y=0; y<where.h; y++)
+            for (int x=0; x<where.w * 3; x++)
+                (*rgb)[((where.y + y) * w + where.x) * 3 + x]
+                    = pixels[(y * where.w) * 3 + x];
+
+    return (ok == 0);
+    }
+
+/*****************************************************************************\
+|* Check one scale against its reference
+\*****************************************************************************/
+static bool _check(JpegDecoder *jpeg, const std::string& base, int shift)
+    {
+    std::string ref = base + "_" + std::to_string(shift) + ".ppm";
+    int w, h;
+    Bytes want;
+    if (!_readPPM(ref, &w, &h, &want))
+        {
+        fprintf(stderr, "%s: can't read the reference\n", ref.c_str());
+        return false;
+        }
+
+    Bytes got;
+    if (!_decode(jpeg, shift, &got))
+        {
+        fprintf(stderr, "%s: decode failed\n", ref.c_str());
+        return false;
+        }
+
+    if ((jpeg->width() != w) || (jpeg->height() != h))
+        {
+        fprintf(stderr, "%s: decoded %dx%d, expected %dx%d\n", ref.c_str(),
+                jpeg->width(), jpeg->height(), w, h);
+        return false;
+        }
+
+    int worst   = 0;
+    long total  = 0;
+    for (size_t i=0; i<got.size(); i++)
+        {
+        int diff = abs(got[i] - (want[i] & 0xFC));
+        worst    = (diff > worst) ? diff : worst;
+        total   += diff;
+        }
+
+    int grow    = ((jpeg->mcuWidth() << shift) > 8) ? (1 << shift) : 1;
+    double mean = (double) total / got.size();
+    bool pass   = (worst <= MAX_ERROR * grow)
+               && (mean <= MEAN_ERROR * grow);
+    printf("%-24s %3dx%-3d max %3d mean %5.2f %s\n", ref.c_str(), w, h,
+           worst, mean, pass ? "ok" : "FAIL");
+    return pass;
+    }
+
+/*****************************************************************************\
+|* Check every scale of one image
+\*****************************************************************************/
+int main(int argc, char **argv)
+    {
+    if (argc != 3)
+        {
+        fprintf(stderr, "Usage: %s data-dir name\n", argv[0]);
+        return 1;
+        }
+
+    std::string base = std::string(argv[1]) + "/" + argv[2];
+    Bytes data;
+    if (!_readFile(base + ".jpg", &data))
+        {
+        fprintf(stderr, "%s.jpg: can't read it\n", base.c_str());
+        return 1;
+        }
+
+    JpegDecoder jpeg;
+    if (jpeg.open(data.data(), (int) data.size()) != E_OK)
+        {
+        fprintf(stderr, "%s.jpg: can't parse it\n", base.c_str());
+        return 1;
+        }
+
+    bool pass = true;
+    for (int shift=0; shift<4; shift++)
+        pass = _check(&jpeg, base, shift) && pass;
+
+    return pass ? 0 : 1;
+    }
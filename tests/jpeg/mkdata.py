@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+#
+# Makes the test images in data/, and their reference decodes. Each image
+# is saved as a baseline JPEG, then decoded by libjpeg (through Pillow) at
+# full size and scaled by 1/2, 1/4 and 1/8; the decodes are written as
+# binary PPMs named <image>_<shift>.ppm.
+#
+# Host prerequisite: Pillow (built against libjpeg), which isn't part of
+# the firmware build and isn't kept in the repo. Install it on the host,
+# e.g. "pip install Pillow", then run
+#
+#   python3 mkdata.py
+#
+import math
+import os
+
+from PIL import Image
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DATA = os.path.join(HERE, "data")
+
+
+def pattern(w, h):
+    """Smooth gradients with a soft blob, so upsampling stays close"""
+    img = Image.new("RGB", (w, h))
+    px = img.load()
+    for y in range(h):
+        for x in range(w):
+            d = math.hypot(x - w * 0.6, y - h * 0.4) / max(w, h)
+            r = 64 + 128 * x // max(w - 1, 1)
+            g = 64 + 128 * y // max(h - 1, 1)
+            b = int(128 + 64 * math.cos(d * 3))
+            px[x, y] = (r, g, b)
+    return img
+
+
+# name, size, mode, save options
+IMAGES = [
+    ("rgb444", (48, 32), "RGB", dict(subsampling=0)),
+    ("rgb420", (48, 32), "RGB", dict(subsampling=2)),
+    ("grey", (40, 24), "L", dict()),
+    ("restart", (64, 48), "RGB",
+     dict(subsampling=2, restart_marker_blocks=3)),
+    ("odd444", (37, 29), "RGB", dict(subsampling=0)),
+    ("odd420", (37, 29), "RGB", dict(subsampling=2)),
+]
+
+
+def main():
+    os.makedirs(DATA, exist_ok=True)
+    for name, size, mode, opts in IMAGES:
+        path = os.path.join(DATA, name + ".jpg")
+        src = pattern(*size).convert(mode)
+        src.save(path, "JPEG", quality=90, optimize=False,
+                 progressive=False, **opts)
+
+        for shift in range(4):
+            img = Image.open(path)
+            w = (size[0] + (1 << shift) - 1) >> shift
+            h = (size[1] + (1 << shift) - 1) >> shift
+            img.draft(mode, (max(size[0] >> shift, 1),
+                             max(size[1] >> shift, 1)))
+            img = img.convert("RGB")
+            if img.size != (w, h):
+                raise SystemExit("%s: draft gave %s, not %s"
+                                 % (name, img.size, (w, h)))
+            img.save(os.path.join(DATA, "%s_%d.ppm" % (name, shift)))
+
+
+if __name__ == "__main__":
+    main()
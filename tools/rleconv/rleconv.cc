@@ -0,0 +1,323 @@
+/*****************************************************************************\
+|* rleconv : convert a PPM (or, if built with libpng, a PNG) image into an
+|* RLE asset (see classes/rleformat.h), written out as a C++ source file
+|* and header that can be linked into the firmware. The data is const, so it
+|* stays in flash and RleSource reads it in place.
+|*
+|* Usage: rleconv [-n name] [-r] input output-base
+|*
+|*   -n name    symbol to use, defaults to the output file's base name
+|*   -r         never use a palette, even if the image has few colours
+|*
+|* Writes output-base.cc and output-base.h
+\*****************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_PNG
+#  include <png.h>
+#endif
+
+#include "../../classes/rleformat.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+/*****************************************************************************\
+|* Read a binary PPM (P6, maxval up to 255) into 8-bit RGB
+\*****************************************************************************/
+static int _readToken(FILE *fp)
+    {
+    int c = fgetc(fp);
+    while ((c == '#') || isspace(c))
+        {
+        if (c == '#')
+            while ((c != '\n') && (c != EOF))
+                c = fgetc(fp);
+        c = fgetc(fp);
+        }
+
+    int v = 0;
+    while (isdigit(c))
+        {
+        v = v * 10 + (c - '0');
+        c = fgetc(fp);
+        }
+    return v;
+    }
+
+static bool _readPPM(const char *path, int *w, int *h, Bytes *rgb)
+    {
+    FILE *fp = fopen(path, "rb");
+    if (fp == nullptr)
+        return false;
+
+    char magic[2];
+    if ((fread(magic, 1, 2, fp) != 2) || (magic[0] != 'P') || (magic[1] != '6'))
+        {
+        fclose(fp);
+        return false;
+        }
+
+    *w          = _readToken(fp);
+    *h          = _readToken(fp);
+    int maxval  = _readToken(fp);
+    if ((*w <= 0) || (*h <= 0) || (maxval <= 0) || (maxval > 255))
+        {
+        fclose(fp);
+        return false;
+        }
+
+    rgb->resize((size_t)*w * *h * 3);
+    bool ok = (fread(rgb->data(), 1, rgb->size(), fp) == rgb->size());
+    fclose(fp);
+
+    if (ok && (maxval != 255))
+        for (auto &v : *rgb)
+            v = (uint8_t)((v * 255 + maxval / 2) / maxval);
+    return ok;
+    }
+
+#ifdef HAVE_PNG
+/*****************************************************************************\
+|* Read any PNG into 8-bit RGB, dropping alpha
+\*****************************************************************************/
+static bool _readPNG(const char *path, int *w, int *h, Bytes *rgb)
+    {
+    png_image img;
+    memset(&img, 0, sizeof(img));
+    img.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_file(&img, path))
+        return false;
+
+    img.format = PNG_FORMAT_RGB;
+    rgb->resize(PNG_IMAGE_SIZE(img));
+    if (!png_image_finish_read(&img, nullptr, rgb->data(), 0, nullptr))
+        {
+        png_image_free(&img);
+        return false;
+        }
+
+    *w = img.width;
+    *h = img.height;
+    return true;
+    }
+#endif
+
+/*****************************************************************************\
+|* Encode wire-format pixels (one uint32_t per pixel) as runs and literals.
+|* If 'index' isn't empty, pixels are written as palette indices
+\*****************************************************************************/
+static void _emitPixel(Bytes *out, uint32_t px,
+                       const std::map<uint32_t, int> &index)
+    {
+    if (!index.empty())
+        out->push_back((uint8_t)index.at(px));
+    else
+        {
+        out->push_back((px >> 16) & 0xFF);
+        out->push_back((px >> 8)  & 0xFF);
+        out->push_back( px        & 0xFF);
+        }
+    }
+
+static void _encode(const std::vector<uint32_t> &px,
+                    const std::map<uint32_t, int> &index, Bytes *out)
+    {
+    size_t i = 0;
+    size_t n = px.size();
+
+    while (i < n)
+        {
+        size_t run = 1;
+        while ((i + run < n) && (px[i + run] == px[i])
+               && (run < RLE_MAX_LONG_RUN))
+            run ++;
+
+        if (run >= RLE_MIN_RUN)
+            {
+            if (run <= RLE_MAX_SHORT_RUN)
+                out->push_back((uint8_t)(RLE_OP_RUN + run - RLE_MIN_RUN));
+            else
+                {
+                out->push_back(RLE_OP_LONG_RUN);
+                out->push_back(run & 0xFF);
+                out->push_back(run >> 8);
+                }
+            _emitPixel(out, px[i], index);
+            i += run;
+            continue;
+            }
+
+        /*********************************************************************\
+        |* A literal runs until the next pair of matching pixels
+        \*********************************************************************/
+        size_t len = 1;
+        while ((i + len < n) && (len < RLE_MAX_LITERAL)
+               && !((i + len + 1 < n) && (px[i + len] == px[i + len + 1])))
+            len ++;
+
+        out->push_back((uint8_t)(len - 1));
+        for (size_t j=0; j<len; j++)
+            _emitPixel(out, px[i + j], index);
+        i += len;
+        }
+    }
+
+/*****************************************************************************\
+|* Build the complete asset, using a palette only if it makes it smaller
+\*****************************************************************************/
+static Bytes _buildAsset(int w, int h, const Bytes &rgb, bool allowPalette)
+    {
+    std::vector<uint32_t> px(w * h);
+    std::map<uint32_t, int> index;
+
+    for (size_t i=0; i<px.size(); i++)
+        {
+        px[i] = ((rgb[i*3] & 0xFC) << 16)
+              | ((rgb[i*3+1] & 0xFC) << 8)
+              |  (rgb[i*3+2] & 0xFC);
+        if (index.size() <= RLE_MAX_PALETTE)
+            index.emplace(px[i], 0);
+        }
+
+    Bytes raw;
+    _encode(px, {}, &raw);
+
+    Bytes palette;
+    Bytes indexed;
+    if (allowPalette && (index.size() <= RLE_MAX_PALETTE))
+        {
+        int next = 0;
+        for (auto &kv : index)
+            {
+            kv.second = next ++;
+            palette.push_back((kv.first >> 16) & 0xFF);
+            palette.push_back((kv.first >> 8)  & 0xFF);
+            palette.push_back( kv.first        & 0xFF);
+            }
+        _encode(px, index, &indexed);
+        }
+
+    bool usePalette = !indexed.empty()
+                   && (palette.size() + indexed.size() < raw.size());
+    int colours     = usePalette ? (int)index.size() : 0;
+
+    Bytes out = {'R', 'L', 'E', '6',
+                 (uint8_t)(w & 0xFF),       (uint8_t)(w >> 8),
+                 (uint8_t)(h & 0xFF),       (uint8_t)(h >> 8),
+                 (uint8_t)(colours & 0xFF), (uint8_t)(colours >> 8),
+                 0, 0};
+    if (usePalette)
+        {
+        out.insert(out.end(), palette.begin(), palette.end());
+        out.insert(out.end(), indexed.begin(), indexed.end());
+        }
+    else
+        out.insert(out.end(), raw.begin(), raw.end());
+    return out;
+    }
+
+/*****************************************************************************\
+|* Write the .cc and .h pair
+\*****************************************************************************/
+static bool _writeSource(const std::string &base, const std::string &name,
+                         const Bytes &asset, int w, int h)
+    {
+    FILE *fp = fopen((base + ".h").c_str(), "w");
+    if (fp == nullptr)
+        return false;
+
+    fprintf(fp, "#pragma once\n\n#include <stdint.h>\n\n");
+    fprintf(fp, "// Generated by rleconv: %dx%d RLE asset\n", w, h);
+    fprintf(fp, "extern const uint8_t %s[];\n", name.c_str());
+    fprintf(fp, "extern const int %s_len;\n", name.c_str());
+    fclose(fp);
+
+    fp = fopen((base + ".cc").c_str(), "w");
+    if (fp == nullptr)
+        return false;
+
+    std::string header = base.substr(base.find_last_of('/') + 1) + ".h";
+    fprintf(fp, "#include \"%s\"\n\n", header.c_str());
+    fprintf(fp, "const int %s_len = %zu;\n\n", name.c_str(), asset.size());
+    fprintf(fp, "const uint8_t %s[] __attribute__((aligned(4))) =\n    {",
+            name.c_str());
+    for (size_t i=0; i<asset.size(); i++)
+        fprintf(fp, "%s0x%02X,", (i % 12) ? " " : "\n    ", asset[i]);
+    fprintf(fp, "\n    };\n");
+    fclose(fp);
+    return true;
+    }
+
+/*****************************************************************************\
+|* Entry point
+\*****************************************************************************/
+int main(int argc, char **argv)
+    {
+    std::string name;
+    bool allowPalette = true;
+    int arg = 1;
+
+    for (; (arg < argc) && (argv[arg][0] == '-'); arg++)
+        if ((strcmp(argv[arg], "-n") == 0) && (arg + 1 < argc))
+            name = argv[++arg];
+        else if (strcmp(argv[arg], "-r") == 0)
+            allowPalette = false;
+        else
+            break;
+
+    if (arg + 2 != argc)
+        {
+        fprintf(stderr, "Usage: %s [-n name] [-r] input output-base\n",
+                argv[0]);
+        return 1;
+        }
+
+    const char *input   = argv[arg];
+    std::string base    = argv[arg + 1];
+    if (name.empty())
+        {
+        name = base.substr(base.find_last_of('/') + 1);
+        for (auto &c : name)
+            if (!isalnum((unsigned char)c))
+                c = '_';
+        }
+
+    int w = 0;
+    int h = 0;
+    Bytes rgb;
+    bool ok = _readPPM(input, &w, &h, &rgb);
+#ifdef HAVE_PNG
+    if (!ok)
+        ok = _readPNG(input, &w, &h, &rgb);
+#endif
+    if (!ok)
+        {
+        fprintf(stderr, "Cannot read image '%s'\n", input);
+        return 1;
+        }
+    if ((w > 65535) || (h > 65535))
+        {
+        fprintf(stderr, "Image '%s' is too large\n", input);
+        return 1;
+        }
+
+    Bytes asset = _buildAsset(w, h, rgb, allowPalette);
+    if (!_writeSource(base, name, asset, w, h))
+        {
+        fprintf(stderr, "Cannot write '%s'\n", base.c_str());
+        return 1;
+        }
+
+    printf("%s: %dx%d, %zu bytes (%.1f%% of raw)\n", name.c_str(), w, h,
+           asset.size(), 100.0 * asset.size() / ((double)w * h * 3));
+    return 0;
+    }